@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AllocationCounter.h"
+#include "HAL/MemoryBase.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include <atomic>
+
+namespace {
+	std::atomic<bool> bCounting(false);
+	std::atomic<uint64> allocations(0);
+
+	/** Passes everything through to the allocator it wraps, counting Malloc and Realloc calls along the way. */
+	class FCountingMalloc final : public FMalloc {
+	public:
+		explicit FCountingMalloc(FMalloc* inner) : inner(inner) {}
+
+		virtual void* Malloc(SIZE_T Size, uint32 Alignment) override {
+			Count();
+			return inner->Malloc(Size, Alignment);
+		}
+
+		virtual void* TryMalloc(SIZE_T Size, uint32 Alignment) override {
+			Count();
+			return inner->TryMalloc(Size, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Size, uint32 Alignment) override {
+			Count();
+			return inner->Realloc(Original, Size, Alignment);
+		}
+
+		virtual void* TryRealloc(void* Original, SIZE_T Size, uint32 Alignment) override {
+			Count();
+			return inner->TryRealloc(Original, Size, Alignment);
+		}
+
+		virtual void Free(void* Original) override { inner->Free(Original); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return inner->QuantizeSize(Count, Alignment); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return inner->GetAllocationSize(Original, SizeOut); }
+		virtual void Trim(bool bTrimThreadCaches) override { inner->Trim(bTrimThreadCaches); }
+		virtual void SetupTLSCachesOnCurrentThread() override { inner->SetupTLSCachesOnCurrentThread(); }
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		virtual void InitializeStatsMetadata() override { inner->InitializeStatsMetadata(); }
+		virtual bool IsInternallyThreadSafe() const override { return inner->IsInternallyThreadSafe(); }
+		virtual bool ValidateHeap() override { return inner->ValidateHeap(); }
+		virtual void UpdateStats() override { inner->UpdateStats(); }
+		virtual void GetAllocatorStats(FGenericMemoryStats& out_Stats) override { inner->GetAllocatorStats(out_Stats); }
+		virtual void DumpAllocatorStats(FOutputDevice& Ar) override { inner->DumpAllocatorStats(Ar); }
+		virtual const TCHAR* GetDescriptiveName() override { return inner->GetDescriptiveName(); }
+
+	private:
+		void Count() {
+			if (bCounting.load(std::memory_order_relaxed) && IsInGameThread()) {
+				allocations.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		FMalloc* inner;
+	};
+
+	FCountingMalloc* proxy = nullptr;
+}
+
+void FAllocationCounter::Install() {
+	if (proxy != nullptr || !FParse::Param(FCommandLine::Get(), TEXT("CountAllocations"))) {
+		return;
+	}
+	// Never removed: anything allocated through it has to be freeable through GMalloc later on.
+	proxy = new FCountingMalloc(GMalloc);
+	GMalloc = proxy;
+	UE_LOG(LogTemp, Display, TEXT("Counting game thread allocations for benchmarks (-CountAllocations)"));
+}
+
+bool FAllocationCounter::IsInstalled() {
+	return proxy != nullptr;
+}
+
+void FAllocationCounter::Start() {
+	check(IsInGameThread());
+	allocations = 0;
+	bCounting = proxy != nullptr;
+}
+
+uint64 FAllocationCounter::Stop() {
+	bCounting = false;
+	return allocations.load();
+}
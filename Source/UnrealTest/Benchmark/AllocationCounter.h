@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Counts heap allocations made on the game thread, for benchmarks that report allocations per operation.
+ * Counting needs GMalloc wrapped in a forwarding proxy. Swapping GMalloc while other threads are allocating isn't safe, so that only
+ * happens once, while the game module starts up, and only with -CountAllocations on the command line. Without it nothing is counted.
+ */
+class UNREALTEST_API FAllocationCounter {
+public:
+	/** Wraps GMalloc in the counting proxy if the command line asks for it. Only call this from the module's startup. */
+	static void Install();
+
+	/** Whether the proxy is installed, so counts mean anything. */
+	static bool IsInstalled();
+
+	/** Starts counting game thread allocations from zero. */
+	static void Start();
+
+	/** Stops counting and returns how many allocations were made since Start. Always 0 if the proxy isn't installed. */
+	static uint64 Stop();
+};
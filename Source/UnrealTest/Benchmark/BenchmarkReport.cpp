@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BenchmarkReport.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/FileManager.h"
+
+void FBenchmarkReport::AddRow() {
+	rows.AddDefaulted();
+}
+
+void FBenchmarkReport::SetCell(const FString& column, FCell cell) {
+	if (rows.Num() == 0) {
+		AddRow();
+	}
+	columns.AddUnique(column);
+	rows.Last().Add(column, MoveTemp(cell));
+}
+
+void FBenchmarkReport::Set(const FString& column, double value) {
+	SetCell(column, { FString::Printf(TEXT("%.4f"), value), true });
+}
+
+void FBenchmarkReport::Set(const FString& column, int64 value) {
+	SetCell(column, { FString::Printf(TEXT("%lld"), value), true });
+}
+
+void FBenchmarkReport::Set(const FString& column, const FString& value) {
+	SetCell(column, { value, false });
+}
+
+bool FBenchmarkReport::Write() const {
+	const FString directory = FPaths::ProjectSavedDir() / TEXT("Benchmarks");
+	IFileManager::Get().MakeDirectory(*directory, true);
+
+	const FString csvPath = directory / (name + TEXT(".csv"));
+	const FString jsonPath = directory / (name + TEXT(".json"));
+
+	const FString header = FString::Join(columns, TEXT(","));
+	bool bNewFile = !IFileManager::Get().FileExists(*csvPath);
+	if (!bNewFile) {
+		// Runs from a build with different columns would end up under the wrong header, so that file gets moved aside instead.
+		FString existing;
+		FFileHelper::LoadFileToString(existing, *csvPath);
+		FString existingHeader;
+		if (!existing.Split(TEXT("\n"), &existingHeader, nullptr)) {
+			existingHeader = existing;
+		}
+		existingHeader.TrimEndInline();
+		if (existingHeader != header) {
+			const FString movedPath = directory / FString::Printf(TEXT("%s-%s.csv"), *name, *FDateTime::Now().ToString());
+			IFileManager::Get().Move(*movedPath, *csvPath);
+			UE_LOG(LogTemp, Display, TEXT("Benchmark %s columns changed, moved the old results to %s"), *name, *movedPath);
+			bNewFile = true;
+		}
+	}
+
+	FString csv;
+	// Only write the header for a new file, so appended runs line up under it.
+	if (bNewFile) {
+		csv += header + LINE_TERMINATOR;
+	}
+	for (const TMap<FString, FCell>& row : rows) {
+		TArray<FString> cells;
+		for (const FString& column : columns) {
+			const FCell* cell = row.Find(column);
+			cells.Add(cell ? (cell->bIsNumber ? cell->text : TEXT("\"") + cell->text.Replace(TEXT("\""), TEXT("\"\"")) + TEXT("\"")) : FString());
+		}
+		csv += FString::Join(cells, TEXT(",")) + LINE_TERMINATOR;
+	}
+
+	FString json = TEXT("[") LINE_TERMINATOR;
+	for (int32 i = 0; i < rows.Num(); i++) {
+		TArray<FString> fields;
+		for (const FString& column : columns) {
+			if (const FCell* cell = rows[i].Find(column)) {
+				const FString value = cell->bIsNumber ? cell->text : TEXT("\"") + cell->text.ReplaceCharWithEscapedChar() + TEXT("\"");
+				fields.Add(FString::Printf(TEXT("\"%s\": %s"), *column, *value));
+			}
+		}
+		json += TEXT("  { ") + FString::Join(fields, TEXT(", ")) + (i + 1 < rows.Num() ? TEXT(" },") : TEXT(" }")) + LINE_TERMINATOR;
+	}
+	json += TEXT("]") LINE_TERMINATOR;
+
+	const bool wroteCsv = FFileHelper::SaveStringToFile(csv, *csvPath, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append);
+	const bool wroteJson = FFileHelper::SaveStringToFile(json, *jsonPath);
+	UE_LOG(LogTemp, Display, TEXT("Benchmark %s written to %s and %s"), *name, *csvPath, *jsonPath);
+	return wroteCsv && wroteJson;
+}
+
+double FBenchmarkReport::Percentile(TArray<double>& samples, double p) {
+	if (samples.Num() == 0) {
+		return 0.0;
+	}
+	samples.Sort();
+	const int32 index = FMath::Clamp(FMath::CeilToInt(p * samples.Num()) - 1, 0, samples.Num() - 1);
+	return samples[index];
+}
+
+double FBenchmarkReport::Mean(TArrayView<const double> samples) {
+	if (samples.Num() == 0) {
+		return 0.0;
+	}
+	double total = 0.0;
+	for (double sample : samples) {
+		total += sample;
+	}
+	return total / samples.Num();
+}
@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * A table of benchmark results that can be written out as CSV and JSON under Saved/Benchmarks.
+ * Every row should set the same columns. Columns come out in the order they were first set.
+ */
+class UNREALTEST_API FBenchmarkReport {
+public:
+	explicit FBenchmarkReport(const FString& name) : name(name) {}
+
+	/** Starts a new row. The Set calls after this fill it in. */
+	void AddRow();
+
+	void Set(const FString& column, double value);
+	void Set(const FString& column, int64 value);
+	void Set(const FString& column, int32 value) { Set(column, (int64)value); }
+	void Set(const FString& column, const FString& value);
+
+	/**
+	 * Writes Saved/Benchmarks/<name>.csv and .json. The CSV is appended to if it already exists with the same columns, so runs can be compared.
+	 * One with different columns is renamed to <name>-<date>.csv first. Returns false if either write failed.
+	 */
+	bool Write() const;
+
+	/** p is between 0 and 1. Sorts samples in place. */
+	static double Percentile(TArray<double>& samples, double p);
+
+	static double Mean(TArrayView<const double> samples);
+
+private:
+	struct FCell {
+		FString text;
+		bool bIsNumber = true;
+	};
+
+	void SetCell(const FString& column, FCell cell);
+
+	FString name;
+	TArray<FString> columns;
+	TArray<TMap<FString, FCell>> rows;
+};
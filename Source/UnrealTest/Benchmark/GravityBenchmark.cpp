@@ -0,0 +1,360 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityBenchmark.h"
+#include "UnrealTest/FP_Character/UnrealTestCharacter.h"
+#include "UnrealTest/Movement/CharacterGravityComponent.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "Components/StaticMeshComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Parse.h"
+
+static FAutoConsoleCommandWithWorldAndArgs GStartGravityBenchmark(
+	TEXT("ut.Bench.Gravity"),
+	TEXT("Runs the gravity movement benchmark. Arguments: Counts=10,50,100 Warmup= Duration= (seconds per count) ShiftInterval= DropHeight= CompareBallistic=0/1 Quit=0/1"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World) {
+		if (World == nullptr) {
+			return;
+		}
+		AGravityBenchmark* benchmark = World->SpawnActor<AGravityBenchmark>();
+		if (benchmark != nullptr) {
+			benchmark->StartBenchmark(AGravityBenchmark::FSettings::Parse(FString::Join(Args, TEXT(" "))));
+		}
+	})
+);
+
+namespace {
+	bool IsBallisticFallEnabled() {
+		const IConsoleVariable* ballisticFall = IConsoleManager::Get().FindConsoleVariable(TEXT("ut.Movement.BallisticFall"));
+		return ballisticFall != nullptr && ballisticFall->GetBool();
+	}
+
+	// The lanes are laid out side by side along Y.
+	const float LaneLength = 4000.0f;
+	const float LaneGap = 500.0f;
+	const float CharacterSpacing = 200.0f;
+	const int32 LaneCount = 3;
+}
+
+AGravityBenchmark::FSettings AGravityBenchmark::FSettings::Parse(const FString& args) {
+	FSettings parsed;
+	FString counts;
+	if (FParse::Value(*args, TEXT("Counts="), counts, false)) {
+		TArray<FString> parts;
+		counts.ParseIntoArray(parts, TEXT(","));
+		if (parts.Num() > 0) {
+			parsed.Counts.Reset();
+			for (const FString& part : parts) {
+				parsed.Counts.Add(FMath::Max(FCString::Atoi(*part), 1));
+			}
+		}
+		else {
+			UE_LOG(LogTemp, Warning, TEXT("Gravity benchmark: no counts in Counts=%s, using the defaults"), *counts);
+		}
+	}
+	FParse::Value(*args, TEXT("Warmup="), parsed.Warmup);
+	FParse::Value(*args, TEXT("Duration="), parsed.Duration);
+	FParse::Value(*args, TEXT("ShiftInterval="), parsed.ShiftInterval);
+	FParse::Value(*args, TEXT("DropHeight="), parsed.DropHeight);
+	FParse::Bool(*args, TEXT("CompareBallistic="), parsed.bCompareBallistic);
+	FParse::Bool(*args, TEXT("Quit="), parsed.bQuitWhenDone);
+	return parsed;
+}
+
+AGravityBenchmark::AGravityBenchmark() {
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+	// After the characters have moved, so the counters cover the whole frame.
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+
+	CharacterClass = TSoftClassPtr<ACharacter>(FSoftObjectPath(TEXT("/Script/UnrealTest.UnrealTestCharacter")));
+	GeometryMesh = TSoftObjectPtr<UStaticMesh>(FSoftObjectPath(TEXT("/Engine/BasicShapes/Cube.Cube")));
+}
+
+void AGravityBenchmark::StartBenchmark(const FSettings& newSettings) {
+	settings = newSettings;
+	timestamp = FDateTime::Now().ToIso8601();
+	SetActorLocation(Origin);
+	SpawnGeometry();
+
+	if (IConsoleVariable* ballisticFall = IConsoleManager::Get().FindConsoleVariable(TEXT("ut.Movement.BallisticFall"))) {
+		bSavedBallisticFall = ballisticFall->GetBool();
+	}
+
+	phase = 0;
+	SetActorTickEnabled(true);
+	StartPhase();
+}
+
+AActor* AGravityBenchmark::SpawnBox(FVector center, FVector size, FRotator rotation) {
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	AStaticMeshActor* box = GetWorld()->SpawnActor<AStaticMeshActor>(center, rotation, spawnParams);
+	if (box != nullptr) {
+		// Spawned actors start out static, which won't take a new mesh.
+		box->SetMobility(EComponentMobility::Movable);
+		box->GetStaticMeshComponent()->SetStaticMesh(GeometryMesh.LoadSynchronous());
+		// The basic shapes are 100 units across.
+		box->SetActorScale3D(size / 100.0f);
+		geometry.Add(box);
+	}
+	return box;
+}
+
+void AGravityBenchmark::SpawnGeometry() {
+	int32 mostCharacters = 1;
+	for (int32 count : settings.Counts) {
+		mostCharacters = FMath::Max(mostCharacters, count);
+	}
+
+	// Wide enough that the most characters we'll ever have can stand side by side in a few rows.
+	const int32 perLane = FMath::DivideAndRoundUp(mostCharacters, LaneCount);
+	const float laneWidth = FMath::Max(FMath::CeilToInt(FMath::Sqrt((float)perLane)) * CharacterSpacing, 1000.0f);
+
+	for (int32 lane = 0; lane < LaneCount; lane++) {
+		const FVector laneStart = Origin + FVector(0.0f, lane * (laneWidth + LaneGap), 0.0f);
+		const FVector laneCenter = laneStart + FVector(LaneLength * 0.5f, laneWidth * 0.5f, 0.0f);
+
+		// Every lane gets a floor.
+		SpawnBox(laneCenter - FVector(0.0f, 0.0f, 50.0f), FVector(LaneLength, laneWidth, 100.0f), FRotator::ZeroRotator);
+
+		if (lane == 1) {
+			// A 15 degree ramp up to a platform.
+			const float rampLength = 1500.0f;
+			const float pitch = 15.0f;
+			const float rise = rampLength * FMath::Sin(FMath::DegreesToRadians(pitch));
+			SpawnBox(laneStart + FVector(1500.0f + rampLength * 0.5f, laneWidth * 0.5f, rise * 0.5f - 50.0f), FVector(rampLength, laneWidth, 100.0f), FRotator(pitch, 0.0f, 0.0f));
+			SpawnBox(laneStart + FVector(1500.0f + rampLength + 500.0f, laneWidth * 0.5f, rise * 0.5f), FVector(1000.0f, laneWidth, rise), FRotator::ZeroRotator);
+		}
+		else if (lane == 2) {
+			// Stairs that are each low enough to step up.
+			const float stepHeight = 25.0f;
+			const float stepDepth = 150.0f;
+			for (int32 step = 0; step < 8; step++) {
+				const float height = stepHeight * (step + 1);
+				SpawnBox(laneStart + FVector(1500.0f + step * stepDepth + stepDepth * 0.5f, laneWidth * 0.5f, height * 0.5f), FVector(stepDepth, laneWidth, height), FRotator::ZeroRotator);
+			}
+		}
+	}
+}
+
+void AGravityBenchmark::StartPhase() {
+	ClearCharacters();
+
+	const int32 runsPerCount = settings.bCompareBallistic ? 2 : 1;
+	if (phase < 0 || phase >= settings.GetPhaseCount()) {
+		UE_LOG(LogTemp, Warning, TEXT("Gravity benchmark: no character count for phase %d, stopping"), phase);
+		phase = INDEX_NONE;
+		SetActorTickEnabled(false);
+		return;
+	}
+
+	const int32 count = settings.Counts[phase / runsPerCount];
+	if (settings.bCompareBallistic) {
+		// Off first, then on.
+		if (IConsoleVariable* ballisticFall = IConsoleManager::Get().FindConsoleVariable(TEXT("ut.Movement.BallisticFall"))) {
+			ballisticFall->Set(phase % runsPerCount == 1, ECVF_SetByCode);
+		}
+	}
+	UClass* characterClass = CharacterClass.LoadSynchronous();
+	if (characterClass == nullptr) {
+		characterClass = AUnrealTestCharacter::StaticClass();
+	}
+
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	const int32 perLane = FMath::DivideAndRoundUp(count, LaneCount);
+	const int32 perRow = FMath::Max(FMath::CeilToInt(FMath::Sqrt((float)perLane)), 1);
+	const float laneWidth = geometry.Num() > 0 ? geometry[0]->GetActorScale3D().Y * 100.0f : 1000.0f;
+
+	for (int32 i = 0; i < count; i++) {
+		const int32 lane = i % LaneCount;
+		const int32 slot = i / LaneCount;
+		const FVector location = Origin + FVector(100.0f + (slot / perRow) * CharacterSpacing, lane * (laneWidth + LaneGap) + 100.0f + (slot % perRow) * CharacterSpacing, 120.0f + settings.DropHeight);
+
+		ACharacter* character = GetWorld()->SpawnActor<ACharacter>(characterClass, location, FRotator::ZeroRotator, spawnParams);
+		if (character == nullptr) {
+			continue;
+		}
+
+		UCharacterGravityComponent* movement = Cast<UCharacterGravityComponent>(character->GetCharacterMovement());
+		if (movement != nullptr) {
+			// Nobody possesses these, but they still need to move.
+			movement->bRunPhysicsWithNoController = true;
+			movement->SetMovementMode(EMovementMode::MOVE_Custom, CUSTOM_GRAVITY_FALL);
+		}
+		characters.Add(character);
+		startLocations.Add(location);
+	}
+
+	phaseTime = 0.0f;
+	bMeasuring = false;
+	timeUntilShift = settings.ShiftInterval;
+	shifts = 0;
+	frameMovementMs.Reset();
+	measuredFrames = 0;
+
+	UE_LOG(LogTemp, Display, TEXT("Gravity benchmark: measuring %d characters"), characters.Num());
+}
+
+void AGravityBenchmark::ShiftGravity() {
+	// Tip gravity 30 degrees to one side, back to straight down, then to the other side.
+	static const float angles[] = { 30.0f, 0.0f, -30.0f, 0.0f };
+	const float angle = angles[shifts % UE_ARRAY_COUNT(angles)];
+	shifts++;
+
+	const FVector gravity = FRotator(0.0f, 0.0f, angle).RotateVector(FVector::DownVector * 9.8f);
+	for (ACharacter* character : characters) {
+		if (UCharacterGravityComponent* movement = IsValid(character) ? Cast<UCharacterGravityComponent>(character->GetCharacterMovement()) : nullptr) {
+			movement->GravityShift(gravity);
+		}
+	}
+}
+
+void AGravityBenchmark::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+	if (phase == INDEX_NONE) {
+		return;
+	}
+
+	phaseTime += DeltaTime;
+
+	// Keep everyone walking forward, and send them back to the start when they run out of lane.
+	double movementSeconds = 0.0;
+	for (int32 i = 0; i < characters.Num(); i++) {
+		ACharacter* character = characters[i];
+		if (!IsValid(character)) {
+			continue;
+		}
+
+		if (character->GetActorLocation().X > Origin.X + LaneLength - 200.0f || character->GetActorLocation().Z < Origin.Z - 2000.0f) {
+			character->TeleportTo(startLocations[i], FRotator::ZeroRotator);
+		}
+		character->AddMovementInput(FVector::ForwardVector, 1.0f);
+
+		if (UCharacterGravityComponent* movement = Cast<UCharacterGravityComponent>(character->GetCharacterMovement())) {
+			movementSeconds += movement->GetCounters().Seconds;
+		}
+	}
+
+	timeUntilShift -= DeltaTime;
+	if (timeUntilShift <= 0.0f) {
+		timeUntilShift += settings.ShiftInterval;
+		ShiftGravity();
+	}
+
+	if (bMeasuring) {
+		// The counters only ever go up, so this frame's share is the difference from last frame.
+		frameMovementMs.Add((movementSeconds - lastMovementSeconds) * 1000.0);
+		lastMovementSeconds = movementSeconds;
+		measuredFrames++;
+	}
+	else if (phaseTime >= settings.Warmup) {
+		bMeasuring = true;
+		lastMovementSeconds = 0.0;
+		for (ACharacter* character : characters) {
+			if (UCharacterGravityComponent* movement = IsValid(character) ? Cast<UCharacterGravityComponent>(character->GetCharacterMovement()) : nullptr) {
+				movement->ResetCounters();
+			}
+		}
+	}
+
+	if (phaseTime >= settings.Warmup + settings.Duration) {
+		FinishPhase();
+	}
+}
+
+void AGravityBenchmark::FinishPhase() {
+	uint64 ticks = 0;
+	uint64 sweeps = 0;
+	uint64 iterations = 0;
+	uint64 stepUps = 0;
+	uint64 stepUpFailures = 0;
+	uint64 ballisticTicks = 0;
+	uint64 fallTicks = 0;
+	uint64 fallSweeps = 0;
+	for (ACharacter* character : characters) {
+		if (UCharacterGravityComponent* movement = IsValid(character) ? Cast<UCharacterGravityComponent>(character->GetCharacterMovement()) : nullptr) {
+			ticks += movement->GetCounters().Ticks;
+			sweeps += movement->GetCounters().Sweeps;
+			iterations += movement->GetCounters().Iterations;
+			stepUps += movement->GetCounters().StepUps;
+			stepUpFailures += movement->GetCounters().StepUpFailures;
+			ballisticTicks += movement->GetCounters().BallisticTicks;
+			fallTicks += movement->GetCounters().FallTicks;
+			fallSweeps += movement->GetCounters().FallSweeps;
+		}
+	}
+
+	const int32 count = FMath::Max(characters.Num(), 1);
+	const double meanFrameMs = FBenchmarkReport::Mean(frameMovementMs);
+
+	report.AddRow();
+	report.Set(TEXT("timestamp"), timestamp);
+	report.Set(TEXT("characters"), characters.Num());
+	report.Set(TEXT("frames"), measuredFrames);
+	report.Set(TEXT("gravity_shifts"), shifts);
+	report.Set(TEXT("movement_ms_per_frame_mean"), meanFrameMs);
+	report.Set(TEXT("movement_ms_per_frame_p99"), FBenchmarkReport::Percentile(frameMovementMs, 0.99));
+	report.Set(TEXT("movement_us_per_character"), meanFrameMs * 1000.0 / count);
+	report.Set(TEXT("sweeps_per_tick"), ticks > 0 ? (double)sweeps / ticks : 0.0);
+	report.Set(TEXT("iterations_per_tick"), ticks > 0 ? (double)iterations / ticks : 0.0);
+	report.Set(TEXT("step_ups_per_tick"), ticks > 0 ? (double)stepUps / ticks : 0.0);
+	report.Set(TEXT("step_up_failures_per_tick"), ticks > 0 ? (double)stepUpFailures / ticks : 0.0);
+	report.Set(TEXT("ballistic_ticks_per_tick"), ticks > 0 ? (double)ballisticTicks / ticks : 0.0);
+	report.Set(TEXT("drop_height"), (double)settings.DropHeight);
+	report.Set(TEXT("ballistic_fall"), IsBallisticFallEnabled() ? 1 : 0);
+	report.Set(TEXT("fall_ticks_per_tick"), ticks > 0 ? (double)fallTicks / ticks : 0.0);
+	// Compare this between ballistic_fall 0 and 1 rows: the substeps sweep at least once a falling tick, a cleared arc only every BallisticRecheckInterval.
+	report.Set(TEXT("sweeps_per_fall_tick"), fallTicks > 0 ? (double)fallSweeps / fallTicks : 0.0);
+
+	phase++;
+	if (phase < settings.GetPhaseCount()) {
+		StartPhase();
+		return;
+	}
+
+	// Written once at the end, so the JSON holds every count from this run.
+	report.Write();
+
+	phase = INDEX_NONE;
+	const bool quit = settings.bQuitWhenDone;
+	Destroy();
+
+	if (quit) {
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+void AGravityBenchmark::ClearCharacters() {
+	for (ACharacter* character : characters) {
+		if (IsValid(character)) {
+			character->Destroy();
+		}
+	}
+	characters.Empty();
+	startLocations.Empty();
+}
+
+void AGravityBenchmark::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+	ClearCharacters();
+	if (settings.bCompareBallistic) {
+		if (IConsoleVariable* ballisticFall = IConsoleManager::Get().FindConsoleVariable(TEXT("ut.Movement.BallisticFall"))) {
+			ballisticFall->Set(bSavedBallisticFall, ECVF_SetByCode);
+		}
+	}
+	for (AActor* box : geometry) {
+		if (IsValid(box)) {
+			box->Destroy();
+		}
+	}
+	geometry.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
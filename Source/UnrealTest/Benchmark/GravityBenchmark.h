@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "BenchmarkReport.h"
+#include "GravityBenchmark.generated.h"
+
+class ACharacter;
+class UStaticMesh;
+
+/**
+ * Measures what UCharacterGravityComponent costs per character, at several character counts.
+ * Start it with the ut.Bench.Gravity console command, for example headless:
+ *
+ *   UnrealEditor UnrealTest.uproject /Game/FirstPerson/Maps/FirstPersonMap -game -nullrhi -unattended
+ *       -ExecCmds="ut.Bench.Gravity Counts=10,50,200 Duration=10 Quit=1"
+ *
+ * DropHeight starts (and restarts) the characters that high above their lanes, so every loop includes a fall. CompareBallistic=1 runs each
+ * count twice, with ut.Movement.BallisticFall off and then on, so sweeps_per_fall_tick can be compared between the two.
+ *
+ * Characters walk forward in the custom gravity modes across three lanes (flat, a ramp and a flight of steps), looping back to the start,
+ * while gravity is tilted back and forth with GravityShift every ShiftInterval seconds.
+ * Results go to Saved/Benchmarks/GravityBenchmark.csv (one row per count per run) and .json.
+ */
+UCLASS(config=Game)
+class UNREALTEST_API AGravityBenchmark : public AActor
+{
+	GENERATED_BODY()
+public:
+	struct FSettings {
+		TArray<int32> Counts = { 10, 50, 100 };
+		float Warmup = 1.0f;
+		float Duration = 10.0f;
+		float ShiftInterval = 2.0f;
+		float DropHeight = 0.0f;
+		bool bCompareBallistic = false;
+		bool bQuitWhenDone = false;
+
+		/** Each count is one phase, or two with bCompareBallistic. */
+		int32 GetPhaseCount() const { return Counts.Num() * (bCompareBallistic ? 2 : 1); }
+
+		/** Reads Name=Value pairs, leaving anything missing at its default. Counts is comma separated. */
+		static FSettings Parse(const FString& args);
+	};
+
+	AGravityBenchmark();
+
+	void StartBenchmark(const FSettings& settings);
+
+	virtual void Tick(float DeltaTime) override;
+
+public:
+	/** Needs to use UCharacterGravityComponent as its movement component. */
+	UPROPERTY(config)
+	TSoftClassPtr<ACharacter> CharacterClass;
+
+	UPROPERTY(config)
+	TSoftObjectPtr<UStaticMesh> GeometryMesh;
+
+	/** Where the test geometry goes. */
+	UPROPERTY(config)
+	FVector Origin = FVector(0.0f, 0.0f, 20000.0f);
+
+protected:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	void SpawnGeometry();
+
+	AActor* SpawnBox(FVector center, FVector size, FRotator rotation);
+
+	void StartPhase();
+
+	void FinishPhase();
+
+	void ClearCharacters();
+
+	void ShiftGravity();
+
+	FSettings settings;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AActor>> geometry;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<ACharacter>> characters;
+
+	TArray<FVector> startLocations;
+
+	int32 phase = INDEX_NONE;
+	float phaseTime = 0.0f;
+	bool bMeasuring = false;
+	float timeUntilShift = 0.0f;
+	int32 shifts = 0;
+
+	TArray<double> frameMovementMs;
+	int32 measuredFrames = 0;
+	double lastMovementSeconds = 0.0;
+
+	/** ut.Movement.BallisticFall from before CompareBallistic started changing it, to put back afterwards. */
+	bool bSavedBallisticFall = true;
+
+	FBenchmarkReport report = FBenchmarkReport(TEXT("GravityBenchmark"));
+
+	FString timestamp;
+};
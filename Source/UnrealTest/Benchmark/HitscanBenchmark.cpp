@@ -0,0 +1,260 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HitscanBenchmark.h"
+#include "BenchmarkReport.h"
+#include "AllocationCounter.h"
+#include "UnrealTest/Enemies/Enemy.h"
+#include "UnrealTest/FP_Character/TP_WeaponComponent.h"
+#include "UnrealTest/FP_Character/ProjectileSimulationSubsystem.h"
+#include "UnrealTest/Effects/ImpactDecalSubsystem.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "Components/StaticMeshComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Parse.h"
+
+static FAutoConsoleCommandWithWorldAndArgs GStartHitscanBenchmark(
+	TEXT("ut.Bench.Hitscan"),
+	TEXT("Runs the hitscan benchmark. Arguments: Enemies= Props= Pellets= Rate= (shots per second) Duration= (seconds) Async=0/1 Projectiles=0/1 Quit=0/1"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World) {
+		if (World == nullptr) {
+			return;
+		}
+		AHitscanBenchmark* benchmark = World->SpawnActor<AHitscanBenchmark>();
+		if (benchmark != nullptr) {
+			benchmark->StartBenchmark(AHitscanBenchmark::FSettings::Parse(FString::Join(Args, TEXT(" "))));
+		}
+	})
+);
+
+AHitscanBenchmark::FSettings AHitscanBenchmark::FSettings::Parse(const FString& args) {
+	FSettings parsed;
+	FParse::Value(*args, TEXT("Enemies="), parsed.Enemies);
+	FParse::Value(*args, TEXT("Props="), parsed.Props);
+	FParse::Value(*args, TEXT("Pellets="), parsed.Pellets);
+	FParse::Value(*args, TEXT("Rate="), parsed.ShotsPerSecond);
+	FParse::Value(*args, TEXT("Duration="), parsed.Duration);
+	FParse::Bool(*args, TEXT("Async="), parsed.bAsync);
+	FParse::Bool(*args, TEXT("Projectiles="), parsed.bProjectiles);
+	FParse::Bool(*args, TEXT("Quit="), parsed.bQuitWhenDone);
+
+	parsed.Pellets = FMath::Max(parsed.Pellets, 1);
+	parsed.ShotsPerSecond = FMath::Max(parsed.ShotsPerSecond, 0.1f);
+	return parsed;
+}
+
+AHitscanBenchmark::AHitscanBenchmark() {
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+
+	EnemyClass = TSoftClassPtr<AEnemy>(FSoftObjectPath(TEXT("/Game/Enemies/BaseEnemy.BaseEnemy_C")));
+	PropMesh = TSoftObjectPtr<UStaticMesh>(FSoftObjectPath(TEXT("/Engine/BasicShapes/Cube.Cube")));
+	DecalMaterial = TSoftObjectPtr<UMaterialInterface>(FSoftObjectPath(TEXT("/Engine/EngineMaterials/DefaultDeferredDecalMaterial.DefaultDeferredDecalMaterial")));
+}
+
+void AHitscanBenchmark::StartBenchmark(const FSettings& newSettings) {
+	settings = newSettings;
+	SetActorLocation(Origin);
+	SpawnTargets();
+
+	Weapon = NewObject<UTP_WeaponComponent>(this, TEXT("BenchmarkWeapon"));
+	Weapon->bBatchAsyncTraces = settings.bAsync;
+	if (settings.bProjectiles) {
+		Weapon->FireMode = EWeaponFireMode::SimulatedProjectile;
+		if (UProjectileSimulationSubsystem* simulation = GetWorld()->GetSubsystem<UProjectileSimulationSubsystem>()) {
+			simulation->bAsyncSweeps = settings.bAsync;
+		}
+	}
+	DecalMaterial.LoadSynchronous();
+	Weapon->DefaultFiringDecal = DecalMaterial;
+	// Seeded, so every run with the same settings fires the same pellets.
+	Weapon->SpreadPattern.Mode = EBulletSpreadMode::SeededRandom;
+	Weapon->SpreadPattern.PelletCount = settings.Pellets;
+	Weapon->SpreadPattern.ConeHalfAngle = settings.Pellets > 1 ? 4.0f : 0.0f;
+	Weapon->SpreadPattern.Seed = 1234;
+	Weapon->SpreadPattern.Variants = 8;
+	Weapon->SetupAttachment(RootComponent);
+	Weapon->RegisterComponent();
+
+	fireMs.Reset();
+	resolveCost = UTP_WeaponComponent::FAsyncResolveCost();
+	Weapon->AsyncResolveCost = &resolveCost;
+	frameMs.Reset();
+	allocations = 0;
+	maxLiveDecals = 0;
+	simulationMs.Reset();
+	shots = 0;
+	elapsed = 0.0f;
+	timeUntilShot = 0.0f;
+	bRunning = true;
+	SetActorTickEnabled(true);
+
+	UE_LOG(LogTemp, Display, TEXT("Hitscan benchmark started: %d enemies, %d props, %d pellets, %.1f shots/s for %.1fs (%s%s)"),
+		settings.Enemies, settings.Props, settings.Pellets, settings.ShotsPerSecond, settings.Duration, settings.bAsync ? TEXT("async") : TEXT("sync"), settings.bProjectiles ? TEXT(" projectiles") : TEXT(""));
+}
+
+void AHitscanBenchmark::SpawnTargets() {
+	UWorld* world = GetWorld();
+	UStaticMesh* cube = PropMesh.LoadSynchronous();
+	UClass* enemyClass = EnemyClass.LoadSynchronous();
+	if (enemyClass == nullptr) {
+		enemyClass = AEnemy::StaticClass();
+	}
+
+	// Enemies in rows in front of the gun, with the props in rows behind them.
+	const float spacing = 250.0f;
+	const int32 perRow = FMath::Max(FMath::CeilToInt(FMath::Sqrt((float)FMath::Max(settings.Enemies, settings.Props))), 1);
+	const float rowWidth = perRow * spacing;
+	const FVector firstRow = Origin + FVector(1500.0f, -rowWidth * 0.5f, 0.0f);
+
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	// The floor is a flattened cube (the basic shapes are 100 units across) big enough for both blocks of targets.
+	if (AStaticMeshActor* floor = world->SpawnActor<AStaticMeshActor>(Origin + FVector(1500.0f + rowWidth, 0.0f, -150.0f), FRotator::ZeroRotator, spawnParams)) {
+		// Spawned actors start out static, which won't take a new mesh.
+		floor->SetMobility(EComponentMobility::Movable);
+		floor->GetStaticMeshComponent()->SetStaticMesh(cube);
+		floor->SetActorScale3D(FVector((rowWidth * 2.0f + 3000.0f) / 100.0f, (rowWidth + 2000.0f) / 100.0f, 1.0f));
+		spawnedActors.Add(floor);
+	}
+
+	for (int32 i = 0; i < settings.Enemies; i++) {
+		const FVector location = firstRow + FVector((i / perRow) * spacing, (i % perRow) * spacing, 0.0f);
+		if (AEnemy* enemy = world->SpawnActor<AEnemy>(enemyClass, location, FRotator(0.0f, 180.0f, 0.0f), spawnParams)) {
+			// They need to survive the whole run to stay targets.
+			enemy->SetHP(TNumericLimits<float>::Max());
+			spawnedActors.Add(enemy);
+		}
+	}
+
+	const FVector propsStart = firstRow + FVector(rowWidth + spacing, 0.0f, 0.0f);
+	for (int32 i = 0; i < settings.Props; i++) {
+		const FVector location = propsStart + FVector((i / perRow) * spacing, (i % perRow) * spacing, 0.0f);
+		if (AStaticMeshActor* prop = world->SpawnActor<AStaticMeshActor>(location, FRotator::ZeroRotator, spawnParams)) {
+			prop->SetMobility(EComponentMobility::Movable);
+			prop->GetStaticMeshComponent()->SetStaticMesh(cube);
+			prop->GetStaticMeshComponent()->SetSimulatePhysics(true);
+			spawnedActors.Add(prop);
+		}
+	}
+}
+
+void AHitscanBenchmark::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+	if (!bRunning) {
+		return;
+	}
+
+	elapsed += DeltaTime;
+	frameMs.Add(DeltaTime * 1000.0);
+
+	// The simulation ticks after actors, so this is last frame's.
+	if (settings.bProjectiles) {
+		if (UProjectileSimulationSubsystem* simulation = GetWorld()->GetSubsystem<UProjectileSimulationSubsystem>()) {
+			simulationMs.Add(simulation->GetStats().LastFrameMs);
+		}
+	}
+
+	timeUntilShot -= DeltaTime;
+	while (timeUntilShot <= 0.0f) {
+		timeUntilShot += 1.0f / settings.ShotsPerSecond;
+		FireOnce();
+	}
+
+	if (elapsed >= settings.Duration) {
+		FinishBenchmark();
+	}
+}
+
+void AHitscanBenchmark::FireOnce() {
+	// Sweep back and forth across the targets so the shots don't all land on the same few.
+	const float yaw = FMath::Sin(shots * 0.37f) * 20.0f;
+	const float pitch = FMath::Sin(shots * 0.23f) * 3.0f - 2.0f;
+	const FVector forward = FRotator(pitch, yaw, 0.0f).Vector();
+
+	FAllocationCounter::Start();
+	const uint64 startCycles = FPlatformTime::Cycles64();
+
+	Weapon->FireFromView(Origin, forward);
+
+	const uint64 endCycles = FPlatformTime::Cycles64();
+	allocations += FAllocationCounter::Stop();
+
+	fireMs.Add(FPlatformTime::ToMilliseconds64(endCycles - startCycles));
+	shots++;
+
+	if (UImpactDecalSubsystem* decals = GetWorld()->GetSubsystem<UImpactDecalSubsystem>()) {
+		maxLiveDecals = FMath::Max(maxLiveDecals, decals->GetStats().LiveCount);
+	}
+}
+
+void AHitscanBenchmark::FinishBenchmark() {
+	bRunning = false;
+	SetActorTickEnabled(false);
+
+	if (Weapon != nullptr) {
+		Weapon->AsyncResolveCost = nullptr;
+	}
+
+	const int64 traces = (int64)shots * settings.Pellets;
+	// Sync shots resolve inside FireOnce. Async ones resolve later, and that has to count too.
+	const double fireMeanMs = FBenchmarkReport::Mean(fireMs);
+	const double resolveMeanMs = FBenchmarkReport::Mean(resolveCost.Ms);
+	const double totalShotSeconds = (fireMeanMs * fireMs.Num() + resolveMeanMs * resolveCost.Ms.Num()) / 1000.0;
+	const uint64 totalAllocations = allocations + resolveCost.Allocations;
+	UImpactDecalSubsystem* decals = GetWorld()->GetSubsystem<UImpactDecalSubsystem>();
+
+	FBenchmarkReport report(TEXT("HitscanBenchmark"));
+	report.AddRow();
+	report.Set(TEXT("timestamp"), FDateTime::Now().ToIso8601());
+	report.Set(TEXT("mode"), FString(settings.bAsync ? TEXT("async") : TEXT("sync")) + (settings.bProjectiles ? TEXT("_projectiles") : TEXT("")));
+	report.Set(TEXT("enemies"), settings.Enemies);
+	report.Set(TEXT("props"), settings.Props);
+	report.Set(TEXT("pellets"), settings.Pellets);
+	report.Set(TEXT("shots_per_second"), (double)settings.ShotsPerSecond);
+	report.Set(TEXT("shots"), shots);
+	report.Set(TEXT("traces"), traces);
+	report.Set(TEXT("traces_per_second"), totalShotSeconds > 0.0 ? traces / totalShotSeconds : 0.0);
+	report.Set(TEXT("fire_mean_ms"), fireMeanMs);
+	report.Set(TEXT("fire_p99_ms"), FBenchmarkReport::Percentile(fireMs, 0.99));
+	report.Set(TEXT("resolve_mean_ms"), resolveMeanMs);
+	report.Set(TEXT("resolve_p99_ms"), FBenchmarkReport::Percentile(resolveCost.Ms, 0.99));
+	report.Set(TEXT("shot_mean_ms"), shots > 0 ? totalShotSeconds * 1000.0 / shots : 0.0);
+	report.Set(TEXT("frame_mean_ms"), FBenchmarkReport::Mean(frameMs));
+	report.Set(TEXT("frame_p99_ms"), FBenchmarkReport::Percentile(frameMs, 0.99));
+	report.Set(TEXT("allocations_per_shot"), !FAllocationCounter::IsInstalled() ? -1.0 : shots > 0 ? (double)totalAllocations / shots : 0.0);
+	report.Set(TEXT("live_decals_max"), maxLiveDecals);
+	report.Set(TEXT("live_decals_end"), decals ? decals->GetStats().LiveCount : 0);
+	// Always written, so hitscan and projectile runs can share the CSV.
+	UProjectileSimulationSubsystem* simulation = settings.bProjectiles ? GetWorld()->GetSubsystem<UProjectileSimulationSubsystem>() : nullptr;
+	report.Set(TEXT("live_projectiles_max"), simulation ? simulation->GetStats().LiveMax : 0);
+	report.Set(TEXT("simulation_mean_ms"), FBenchmarkReport::Mean(simulationMs));
+	report.Set(TEXT("simulation_p99_ms"), FBenchmarkReport::Percentile(simulationMs, 0.99));
+	if (simulation != nullptr) {
+		simulation->Clear();
+	}
+	report.Write();
+
+	const bool quit = settings.bQuitWhenDone;
+	Destroy();
+
+	if (quit) {
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+void AHitscanBenchmark::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+	for (AActor* actor : spawnedActors) {
+		if (IsValid(actor)) {
+			actor->Destroy();
+		}
+	}
+	spawnedActors.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "UnrealTest/FP_Character/TP_WeaponComponent.h"
+#include "HitscanBenchmark.generated.h"
+
+class AEnemy;
+class UStaticMesh;
+
+/**
+ * Measures how UTP_WeaponComponent's fire path scales with target and pellet counts.
+ * Start it with the ut.Bench.Hitscan console command, for example headless:
+ *
+ *   UnrealEditor UnrealTest.uproject /Game/FirstPerson/Maps/FirstPersonMap -game -nullrhi -unattended
+ *       -ExecCmds="ut.Bench.Hitscan Enemies=200 Props=100 Pellets=8 Rate=10 Duration=10 Async=0 Quit=1"
+ *
+ * With Projectiles=1 the weapon fires simulated projectiles instead, and the simulation's own time is reported too.
+ * With Async=1 resolving the hits happens a frame after firing, so it's timed separately (resolve_*), and shot_mean_ms adds the two up.
+ * Allocations are only counted with -CountAllocations on the command line (see FAllocationCounter), and are -1 otherwise.
+ *
+ * Everything is spawned on its own floor at Origin, well away from the map, and cleaned up afterwards.
+ * Results go to Saved/Benchmarks/HitscanBenchmark.csv (one row per run) and .json.
+ */
+UCLASS(config=Game)
+class UNREALTEST_API AHitscanBenchmark : public AActor
+{
+	GENERATED_BODY()
+public:
+	struct FSettings {
+		int32 Enemies = 100;
+		int32 Props = 100;
+		int32 Pellets = 8;
+		float ShotsPerSecond = 10.0f;
+		float Duration = 10.0f;
+		bool bAsync = false;
+		/** Fire simulated projectiles instead of tracing. */
+		bool bProjectiles = false;
+		bool bQuitWhenDone = false;
+
+		/** Reads Name=Value pairs, leaving anything missing at its default. */
+		static FSettings Parse(const FString& args);
+	};
+
+	AHitscanBenchmark();
+
+	void StartBenchmark(const FSettings& settings);
+
+	virtual void Tick(float DeltaTime) override;
+
+public:
+	UPROPERTY(config)
+	TSoftClassPtr<AEnemy> EnemyClass;
+
+	UPROPERTY(config)
+	TSoftObjectPtr<UStaticMesh> PropMesh;
+
+	UPROPERTY(config)
+	TSoftObjectPtr<UMaterialInterface> DecalMaterial;
+
+	/** Where the test floor goes. */
+	UPROPERTY(config)
+	FVector Origin = FVector(0.0f, 0.0f, 20000.0f);
+
+protected:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	void SpawnTargets();
+
+	void FireOnce();
+
+	void FinishBenchmark();
+
+	FSettings settings;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UTP_WeaponComponent> Weapon;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AActor>> spawnedActors;
+
+	bool bRunning = false;
+	float elapsed = 0.0f;
+	float timeUntilShot = 0.0f;
+	int32 shots = 0;
+
+	TArray<double> fireMs;
+	/** With Async=1, hits are resolved when the traces come back, outside of FireOnce. */
+	UTP_WeaponComponent::FAsyncResolveCost resolveCost;
+	TArray<double> frameMs;
+	uint64 allocations = 0;
+	int32 maxLiveDecals = 0;
+	TArray<double> simulationMs;
+};
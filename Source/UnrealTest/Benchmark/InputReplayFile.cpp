@@ -0,0 +1,263 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "InputReplayFile.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/MemoryReader.h"
+
+namespace {
+	const uint32 Magic = 0x50525455; // "UTRP"
+	const uint16 Version = 1;
+	const int32 FlushSize = 64 * 1024;
+
+	enum EFrameFlags : uint8 {
+		DeltaChanged = 1 << 0,
+		MoveChanged = 1 << 1,
+		LookChanged = 1 << 2,
+		ButtonsChanged = 1 << 3,
+		GravityEvent = 1 << 4,
+		Checksum = 1 << 5,
+		// Never a valid combination of the above.
+		EndOfFile = 0xFF,
+	};
+
+	void WriteVarInt(TArray<uint8>& out, int32 value) {
+		// Zigzag, so small negative differences stay small too.
+		uint32 bits = ((uint32)value << 1) ^ (uint32)(value >> 31);
+		while (bits >= 0x80) {
+			out.Add((uint8)(bits | 0x80));
+			bits >>= 7;
+		}
+		out.Add((uint8)bits);
+	}
+
+	bool ReadVarInt(const TArray<uint8>& data, int32& offset, int32& out) {
+		uint32 bits = 0;
+		for (int32 shift = 0; shift < 35; shift += 7) {
+			if (offset >= data.Num()) {
+				return false;
+			}
+			const uint8 byte = data[offset++];
+			bits |= (uint32)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) {
+				out = (int32)(bits >> 1) ^ -(int32)(bits & 1);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ReadByte(const TArray<uint8>& data, int32& offset, uint8& out) {
+		if (offset >= data.Num()) {
+			return false;
+		}
+		out = data[offset++];
+		return true;
+	}
+
+	void WriteGravity(TArray<uint8>& out, const FQuantizedGravity& gravity) {
+		for (uint16 value : { gravity.x, gravity.y, gravity.strength }) {
+			out.Add((uint8)(value & 0xFF));
+			out.Add((uint8)(value >> 8));
+		}
+	}
+
+	bool ReadGravity(const TArray<uint8>& data, int32& offset, FQuantizedGravity& out) {
+		if (offset + 6 > data.Num()) {
+			return false;
+		}
+		out.x = data[offset] | (data[offset + 1] << 8);
+		out.y = data[offset + 2] | (data[offset + 3] << 8);
+		out.strength = data[offset + 4] | (data[offset + 5] << 8);
+		offset += 6;
+		return true;
+	}
+}
+
+void FInputReplayHeader::Serialize(FArchive& Ar) {
+	Ar << Map;
+	Ar << Location;
+	Ar << Rotation;
+	Ar << CameraRotation;
+	Ar << Velocity;
+	Ar << MovementMode;
+	Ar << CustomMovementMode;
+	Ar << Gravity;
+	Ar << ShiftedGravity;
+	Ar << GravityPreviousRotation;
+	Ar << GravityRotationCompletion;
+	Ar << bInGravityField;
+}
+
+FString InputReplay::GetPath(const FString& name) {
+	return FPaths::ProjectSavedDir() / TEXT("Replays") / (name + TEXT(".utreplay"));
+}
+
+FInputReplayWriter::~FInputReplayWriter() {
+	Close();
+}
+
+bool FInputReplayWriter::Open(const FString& path, FInputReplayHeader header) {
+	Close();
+
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(path), true);
+	file.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*path));
+	if (!file.IsValid()) {
+		return false;
+	}
+
+	buffer.Reset();
+	buffer.Reserve(FlushSize * 2);
+	bytesWritten = 0;
+	previous = FInputReplayFrame();
+
+	FMemoryWriter writer(buffer);
+	uint32 magic = Magic;
+	uint16 version = Version;
+	writer << magic;
+	writer << version;
+	header.Serialize(writer);
+	return true;
+}
+
+void FInputReplayWriter::Write(const FInputReplayFrame& frame) {
+	if (!file.IsValid()) {
+		return;
+	}
+
+	uint8 flags = 0;
+	flags |= frame.Delta != previous.Delta ? DeltaChanged : 0;
+	flags |= frame.Move != previous.Move ? MoveChanged : 0;
+	flags |= frame.Look != previous.Look ? LookChanged : 0;
+	flags |= frame.Buttons != previous.Buttons ? ButtonsChanged : 0;
+	flags |= frame.bGravityEvent ? GravityEvent : 0;
+	flags |= frame.bChecksum ? Checksum : 0;
+	buffer.Add(flags);
+
+	if (flags & DeltaChanged) {
+		WriteVarInt(buffer, frame.Delta - previous.Delta);
+	}
+	if (flags & MoveChanged) {
+		WriteVarInt(buffer, frame.Move.X - previous.Move.X);
+		WriteVarInt(buffer, frame.Move.Y - previous.Move.Y);
+	}
+	if (flags & LookChanged) {
+		WriteVarInt(buffer, frame.Look.X - previous.Look.X);
+		WriteVarInt(buffer, frame.Look.Y - previous.Look.Y);
+	}
+	if (flags & ButtonsChanged) {
+		buffer.Add(frame.Buttons);
+	}
+	if (flags & GravityEvent) {
+		buffer.Add(frame.ShiftId);
+		WriteGravity(buffer, frame.Gravity);
+		buffer.Add(frame.MovementMode);
+		buffer.Add(frame.CustomMovementMode);
+	}
+	if (flags & Checksum) {
+		WriteVarInt(buffer, frame.Location.X - previous.Location.X);
+		WriteVarInt(buffer, frame.Location.Y - previous.Location.Y);
+		WriteVarInt(buffer, frame.Location.Z - previous.Location.Z);
+	}
+
+	// Only the location from the last checksum is worth diffing against.
+	const FIntVector lastLocation = frame.bChecksum ? frame.Location : previous.Location;
+	previous = frame;
+	previous.Location = lastLocation;
+
+	if (buffer.Num() >= FlushSize) {
+		Flush();
+	}
+}
+
+void FInputReplayWriter::Flush() {
+	if (file.IsValid() && buffer.Num() > 0) {
+		file->Write(buffer.GetData(), buffer.Num());
+		bytesWritten += buffer.Num();
+		buffer.Reset();
+	}
+}
+
+void FInputReplayWriter::Close() {
+	if (!file.IsValid()) {
+		return;
+	}
+	buffer.Add(EndOfFile);
+	Flush();
+	file.Reset();
+}
+
+bool FInputReplayReader::Open(const FString& path, FInputReplayHeader& outHeader) {
+	data.Reset();
+	offset = 0;
+	previous = FInputReplayFrame();
+	if (!FFileHelper::LoadFileToArray(data, *path)) {
+		return false;
+	}
+
+	FMemoryReader reader(data);
+	uint32 magic = 0;
+	uint16 version = 0;
+	reader << magic;
+	reader << version;
+	if (magic != Magic || version != Version) {
+		return false;
+	}
+	outHeader.Serialize(reader);
+	offset = (int32)reader.Tell();
+	return !reader.IsError();
+}
+
+bool FInputReplayReader::Read(FInputReplayFrame& out) {
+	uint8 flags = 0;
+	if (!ReadByte(data, offset, flags) || flags == EndOfFile) {
+		return false;
+	}
+
+	out = previous;
+	out.bGravityEvent = (flags & GravityEvent) != 0;
+	out.bChecksum = (flags & Checksum) != 0;
+
+	int32 x = 0;
+	int32 y = 0;
+	int32 z = 0;
+	if (flags & DeltaChanged) {
+		if (!ReadVarInt(data, offset, x)) {
+			return false;
+		}
+		out.Delta += x;
+	}
+	if (flags & MoveChanged) {
+		if (!ReadVarInt(data, offset, x) || !ReadVarInt(data, offset, y)) {
+			return false;
+		}
+		out.Move += FIntPoint(x, y);
+	}
+	if (flags & LookChanged) {
+		if (!ReadVarInt(data, offset, x) || !ReadVarInt(data, offset, y)) {
+			return false;
+		}
+		out.Look += FIntPoint(x, y);
+	}
+	if ((flags & ButtonsChanged) && !ReadByte(data, offset, out.Buttons)) {
+		return false;
+	}
+	if (flags & GravityEvent) {
+		if (!ReadByte(data, offset, out.ShiftId) || !ReadGravity(data, offset, out.Gravity) || !ReadByte(data, offset, out.MovementMode) || !ReadByte(data, offset, out.CustomMovementMode)) {
+			return false;
+		}
+	}
+	if (flags & Checksum) {
+		if (!ReadVarInt(data, offset, x) || !ReadVarInt(data, offset, y) || !ReadVarInt(data, offset, z)) {
+			return false;
+		}
+		out.Location += FIntVector(x, y, z);
+	}
+
+	previous = out;
+	return true;
+}
@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UnrealTest/Movement/GravityMovementNetworking.h"
+
+class IFileHandle;
+
+/** Where the recorded character started, so playback can put it back there. */
+struct FInputReplayHeader {
+	FString Map;
+	FVector Location = FVector::ZeroVector;
+	FRotator Rotation = FRotator::ZeroRotator;
+	FRotator CameraRotation = FRotator::ZeroRotator;
+	FVector Velocity = FVector::ZeroVector;
+	uint8 MovementMode = 0;
+	uint8 CustomMovementMode = 0;
+	FVector Gravity = FVector::ZeroVector;
+	FVector ShiftedGravity = FVector::ZeroVector;
+	FRotator GravityPreviousRotation = FRotator::ZeroRotator;
+	float GravityRotationCompletion = 1.0f;
+	bool bInGravityField = false;
+
+	void Serialize(FArchive& Ar);
+};
+
+/** One frame of input, already rounded to what the file stores, so recording and playback use exactly the same values. */
+struct FInputReplayFrame {
+	enum EButton : uint8 {
+		Jump = 1 << 0,
+		Slide = 1 << 1,
+		Fire = 1 << 2,
+	};
+
+	/** Microseconds. */
+	int32 Delta = 0;
+	/** Thousandths. */
+	FIntPoint Move = FIntPoint::ZeroValue;
+	FIntPoint Look = FIntPoint::ZeroValue;
+	uint8 Buttons = 0;
+
+	/** Set on frames where a gravity shift happened or the movement mode changed. */
+	bool bGravityEvent = false;
+	uint8 ShiftId = 0;
+	FQuantizedGravity Gravity;
+	uint8 MovementMode = 0;
+	uint8 CustomMovementMode = 0;
+
+	/** Set every so often, to catch playback drifting from the recording. Tenths of a unit. */
+	bool bChecksum = false;
+	FIntVector Location = FIntVector::ZeroValue;
+
+	void SetDelta(float seconds) { Delta = FMath::RoundToInt(seconds * 1000000.0f); }
+	void SetMove(FVector2D value) { Move = FIntPoint(FMath::RoundToInt(value.X * 1000.0f), FMath::RoundToInt(value.Y * 1000.0f)); }
+	void SetLook(FVector2D value) { Look = FIntPoint(FMath::RoundToInt(value.X * 1000.0f), FMath::RoundToInt(value.Y * 1000.0f)); }
+	void SetLocation(FVector value) { Location = FIntVector(FMath::RoundToInt(value.X * 10.0), FMath::RoundToInt(value.Y * 10.0), FMath::RoundToInt(value.Z * 10.0)); }
+
+	float GetDelta() const { return Delta / 1000000.0f; }
+	FVector2D GetMove() const { return FVector2D(Move.X / 1000.0f, Move.Y / 1000.0f); }
+	FVector2D GetLook() const { return FVector2D(Look.X / 1000.0f, Look.Y / 1000.0f); }
+};
+
+/**
+ * Streams frames to a file. Each frame is a byte of flags followed by only what changed since the previous frame,
+ * with numbers stored as zigzag varints of the difference, so a steady frame is a few bytes.
+ * Writes are buffered and go to disk in large chunks.
+ */
+class UNREALTEST_API FInputReplayWriter {
+public:
+	~FInputReplayWriter();
+
+	bool Open(const FString& path, FInputReplayHeader header);
+
+	void Write(const FInputReplayFrame& frame);
+
+	/** Writes the end marker and closes the file. */
+	void Close();
+
+	bool IsOpen() const { return file.IsValid(); }
+
+	int64 GetBytesWritten() const { return bytesWritten + buffer.Num(); }
+
+private:
+	void Flush();
+
+	TUniquePtr<IFileHandle> file;
+	TArray<uint8> buffer;
+	int64 bytesWritten = 0;
+	FInputReplayFrame previous;
+};
+
+/** Reads back a file written by FInputReplayWriter. */
+class UNREALTEST_API FInputReplayReader {
+public:
+	bool Open(const FString& path, FInputReplayHeader& outHeader);
+
+	/** False at the end of the file, or if it's broken. */
+	bool Read(FInputReplayFrame& out);
+
+private:
+	TArray<uint8> data;
+	int32 offset = 0;
+	FInputReplayFrame previous;
+};
+
+namespace InputReplay {
+	/** Saved/Replays/<name>.utreplay */
+	FString GetPath(const FString& name);
+}
@@ -0,0 +1,401 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "InputReplaySubsystem.h"
+#include "BenchmarkReport.h"
+#include "UnrealTest/FP_Character/UnrealTestCharacter.h"
+#include "UnrealTest/FP_Character/TP_WeaponComponent.h"
+#include "UnrealTest/Movement/CharacterGravityComponent.h"
+#include "Camera/CameraComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "EnhancedInputSubsystems.h"
+#include "EnhancedPlayerInput.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/Parse.h"
+
+static FAutoConsoleCommandWithWorldAndArgs GStartReplayRecording(
+	TEXT("ut.Replay.Record"),
+	TEXT("Starts recording the local player's input. Arguments: Name="),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World) {
+		FString name = TEXT("replay");
+		FParse::Value(*FString::Join(Args, TEXT(" ")), TEXT("Name="), name);
+		if (UInputReplaySubsystem* replays = World ? World->GetSubsystem<UInputReplaySubsystem>() : nullptr) {
+			replays->StartRecording(name);
+		}
+	})
+);
+
+static FAutoConsoleCommandWithWorldAndArgs GStartReplayPlayback(
+	TEXT("ut.Replay.Play"),
+	TEXT("Plays back a recording on the local player. Arguments: Name= Quit=0/1"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World) {
+		const FString args = FString::Join(Args, TEXT(" "));
+		FString name = TEXT("replay");
+		bool bQuit = false;
+		FParse::Value(*args, TEXT("Name="), name);
+		FParse::Bool(*args, TEXT("Quit="), bQuit);
+		if (UInputReplaySubsystem* replays = World ? World->GetSubsystem<UInputReplaySubsystem>() : nullptr) {
+			replays->StartPlayback(name, bQuit);
+		}
+	})
+);
+
+static FAutoConsoleCommandWithWorld GStopReplay(
+	TEXT("ut.Replay.Stop"),
+	TEXT("Stops recording or playing back input."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UInputReplaySubsystem* replays = World ? World->GetSubsystem<UInputReplaySubsystem>() : nullptr) {
+			replays->Stop();
+		}
+	})
+);
+
+namespace {
+	// Every half second at 60fps. Each one costs a few bytes.
+	const int32 ChecksumInterval = 30;
+}
+
+bool UInputReplaySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UInputReplaySubsystem::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UInputReplaySubsystem, STATGROUP_Tickables);
+}
+
+void UInputReplaySubsystem::Deinitialize() {
+	Stop();
+	Super::Deinitialize();
+}
+
+AUnrealTestCharacter* UInputReplaySubsystem::GetCharacter() const {
+	APlayerController* controller = GetWorld()->GetFirstPlayerController();
+	return controller != nullptr ? Cast<AUnrealTestCharacter>(controller->GetPawn()) : nullptr;
+}
+
+UTP_WeaponComponent* UInputReplaySubsystem::GetWeapon(AUnrealTestCharacter* character) {
+	// Picked up weapons attach themselves to the arms.
+	for (USceneComponent* child : character->GetMesh1P()->GetAttachChildren()) {
+		if (UTP_WeaponComponent* weapon = Cast<UTP_WeaponComponent>(child)) {
+			return weapon;
+		}
+	}
+	return nullptr;
+}
+
+void UInputReplaySubsystem::FillGravityEvent(AUnrealTestCharacter* character, FInputReplayFrame& frame) {
+	UCharacterGravityComponent* movement = Cast<UCharacterGravityComponent>(character->GetCharacterMovement());
+	if (movement == nullptr) {
+		return;
+	}
+	const FGravityState gravity = movement->GetGravityState();
+	frame.ShiftId = gravity.shiftId;
+	frame.Gravity = FQuantizedGravity::Quantize(gravity.gravity);
+	frame.MovementMode = movement->MovementMode;
+	frame.CustomMovementMode = movement->CustomMovementMode;
+}
+
+bool UInputReplaySubsystem::StartRecording(const FString& name) {
+	if (state != EState::Idle) {
+		UE_LOG(LogTemp, Warning, TEXT("Input replay: already recording or playing"));
+		return false;
+	}
+	replayName = name;
+	state = EState::StartingRecording;
+	return true;
+}
+
+bool UInputReplaySubsystem::StartPlayback(const FString& name, bool bQuit) {
+	if (state != EState::Idle) {
+		UE_LOG(LogTemp, Warning, TEXT("Input replay: already recording or playing"));
+		return false;
+	}
+	replayName = name;
+	bQuitWhenDone = bQuit;
+	state = EState::StartingPlayback;
+	return true;
+}
+
+void UInputReplaySubsystem::Stop() {
+	if (IsRecording()) {
+		StopRecording();
+	}
+	else if (IsPlaying()) {
+		FinishPlayback();
+	}
+}
+
+void UInputReplaySubsystem::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+	if (state == EState::Idle) {
+		return;
+	}
+
+	AUnrealTestCharacter* character = GetCharacter();
+	if (character == nullptr) {
+		// Nothing to record or drive yet, or any more.
+		if (state == EState::Recording || state == EState::Playing) {
+			UE_LOG(LogTemp, Warning, TEXT("Input replay: lost the player character, stopping"));
+			Stop();
+		}
+		return;
+	}
+
+	switch (state) {
+		case EState::StartingRecording:
+			BeginRecording(character);
+			break;
+		case EState::Recording:
+			RecordFrame(character, DeltaTime);
+			break;
+		case EState::StartingPlayback:
+			BeginPlayback(character);
+			break;
+		case EState::Playing:
+			PlayFrame(character);
+			break;
+		default:
+			break;
+	}
+}
+
+void UInputReplaySubsystem::BeginRecording(AUnrealTestCharacter* character) {
+	FInputReplayHeader header;
+	header.Map = GetWorld()->GetMapName();
+	header.Location = character->GetActorLocation();
+	header.Rotation = character->GetActorRotation();
+	header.CameraRotation = character->GetFirstPersonCameraComponent()->GetRelativeRotation();
+	header.Velocity = character->GetCharacterMovement()->Velocity;
+	header.MovementMode = character->GetCharacterMovement()->MovementMode;
+	header.CustomMovementMode = character->GetCharacterMovement()->CustomMovementMode;
+	if (UCharacterGravityComponent* movement = Cast<UCharacterGravityComponent>(character->GetCharacterMovement())) {
+		const FGravityState gravity = movement->GetGravityState();
+		header.Gravity = gravity.gravity;
+		header.ShiftedGravity = gravity.shiftedGravity;
+		header.GravityPreviousRotation = gravity.previousRotation;
+		header.GravityRotationCompletion = gravity.rotationCompletion;
+		header.bInGravityField = gravity.bInGravityField;
+	}
+
+	const FString path = InputReplay::GetPath(replayName);
+	if (!writer.Open(path, header)) {
+		UE_LOG(LogTemp, Error, TEXT("Input replay: couldn't open %s for writing"), *path);
+		state = EState::Idle;
+		return;
+	}
+
+	FInputReplayFrame current;
+	FillGravityEvent(character, current);
+	lastShiftId = current.ShiftId;
+	lastMovementMode = current.MovementMode;
+	lastCustomMovementMode = current.CustomMovementMode;
+	frames = 0;
+	recordSeconds = 0.0;
+	recordSecondsMax = 0.0;
+	state = EState::Recording;
+	UE_LOG(LogTemp, Display, TEXT("Input replay: recording to %s"), *path);
+}
+
+void UInputReplaySubsystem::RecordFrame(AUnrealTestCharacter* character, float DeltaTime) {
+	const uint64 startCycles = FPlatformTime::Cycles64();
+
+	APlayerController* controller = Cast<APlayerController>(character->GetController());
+	const UEnhancedPlayerInput* input = controller != nullptr ? Cast<UEnhancedPlayerInput>(controller->PlayerInput) : nullptr;
+
+	FInputReplayFrame frame;
+	frame.SetDelta(DeltaTime);
+	if (input != nullptr) {
+		frame.SetMove(input->GetActionValue(character->GetMoveAction()).Get<FVector2D>());
+		frame.SetLook(input->GetActionValue(character->LookAction).Get<FVector2D>());
+		frame.Buttons |= input->GetActionValue(character->GetJumpAction()).Get<bool>() ? FInputReplayFrame::Jump : 0;
+		frame.Buttons |= input->GetActionValue(character->GetSlideAction()).Get<bool>() ? FInputReplayFrame::Slide : 0;
+		if (UTP_WeaponComponent* weapon = GetWeapon(character)) {
+			frame.Buttons |= input->GetActionValue(weapon->FireAction).Get<bool>() ? FInputReplayFrame::Fire : 0;
+		}
+	}
+
+	// Only frames where gravity or the movement mode changed carry them.
+	FillGravityEvent(character, frame);
+	frame.bGravityEvent = frame.ShiftId != lastShiftId || frame.MovementMode != lastMovementMode || frame.CustomMovementMode != lastCustomMovementMode;
+	lastShiftId = frame.ShiftId;
+	lastMovementMode = frame.MovementMode;
+	lastCustomMovementMode = frame.CustomMovementMode;
+
+	frames++;
+	if (frames % ChecksumInterval == 0) {
+		frame.bChecksum = true;
+		frame.SetLocation(character->GetActorLocation());
+	}
+
+	writer.Write(frame);
+
+	const double seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - startCycles);
+	recordSeconds += seconds;
+	recordSecondsMax = FMath::Max(recordSecondsMax, seconds);
+}
+
+void UInputReplaySubsystem::StopRecording() {
+	const int64 bytes = writer.GetBytesWritten();
+	writer.Close();
+	state = EState::Idle;
+
+	UE_LOG(LogTemp, Display, TEXT("Input replay: recorded %d frames to %s, %lld bytes (%.1f per frame), %.2fus per frame on average, %.2fus at most"),
+		frames, *InputReplay::GetPath(replayName), bytes, frames > 0 ? (double)bytes / frames : 0.0,
+		frames > 0 ? recordSeconds * 1000000.0 / frames : 0.0, recordSecondsMax * 1000000.0);
+}
+
+void UInputReplaySubsystem::BeginPlayback(AUnrealTestCharacter* character) {
+	FInputReplayHeader header;
+	const FString path = InputReplay::GetPath(replayName);
+	if (!reader.Open(path, header)) {
+		UE_LOG(LogTemp, Error, TEXT("Input replay: couldn't read %s"), *path);
+		state = EState::Idle;
+		return;
+	}
+	if (header.Map != GetWorld()->GetMapName()) {
+		UE_LOG(LogTemp, Warning, TEXT("Input replay: %s was recorded on %s, not %s"), *replayName, *header.Map, *GetWorld()->GetMapName());
+	}
+
+	// Put the character back exactly where the recording started.
+	character->TeleportTo(header.Location, header.Rotation, false, true);
+	character->GetFirstPersonCameraComponent()->SetRelativeRotation(header.CameraRotation);
+	UCharacterMovementComponent* movement = character->GetCharacterMovement();
+	movement->SetMovementMode((EMovementMode)header.MovementMode, header.CustomMovementMode);
+	movement->Velocity = header.Velocity;
+	if (UCharacterGravityComponent* gravityMovement = Cast<UCharacterGravityComponent>(movement)) {
+		FGravityState gravity = gravityMovement->GetGravityState();
+		gravity.gravity = header.Gravity;
+		gravity.shiftedGravity = header.ShiftedGravity;
+		gravity.previousRotation = header.GravityPreviousRotation;
+		gravity.rotationCompletion = header.GravityRotationCompletion;
+		gravity.bInGravityField = header.bInGravityField;
+		gravityMovement->SetGravityState(gravity);
+		startSweeps = gravityMovement->GetCounters().Sweeps;
+		startMovementTicks = gravityMovement->GetCounters().Ticks;
+	}
+
+	bSavedUseFixedTimeStep = FApp::UseFixedTimeStep();
+	savedFixedDeltaTime = FApp::GetFixedDeltaTime();
+	FApp::SetUseFixedTimeStep(true);
+
+	frames = 0;
+	locationMismatches = 0;
+	gravityMismatches = 0;
+	firstMismatchFrame = INDEX_NONE;
+	frameMs.Reset();
+	lastFrameTime = FPlatformTime::Seconds();
+	state = EState::Playing;
+
+	bHasPlayingFrame = reader.Read(playingFrame);
+	if (!bHasPlayingFrame) {
+		FinishPlayback();
+		return;
+	}
+	InjectFrame(character, playingFrame);
+	UE_LOG(LogTemp, Display, TEXT("Input replay: playing %s"), *path);
+}
+
+void UInputReplaySubsystem::InjectFrame(AUnrealTestCharacter* character, const FInputReplayFrame& frame) {
+	FApp::SetFixedDeltaTime(frame.GetDelta());
+
+	APlayerController* controller = Cast<APlayerController>(character->GetController());
+	UEnhancedInputLocalPlayerSubsystem* input = controller != nullptr ? ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(controller->GetLocalPlayer()) : nullptr;
+	if (input == nullptr) {
+		return;
+	}
+
+	// Injected input only lasts a frame, so held buttons get injected every frame they're down, and released ones just stop.
+	if (frame.Move != FIntPoint::ZeroValue) {
+		input->InjectInputForAction(character->GetMoveAction(), FInputActionValue(frame.GetMove()), {}, {});
+	}
+	if (frame.Look != FIntPoint::ZeroValue) {
+		input->InjectInputForAction(character->LookAction, FInputActionValue(frame.GetLook()), {}, {});
+	}
+	if (frame.Buttons & FInputReplayFrame::Jump) {
+		input->InjectInputForAction(character->GetJumpAction(), FInputActionValue(true), {}, {});
+	}
+	if (frame.Buttons & FInputReplayFrame::Slide) {
+		input->InjectInputForAction(character->GetSlideAction(), FInputActionValue(true), {}, {});
+	}
+	if (frame.Buttons & FInputReplayFrame::Fire) {
+		if (UTP_WeaponComponent* weapon = GetWeapon(character)) {
+			input->InjectInputForAction(weapon->FireAction, FInputActionValue(true), {}, {});
+		}
+	}
+}
+
+void UInputReplaySubsystem::PlayFrame(AUnrealTestCharacter* character) {
+	const double now = FPlatformTime::Seconds();
+	frameMs.Add((now - lastFrameTime) * 1000.0);
+	lastFrameTime = now;
+
+	// The frame that just ran was playingFrame, so the character should match what was recorded at the end of it.
+	frames++;
+	if (bHasPlayingFrame) {
+		bool bMismatch = false;
+		if (playingFrame.bChecksum) {
+			FInputReplayFrame actual;
+			actual.SetLocation(character->GetActorLocation());
+			// Within a unit.
+			if ((actual.Location - playingFrame.Location).GetAbsMax() > 10) {
+				locationMismatches++;
+				bMismatch = true;
+			}
+		}
+		if (playingFrame.bGravityEvent) {
+			FInputReplayFrame actual;
+			FillGravityEvent(character, actual);
+			if (actual.Gravity != playingFrame.Gravity || actual.MovementMode != playingFrame.MovementMode || actual.CustomMovementMode != playingFrame.CustomMovementMode) {
+				gravityMismatches++;
+				bMismatch = true;
+			}
+		}
+		if (bMismatch && firstMismatchFrame == INDEX_NONE) {
+			firstMismatchFrame = frames;
+			UE_LOG(LogTemp, Warning, TEXT("Input replay: playback drifted from the recording at frame %d"), frames);
+		}
+	}
+
+	bHasPlayingFrame = reader.Read(playingFrame);
+	if (!bHasPlayingFrame) {
+		FinishPlayback();
+		return;
+	}
+	InjectFrame(character, playingFrame);
+}
+
+void UInputReplaySubsystem::FinishPlayback() {
+	FApp::SetUseFixedTimeStep(bSavedUseFixedTimeStep);
+	FApp::SetFixedDeltaTime(savedFixedDeltaTime);
+	state = EState::Idle;
+
+	uint64 sweeps = 0;
+	uint64 movementTicks = 0;
+	if (AUnrealTestCharacter* character = GetCharacter()) {
+		if (UCharacterGravityComponent* movement = Cast<UCharacterGravityComponent>(character->GetCharacterMovement())) {
+			sweeps = movement->GetCounters().Sweeps - startSweeps;
+			movementTicks = movement->GetCounters().Ticks - startMovementTicks;
+		}
+	}
+
+	FBenchmarkReport report(TEXT("ReplayBenchmark"));
+	report.AddRow();
+	report.Set(TEXT("timestamp"), FDateTime::Now().ToIso8601());
+	report.Set(TEXT("replay"), replayName);
+	report.Set(TEXT("frames"), frames);
+	report.Set(TEXT("frame_mean_ms"), FBenchmarkReport::Mean(frameMs));
+	report.Set(TEXT("frame_p99_ms"), FBenchmarkReport::Percentile(frameMs, 0.99));
+	report.Set(TEXT("sweeps_per_tick"), movementTicks > 0 ? (double)sweeps / movementTicks : 0.0);
+	report.Set(TEXT("location_mismatches"), locationMismatches);
+	report.Set(TEXT("gravity_mismatches"), gravityMismatches);
+	report.Set(TEXT("first_mismatch_frame"), firstMismatchFrame);
+	report.Write();
+
+	UE_LOG(LogTemp, Display, TEXT("Input replay: played %d frames of %s, %d location and %d gravity mismatches"), frames, *replayName, locationMismatches, gravityMismatches);
+
+	if (bQuitWhenDone) {
+		FPlatformMisc::RequestExit(false);
+	}
+}
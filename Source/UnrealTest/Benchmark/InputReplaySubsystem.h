@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "InputReplayFile.h"
+#include "InputReplaySubsystem.generated.h"
+
+class AUnrealTestCharacter;
+class UTP_WeaponComponent;
+
+/**
+ * Records the local player's Move, Look, Jump, Slide and Fire input to Saved/Replays, along with frame times and gravity events,
+ * and plays it back through Enhanced Input with the same frame times.
+ *
+ *   ut.Replay.Record Name=slide_bug     (then ut.Replay.Stop)
+ *   ut.Replay.Play Name=slide_bug Quit=1
+ *
+ * Playback checks the character against the location and gravity saved in the recording, and writes a row to Saved/Benchmarks/ReplayBenchmark.csv,
+ * so a replay run headless is a repeatable benchmark.
+ */
+UCLASS()
+class UNREALTEST_API UInputReplaySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+	bool StartRecording(const FString& name);
+	bool StartPlayback(const FString& name, bool bQuitWhenDone);
+
+	/** Stops whichever is running. */
+	void Stop();
+
+	bool IsRecording() const { return state == EState::StartingRecording || state == EState::Recording; }
+	bool IsPlaying() const { return state == EState::StartingPlayback || state == EState::Playing; }
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	enum class EState : uint8 {
+		Idle,
+		/** Starting happens on the next tick, so recording and playback both begin at the end of a frame. */
+		StartingRecording,
+		Recording,
+		StartingPlayback,
+		Playing,
+	};
+
+	AUnrealTestCharacter* GetCharacter() const;
+
+	/** The weapon the character is holding, if any. */
+	static UTP_WeaponComponent* GetWeapon(AUnrealTestCharacter* character);
+
+	void BeginRecording(AUnrealTestCharacter* character);
+	void RecordFrame(AUnrealTestCharacter* character, float DeltaTime);
+	void StopRecording();
+
+	void BeginPlayback(AUnrealTestCharacter* character);
+	/** Checks the frame that just ran against the recording, then queues up the next one. */
+	void PlayFrame(AUnrealTestCharacter* character);
+	/** Feeds frame's input into Enhanced Input for the next frame, and fixes the next frame's time to match. */
+	void InjectFrame(AUnrealTestCharacter* character, const FInputReplayFrame& frame);
+	void FinishPlayback();
+
+	/** Gravity and movement mode, as a recording stores them. */
+	static void FillGravityEvent(AUnrealTestCharacter* character, FInputReplayFrame& frame);
+
+	EState state = EState::Idle;
+	FString replayName;
+	bool bQuitWhenDone = false;
+
+	FInputReplayWriter writer;
+	FInputReplayReader reader;
+
+	int32 frames = 0;
+	uint8 lastShiftId = 0;
+	uint8 lastMovementMode = 0;
+	uint8 lastCustomMovementMode = 0;
+
+	/** Recording cost, to keep an eye on it staying negligible. */
+	double recordSeconds = 0.0;
+	double recordSecondsMax = 0.0;
+
+	FInputReplayFrame playingFrame;
+	bool bHasPlayingFrame = false;
+	int32 locationMismatches = 0;
+	int32 gravityMismatches = 0;
+	int32 firstMismatchFrame = INDEX_NONE;
+	double lastFrameTime = 0.0;
+	TArray<double> frameMs;
+	uint64 startSweeps = 0;
+	uint64 startMovementTicks = 0;
+
+	bool bSavedUseFixedTimeStep = false;
+	double savedFixedDeltaTime = 0.0;
+};
@@ -0,0 +1,166 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ImpactDecalSubsystem.h"
+#include "Components/DecalComponent.h"
+#include "GameFramework/WorldSettings.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static FAutoConsoleCommandWithWorld GDumpImpactDecalStats(
+	TEXT("ut.Decals.Stats"),
+	TEXT("Prints the impact decal pool stats for the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UImpactDecalSubsystem* subsystem = World ? World->GetSubsystem<UImpactDecalSubsystem>() : nullptr) {
+			FImpactDecalStats stats = subsystem->GetStats();
+			UE_LOG(LogTemp, Display, TEXT("Impact decals: %d live, %d/%d pooled, %d requests, %d reuses (%.1f%%), %d evictions"),
+				stats.LiveCount, stats.PoolSize, subsystem->MaxDecals, stats.Requests, stats.Reuses, stats.ReuseRate * 100.0f, stats.Evictions);
+		}
+	})
+);
+
+bool UImpactDecalSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UImpactDecalSubsystem::Deinitialize() {
+	for (UDecalComponent* decal : decals) {
+		if (decal != nullptr) {
+			decal->DestroyComponent();
+		}
+	}
+	decals.Empty();
+	placedTimes.Empty();
+	placedDecals = 0;
+
+	Super::Deinitialize();
+}
+
+bool UImpactDecalSubsystem::IsExpired(int32 index, double now) const {
+	return now - placedTimes[index] >= FadeStartDelay + FadeDuration;
+}
+
+UDecalComponent* UImpactDecalSubsystem::CreateDecal(UWorld* world) {
+	// We don't use UGameplayStatics::SpawnDecalAttached because SetFadeOut would destroy the component once it finishes fading.
+	// The world settings just give the pooled components an actor to live under.
+	UDecalComponent* decal = NewObject<UDecalComponent>(world->GetWorldSettings(), NAME_None, RF_Transient);
+	decal->SetFadeScreenSize(0.0f);
+	decal->RegisterComponentWithWorld(world);
+	return decal;
+}
+
+UDecalComponent* UImpactDecalSubsystem::SpawnDecal(UMaterialInterface* material, FVector size, UPrimitiveComponent* attachTo, FVector location, FRotator rotation) {
+	UWorld* world = GetWorld();
+	if (material == nullptr || world == nullptr) {
+		return nullptr;
+	}
+
+	requests++;
+	const double now = world->GetTimeSeconds();
+
+	int32 index = INDEX_NONE;
+	if (placedDecals < decals.Num()) {
+		// A prewarmed one that hasn't been used yet.
+		index = placedDecals;
+		if (!IsValid(decals[index])) {
+			decals[index] = CreateDecal(world);
+		}
+	}
+	else if (decals.Num() < FMath::Max(MaxDecals, 1)) {
+		index = decals.Add(CreateDecal(world));
+		placedTimes.Add(now);
+	}
+	else {
+		// Oldest first. If MaxDecals was lowered at runtime, the ring just wraps around the ones we already have.
+		index = nextDecal % decals.Num();
+		nextDecal = (index + 1) % decals.Num();
+
+		reuses++;
+		if (!IsExpired(index, now)) {
+			evictions++;
+		}
+
+		// Something else may have destroyed it (it was attached to a component that got torn down, for instance).
+		if (!IsValid(decals[index])) {
+			decals[index] = CreateDecal(world);
+		}
+	}
+
+	UDecalComponent* decal = decals[index];
+	// Prewarmed and released decals are hidden until they're placed.
+	decal->SetHiddenInGame(false);
+	placedTimes[index] = now;
+	placedDecals = FMath::Max(placedDecals, index + 1);
+
+	if (attachTo != nullptr) {
+		decal->AttachToComponent(attachTo, FAttachmentTransformRules::KeepWorldTransform);
+	}
+	else {
+		decal->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+	}
+	decal->SetWorldLocationAndRotation(location, rotation);
+
+	decal->SetDecalMaterial(material);
+	decal->DecalSize = size;
+	decal->FadeStartDelay = FadeStartDelay;
+	decal->FadeDuration = FadeDuration;
+	// Recreating the render proxy also restarts the fade.
+	decal->MarkRenderStateDirty();
+
+	return decal;
+}
+
+void UImpactDecalSubsystem::Prewarm(UMaterialInterface* material, int32 count) {
+	UWorld* world = GetWorld();
+	if (world == nullptr) {
+		return;
+	}
+
+	const int32 target = FMath::Min(count, FMath::Max(MaxDecals, 1));
+	while (decals.Num() < target) {
+		UDecalComponent* decal = CreateDecal(world);
+		// Setting the material now gets its render resources ready, without anything showing until it's placed.
+		decal->SetHiddenInGame(true);
+		decal->SetDecalMaterial(material);
+		decals.Add(decal);
+		// Long expired, so it doesn't count as live.
+		placedTimes.Add(TNumericLimits<double>::Lowest());
+	}
+}
+
+void UImpactDecalSubsystem::ReleaseDecalsOn(AActor* actor) {
+	if (actor == nullptr) {
+		return;
+	}
+
+	for (int32 i = 0; i < decals.Num(); i++) {
+		UDecalComponent* decal = decals[i];
+		const USceneComponent* parent = IsValid(decal) ? decal->GetAttachParent() : nullptr;
+		if (parent == nullptr || parent->GetOwner() != actor) {
+			continue;
+		}
+		decal->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
+		decal->SetHiddenInGame(true);
+		// Expired, so it stops counting as live and the ring doesn't count taking it as an eviction.
+		placedTimes[i] = TNumericLimits<double>::Lowest();
+	}
+}
+
+FImpactDecalStats UImpactDecalSubsystem::GetStats() const {
+	FImpactDecalStats stats;
+	stats.PoolSize = decals.Num();
+	stats.Requests = requests;
+	stats.Reuses = reuses;
+	stats.Evictions = evictions;
+	stats.ReuseRate = requests > 0 ? (float)reuses / requests : 0.0f;
+
+	if (UWorld* world = GetWorld()) {
+		const double now = world->GetTimeSeconds();
+		for (int32 i = 0; i < decals.Num(); i++) {
+			if (!IsExpired(i, now)) {
+				stats.LiveCount++;
+			}
+		}
+	}
+	return stats;
+}
@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ImpactDecalSubsystem.generated.h"
+
+class UDecalComponent;
+class UMaterialInterface;
+
+USTRUCT(BlueprintType)
+struct FImpactDecalStats {
+	GENERATED_BODY()
+public:
+	/** Decals that have not finished fading out yet. */
+	UPROPERTY(BlueprintReadOnly, Category = Decals)
+	int32 LiveCount = 0;
+
+	/** Decal components that have been created so far. Never goes above MaxDecals. */
+	UPROPERTY(BlueprintReadOnly, Category = Decals)
+	int32 PoolSize = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Decals)
+	int32 Requests = 0;
+
+	/** Requests that were served by an already created component. */
+	UPROPERTY(BlueprintReadOnly, Category = Decals)
+	int32 Reuses = 0;
+
+	/** Reuses that had to take a decal that was still visible. */
+	UPROPERTY(BlueprintReadOnly, Category = Decals)
+	int32 Evictions = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Decals)
+	float ReuseRate = 0.0f;
+};
+
+/**
+ * Keeps a fixed-size ring of decal components for bullet impacts, so sustained fire doesn't keep creating new components.
+ * Once the ring is full the oldest decal gets moved to the new hit.
+ */
+UCLASS(config=Game)
+class UNREALTEST_API UImpactDecalSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual void Deinitialize() override;
+
+	/** Places a decal at location, attached to attachTo (if there is one). Reuses the oldest decal once MaxDecals exist. */
+	UDecalComponent* SpawnDecal(UMaterialInterface* material, FVector size, UPrimitiveComponent* attachTo, FVector location, FRotator rotation);
+
+	/** Creates up to count decal components (never more than MaxDecals) ahead of time, hidden and set to material, for SpawnDecal to use first. */
+	void Prewarm(UMaterialInterface* material, int32 count);
+
+	/** Hides and detaches every decal stuck to actor, so an actor that gets reused (like a pooled enemy) doesn't come back with old bullet holes. */
+	void ReleaseDecalsOn(AActor* actor);
+
+	UFUNCTION(BlueprintCallable, Category = Decals)
+	FImpactDecalStats GetStats() const;
+
+public:
+	/** Most decal components that can exist in the world at once. */
+	UPROPERTY(config, EditAnywhere, Category = Decals)
+	int32 MaxDecals = 256;
+
+	/** How long a decal stays fully visible before it starts to fade. This only works if the Material has the Decal Lifetime Opacity value. */
+	UPROPERTY(config, EditAnywhere, Category = Decals)
+	float FadeStartDelay = 13.0f;
+
+	UPROPERTY(config, EditAnywhere, Category = Decals)
+	float FadeDuration = 2.0f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	UDecalComponent* CreateDecal(UWorld* world);
+
+	bool IsExpired(int32 index, double now) const;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UDecalComponent>> decals;
+
+	/** World time each decal in decals was last placed at. */
+	TArray<double> placedTimes;
+
+	/** The next slot in the ring to hand out once the pool is full. */
+	int32 nextDecal = 0;
+
+	/** Decals that have been placed at least once. The ones past this were prewarmed and are still waiting to be used. */
+	int32 placedDecals = 0;
+
+	int32 requests = 0;
+	int32 reuses = 0;
+	int32 evictions = 0;
+};
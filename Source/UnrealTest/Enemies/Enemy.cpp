@@ -3,11 +3,20 @@
 
 #include "Enemy.h"
 #include "Engine/SkeletalMeshSocket.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/Controller.h"
+#include "AIController.h"
+#include "BrainComponent.h"
+#include "EnemyDamageSubsystem.h"
+#include "EnemySignificanceSubsystem.h"
+#include "EnemyPoolSubsystem.h"
+#include "UnrealTest/Effects/ImpactDecalSubsystem.h"
 
 // Sets default values
 AEnemy::AEnemy()
 {
  	// Set this character to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	// UEnemySignificanceSubsystem slows this (and the movement tick) down the further away we are from the player.
 	PrimaryActorTick.bCanEverTick = true;
 
 	WeaponMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("WeaponMesh"));
@@ -25,9 +34,30 @@ void AEnemy::BeginPlay()
 	Super::BeginPlay();
 	hp = BaseHP;
 
+	AttachWeaponMesh();
+
+	if (UEnemySignificanceSubsystem* significance = GetWorld()->GetSubsystem<UEnemySignificanceSubsystem>()) {
+		significance->RegisterEnemy(this);
+	}
+}
+
+void AEnemy::AttachWeaponMesh() {
+	static const FName WeaponGrip(TEXT("WeaponGrip"));
+	if (WeaponMesh->GetAttachParent() == GetMesh() && WeaponMesh->GetAttachSocketName() == WeaponGrip) {
+		return;
+	}
+
 	// The skeleton doesn't exist until play starts, so we just set up the attachment now. (Maybe PostLoad would also work?)
 	FAttachmentTransformRules rules(EAttachmentRule::SnapToTarget, true);
-	WeaponMesh->AttachToComponent(GetMesh(), rules, TEXT("WeaponGrip"));
+	WeaponMesh->AttachToComponent(GetMesh(), rules, WeaponGrip);
+}
+
+void AEnemy::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+	if (UEnemySignificanceSubsystem* significance = GetWorld()->GetSubsystem<UEnemySignificanceSubsystem>()) {
+		significance->UnregisterEnemy(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
@@ -44,13 +74,124 @@ void AEnemy::OnHit_Implementation(FVector pos, FWeapon weaponUsed) {
 	//this->OnRecieveHit();
 }
 
+void AEnemy::OnShotHit_Implementation(const FShotHit& shot, FWeapon weaponUsed) {
+	if (shot.PelletCount <= 0) {
+		return;
+	}
+
+	// Go through OnHit once with the whole shot's damage, so anything hooked up to OnHit in BP still runs (just once per shot).
+	FWeapon combined = weaponUsed;
+	combined.baseDamage = shot.TotalDamage;
+	IHitBehaviorInterface::Execute_OnHit(this, shot.HitPoints[0], combined);
+}
+
 void AEnemy::RecieveDamage(float damage) {
+	// Damage is held until the end of the frame, so we aren't torn down in the middle of a weapon trace.
+	if (UEnemyDamageSubsystem* damageSubsystem = GetWorld()->GetSubsystem<UEnemyDamageSubsystem>()) {
+		damageSubsystem->QueueDamage(this, damage);
+	}
+	else if (ApplyQueuedDamage(damage)) {
+		FinishDeath();
+	}
+}
+
+bool AEnemy::ApplyQueuedDamage(float damage) {
+	if (bDying) {
+		return false;
+	}
+
 	hp -= damage;
 	if (hp <= 0) {
+		StartDeath();
+		return true;
+	}
+	return false;
+}
+
+void AEnemy::StartDeath() {
+	bDying = true;
+	SetActorEnableCollision(false);
+	SetActorHiddenInGame(true);
+	SetActorTickEnabled(false);
+	GetCharacterMovement()->StopMovementImmediately();
+	GetCharacterMovement()->DisableMovement();
+}
+
+void AEnemy::FinishDeath() {
+	ReturnToPool();
+}
+
+void AEnemy::ReturnToPool() {
+	UEnemyPoolSubsystem* pool = GetWorld() ? GetWorld()->GetSubsystem<UEnemyPoolSubsystem>() : nullptr;
+	if (pool != nullptr) {
+		pool->Release(this);
+	}
+	else {
 		Destroy();
 	}
 }
 
+void AEnemy::ActivateFromPool(const FTransform& transform, float newHP) {
+	bInPool = false;
+	bDying = false;
+	hp = newHP;
+
+	SetActorTransform(transform, false, nullptr, ETeleportType::ResetPhysics);
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+
+	// Whatever UEnemySignificanceSubsystem slowed down last time is put back to full rate until it buckets us again.
+	SetActorTickInterval(0.0f);
+	SetActorTickEnabled(true);
+	UCharacterMovementComponent* movement = GetCharacterMovement();
+	movement->SetComponentTickInterval(0.0f);
+	movement->SetComponentTickEnabled(true);
+	movement->StopMovementImmediately();
+	movement->SetDefaultMovementMode();
+
+	// Something could have knocked the weapon off while we were out.
+	AttachWeaponMesh();
+
+	if (UBrainComponent* brain = GetBrain()) {
+		brain->ResumeLogic(TEXT("Enemy activated"));
+	}
+
+	if (UEnemySignificanceSubsystem* significance = GetWorld()->GetSubsystem<UEnemySignificanceSubsystem>()) {
+		significance->RegisterEnemy(this);
+	}
+}
+
+UBrainComponent* AEnemy::GetBrain() const {
+	const AAIController* controller = Cast<AAIController>(GetController());
+	return controller != nullptr ? controller->GetBrainComponent() : nullptr;
+}
+
+void AEnemy::DeactivateForPool() {
+	bPooled = true;
+	bInPool = true;
+
+	if (!bDying) {
+		StartDeath();
+	}
+	if (AController* controller = GetController()) {
+		controller->StopMovement();
+	}
+	// A behavior tree left running would keep thinking (and moving, once we're back) for an enemy that's in the pool.
+	if (UBrainComponent* brain = GetBrain()) {
+		brain->PauseLogic(TEXT("Enemy pooled"));
+	}
+
+	// Bullet holes from this life shouldn't come back with the next one.
+	if (UImpactDecalSubsystem* decals = GetWorld()->GetSubsystem<UImpactDecalSubsystem>()) {
+		decals->ReleaseDecalsOn(this);
+	}
+
+	// Nothing should be re-enabling our ticks while we're in the pool.
+	if (UEnemySignificanceSubsystem* significance = GetWorld()->GetSubsystem<UEnemySignificanceSubsystem>()) {
+		significance->UnregisterEnemy(this);
+	}
+}
+
 // Called to bind functionality to input
 void AEnemy::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
 {
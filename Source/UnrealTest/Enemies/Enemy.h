@@ -34,9 +34,57 @@ public:
 
 	virtual void OnHit_Implementation(FVector pos, FWeapon weaponUsed) override;
 
+	virtual void OnShotHit_Implementation(const FShotHit& shot, FWeapon weaponUsed) override;
+
+	/** Applies damage that UEnemyDamageSubsystem held on to. Returns true if this is what killed us. */
+	bool ApplyQueuedDamage(float damage);
+
+	/** Tears down an enemy that already died. UEnemyDamageSubsystem spreads these out over frames. */
+	void FinishDeath();
+
+	/** Puts the enemy in its UEnemyPoolSubsystem pool, adopting it if the pool didn't spawn it, or destroys it if there's no pool. */
+	void ReturnToPool();
+
+	/** Brings a pooled enemy back to life at transform, as if it had just been spawned there with hp. */
+	void ActivateFromPool(const FTransform& transform, float newHP);
+
+	/** Turns everything off, same as dying, pauses the AI, and marks the enemy as pooled. */
+	void DeactivateForPool();
+
+	bool IsInPool() const { return bInPool; }
+
+	/** Whether a pool owns this enemy, from spawning or adopting it. */
+	bool IsPooled() const { return bPooled; }
+
+	bool IsDying() const { return bDying; }
+
+	float GetHP() const { return hp; }
+
+	/** For handing an enemy over from somewhere that already tracked its health, like AEnemyCrowd. */
+	void SetHP(float newHP) { hp = newHP; }
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	
 	void RecieveDamage(float damage);
+
+	/** The cheap part of dying: stop colliding, moving and showing up right away, so nothing else hits us while we wait to be cleaned up. */
+	void StartDeath();
+
+	/** Snaps WeaponMesh to the WeaponGrip socket, unless it's already there. */
+	void AttachWeaponMesh();
+
+	/** The AI controller's brain, if we have one, so pooling can pause and resume its logic. */
+	class UBrainComponent* GetBrain() const;
+
+	bool bDying = false;
+
+	/** Set once a pool owns this enemy. Pooled enemies are released instead of destroyed. */
+	bool bPooled = false;
+
+	/** In the pool right now, waiting to be activated. */
+	bool bInPool = false;
 };
@@ -0,0 +1,284 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EnemyCrowd.h"
+#include "Enemy.h"
+#include "EnemyPoolSubsystem.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Math/RandomStream.h"
+
+int32 FEnemyCrowdAgents::Add(FVector position, float hp) {
+	Velocities.Add(FVector::ZeroVector);
+	HP.Add(hp);
+	States.Add(ECrowdAgentState::Idle);
+	Instances.Add(INDEX_NONE);
+	return Positions.Add(position);
+}
+
+void FEnemyCrowdAgents::RemoveAtSwap(int32 index) {
+	Positions.RemoveAtSwap(index, 1, false);
+	Velocities.RemoveAtSwap(index, 1, false);
+	HP.RemoveAtSwap(index, 1, false);
+	States.RemoveAtSwap(index, 1, false);
+	Instances.RemoveAtSwap(index, 1, false);
+}
+
+AEnemyCrowd::AEnemyCrowd() {
+	PrimaryActorTick.bCanEverTick = true;
+
+	AgentMesh = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("AgentMesh"));
+	RootComponent = AgentMesh;
+	// So hitscan traces land on the agents, and the weapon ends up calling our OnShotHit.
+	AgentMesh->SetCollisionProfileName(TEXT("Pawn"));
+	AgentMesh->SetCanEverAffectNavigation(false);
+}
+
+void AEnemyCrowd::BeginPlay() {
+	Super::BeginPlay();
+
+	// Agents keep the height of the crowd actor, so it should be placed where the enemies' capsules would be centered.
+	const FVector center = GetActorLocation();
+	FRandomStream stream(GetUniqueID());
+	for (int32 i = 0; i < InitialAgents; i++) {
+		const FVector2D offset = FVector2D(stream.FRandRange(-1.0f, 1.0f), stream.FRandRange(-1.0f, 1.0f)).GetSafeNormal() * stream.FRandRange(0.0f, SpawnRadius);
+		AddAgent(center + FVector(offset, 0.0f));
+	}
+	UpdateAgentMesh();
+
+	if (UEnemyPoolSubsystem* pool = GetWorld()->GetSubsystem<UEnemyPoolSubsystem>()) {
+		pool->Prewarm(EnemyClass, PrewarmEnemies);
+	}
+}
+
+int32 AEnemyCrowd::AddAgent(FVector location) {
+	bAgentCountChanged = true;
+	return agents.Add(location, AgentHP);
+}
+
+void AEnemyCrowd::RemoveAgent(int32 index) {
+	// The mesh still draws the removed agent until the next update, and the last agent has moved to index.
+	const int32 last = agents.Num() - 1;
+	if (instanceAgents.IsValidIndex(agents.Instances[index])) {
+		instanceAgents[agents.Instances[index]] = INDEX_NONE;
+	}
+	if (last != index && instanceAgents.IsValidIndex(agents.Instances[last])) {
+		instanceAgents[agents.Instances[last]] = index;
+	}
+	agents.RemoveAtSwap(index);
+	bAgentCountChanged = true;
+}
+
+float AEnemyCrowd::GetClosestDistanceSquared(FVector location, TArrayView<const FVector> viewPoints) {
+	float closest = TNumericLimits<float>::Max();
+	for (const FVector& viewPoint : viewPoints) {
+		closest = FMath::Min(closest, (float)FVector::DistSquared(location, viewPoint));
+	}
+	return closest;
+}
+
+void AEnemyCrowd::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+
+	TArray<FVector, TInlineAllocator<4>> viewPoints;
+	for (FConstPlayerControllerIterator it = GetWorld()->GetPlayerControllerIterator(); it; ++it) {
+		APlayerController* controller = it->Get();
+		if (controller != nullptr && controller->PlayerCameraManager != nullptr) {
+			viewPoints.Add(controller->PlayerCameraManager->GetCameraLocation());
+		}
+	}
+
+	if (viewPoints.Num() > 0) {
+		SimulateAgents(DeltaTime, viewPoints);
+		UpdatePromotions(viewPoints);
+	}
+
+	timeUntilVisualUpdate -= DeltaTime;
+	if (timeUntilVisualUpdate <= 0.0f || bAgentCountChanged) {
+		timeUntilVisualUpdate = VisualUpdateInterval;
+		UpdateAgentMesh();
+	}
+}
+
+void AEnemyCrowd::SimulateAgents(float DeltaTime, TArrayView<const FVector> viewPoints) {
+	const int32 count = agents.Num();
+	const float chaseSquared = ChaseDistance * ChaseDistance;
+	// Close enough to stop pushing forward. Agents this close are promoted anyway.
+	const float arriveSquared = FMath::Square(AgentHitRadius * 2.0f);
+
+	FVector* positions = agents.Positions.GetData();
+	FVector* velocities = agents.Velocities.GetData();
+	ECrowdAgentState* states = agents.States.GetData();
+
+	// Steering: pick a state and a velocity for everyone first...
+	for (int32 i = 0; i < count; i++) {
+		FVector closestOffset = FVector::ZeroVector;
+		float closestSquared = TNumericLimits<float>::Max();
+		for (const FVector& viewPoint : viewPoints) {
+			const FVector offset = FVector(viewPoint.X - positions[i].X, viewPoint.Y - positions[i].Y, 0.0f);
+			const float distanceSquared = offset.SizeSquared();
+			if (distanceSquared < closestSquared) {
+				closestSquared = distanceSquared;
+				closestOffset = offset;
+			}
+		}
+
+		const bool chasing = closestSquared < chaseSquared && closestSquared > arriveSquared;
+		states[i] = chasing ? ECrowdAgentState::Chasing : ECrowdAgentState::Idle;
+		velocities[i] = chasing ? closestOffset * (AgentSpeed * FMath::InvSqrt(closestSquared)) : FVector::ZeroVector;
+	}
+
+	// ...then move everyone in one pass.
+	for (int32 i = 0; i < count; i++) {
+		positions[i] += velocities[i] * DeltaTime;
+	}
+}
+
+void AEnemyCrowd::UpdatePromotions(TArrayView<const FVector> viewPoints) {
+	const float promoteSquared = PromoteDistance * PromoteDistance;
+	const float demoteSquared = DemoteDistance * DemoteDistance;
+
+	// Backwards, since promoting swaps the last agent into the one we just removed.
+	for (int32 i = agents.Num() - 1; i >= 0; i--) {
+		if (GetClosestDistanceSquared(agents.Positions[i], viewPoints) < promoteSquared) {
+			PromoteAgent(i);
+		}
+	}
+
+	for (int32 i = promotedEnemies.Num() - 1; i >= 0; i--) {
+		AEnemy* enemy = promotedEnemies[i].Get();
+		if (enemy == nullptr || enemy->IsDying()) {
+			promotedEnemies.RemoveAtSwap(i);
+			continue;
+		}
+
+		if (GetClosestDistanceSquared(enemy->GetActorLocation(), viewPoints) > demoteSquared) {
+			const int32 index = AddAgent(enemy->GetActorLocation());
+			agents.HP[index] = enemy->GetHP();
+			enemy->ReturnToPool();
+			promotedEnemies.RemoveAtSwap(i);
+		}
+	}
+}
+
+void AEnemyCrowd::PromoteAgent(int32 index) {
+	if (EnemyClass != nullptr) {
+		const FRotator rotation = agents.Velocities[index].IsNearlyZero() ? GetActorRotation() : agents.Velocities[index].Rotation();
+		const FTransform transform(rotation, agents.Positions[index]);
+		if (UEnemyPoolSubsystem* pool = GetWorld()->GetSubsystem<UEnemyPoolSubsystem>()) {
+			pool->QueueActivation(EnemyClass, transform, agents.HP[index], FOnEnemyActivated::CreateWeakLambda(this, [this](AEnemy* enemy) {
+				promotedEnemies.Add(enemy);
+			}));
+		}
+		else {
+			FActorSpawnParameters spawnParams;
+			spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+			if (AEnemy* enemy = GetWorld()->SpawnActor<AEnemy>(EnemyClass, transform, spawnParams)) {
+				enemy->SetHP(agents.HP[index]);
+				promotedEnemies.Add(enemy);
+			}
+		}
+	}
+
+	RemoveAgent(index);
+}
+
+void AEnemyCrowd::UpdateAgentMesh() {
+	const int32 count = agents.Num();
+	instanceTransforms.SetNum(count, false);
+	instanceAgents.SetNum(count, false);
+	for (int32 i = 0; i < count; i++) {
+		const FRotator rotation = agents.Velocities[i].IsNearlyZero() ? FRotator::ZeroRotator : agents.Velocities[i].Rotation();
+		instanceTransforms[i] = FTransform(rotation, agents.Positions[i]);
+		agents.Instances[i] = i;
+		instanceAgents[i] = i;
+	}
+
+	if (bAgentCountChanged) {
+		bAgentCountChanged = false;
+
+		const int32 instances = AgentMesh->GetInstanceCount();
+		if (instances > count) {
+			// Trim from the end so the indices of the instances we keep don't move.
+			TArray<int32> toRemove;
+			for (int32 i = instances - 1; i >= count; i--) {
+				toRemove.Add(i);
+			}
+			AgentMesh->RemoveInstances(toRemove);
+		}
+		else if (instances < count) {
+			TArray<FTransform> toAdd(instanceTransforms.GetData() + instances, count - instances);
+			AgentMesh->AddInstances(toAdd, false, true);
+		}
+	}
+
+	if (count > 0) {
+		AgentMesh->BatchUpdateInstancesTransforms(0, instanceTransforms, true, true, true);
+	}
+}
+
+int32 AEnemyCrowd::FindAgentAt(FVector pos) const {
+	int32 closest = INDEX_NONE;
+	float closestSquared = AgentHitRadius * AgentHitRadius;
+	for (int32 i = 0; i < agents.Num(); i++) {
+		const float distanceSquared = FVector::DistSquared(agents.Positions[i], pos);
+		if (distanceSquared <= closestSquared) {
+			closestSquared = distanceSquared;
+			closest = i;
+		}
+	}
+	return closest;
+}
+
+void AEnemyCrowd::ApplyAgentDamage(int32 index, float damage) {
+	agents.HP[index] -= damage;
+	if (agents.HP[index] <= 0) {
+		RemoveAgent(index);
+	}
+	else {
+		// Getting shot is enough to earn a real actor.
+		PromoteAgent(index);
+	}
+}
+
+void AEnemyCrowd::OnHit_Implementation(FVector pos, FWeapon weaponUsed) {
+	const int32 index = FindAgentAt(pos);
+	if (index != INDEX_NONE) {
+		ApplyAgentDamage(index, weaponUsed.baseDamage);
+	}
+}
+
+void AEnemyCrowd::OnShotHit_Implementation(const FShotHit& shot, FWeapon weaponUsed) {
+	if (shot.PelletCount <= 0) {
+		return;
+	}
+
+	// Several pellets can hit the same agent, and promoting or removing an agent moves another one into its index.
+	// So add the damage up per agent first, then apply it from the highest index down.
+	const float damagePerPellet = shot.TotalDamage / shot.PelletCount;
+	TArray<TPair<int32, float>, TInlineAllocator<16>> damaged;
+
+	// The hit says which instance it struck, which is exact even while the mesh lags behind where the agents have got to.
+	for (int32 pellet = 0; pellet < shot.HitItems.Num(); pellet++) {
+		if (!shot.HitComponents.IsValidIndex(pellet) || shot.HitComponents[pellet] != AgentMesh) {
+			continue;
+		}
+		const int32 index = GetAgentForInstance(shot.HitItems[pellet]);
+		if (index == INDEX_NONE) {
+			continue;
+		}
+
+		TPair<int32, float>* entry = damaged.FindByPredicate([index](const TPair<int32, float>& pair) { return pair.Key == index; });
+		if (entry == nullptr) {
+			entry = &damaged.Emplace_GetRef(index, 0.0f);
+		}
+		entry->Value += damagePerPellet;
+	}
+
+	damaged.Sort([](const TPair<int32, float>& a, const TPair<int32, float>& b) { return a.Key > b.Key; });
+	for (const TPair<int32, float>& entry : damaged) {
+		ApplyAgentDamage(entry.Key, entry.Value);
+	}
+}
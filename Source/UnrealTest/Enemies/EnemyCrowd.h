@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "HitBehaviorInterface.h"
+#include "EnemyCrowd.generated.h"
+
+class AEnemy;
+class UInstancedStaticMeshComponent;
+
+UENUM()
+enum class ECrowdAgentState : uint8 {
+	/** Too far from the player to care. Doesn't move. */
+	Idle,
+	/** Heading towards the player. */
+	Chasing
+};
+
+/**
+ * Every agent in the crowd, stored as one array per field so the update loops only touch what they need.
+ * All of the arrays always have the same length, and index i in each of them is the same agent.
+ */
+struct FEnemyCrowdAgents {
+public:
+	TArray<FVector> Positions;
+	TArray<FVector> Velocities;
+	TArray<float> HP;
+	TArray<ECrowdAgentState> States;
+	/** The AgentMesh instance drawing each agent, or INDEX_NONE until the next mesh update draws it. */
+	TArray<int32> Instances;
+
+	int32 Num() const { return Positions.Num(); }
+
+	int32 Add(FVector position, float hp);
+
+	/** Moves the last agent into index, same as TArray::RemoveAtSwap. */
+	void RemoveAtSwap(int32 index);
+};
+
+/**
+ * Stands in for a lot of distant enemies at once. Agents are just data (drawn with one instanced mesh) until they get close to the player
+ * or get shot, at which point they're swapped out for a full EnemyClass actor. Enemies the crowd promoted get swapped back once they're far away again.
+ * There's no collision or pathfinding for the agents: they stay on the plane they started on.
+ */
+UCLASS()
+class UNREALTEST_API AEnemyCrowd : public AActor, public IHitBehaviorInterface
+{
+	GENERATED_BODY()
+public:
+	AEnemyCrowd();
+
+	virtual void Tick(float DeltaTime) override;
+
+	virtual void OnHit_Implementation(FVector pos, FWeapon weaponUsed) override;
+
+	virtual void OnShotHit_Implementation(const FShotHit& shot, FWeapon weaponUsed) override;
+
+	/** Adds an agent at location with full health. Returns its index. */
+	UFUNCTION(BlueprintCallable, Category = Crowd)
+	int32 AddAgent(FVector location);
+
+	UFUNCTION(BlueprintCallable, Category = Crowd)
+	int32 GetAgentCount() const { return agents.Num(); }
+
+public:
+	/** What agents turn into when they get promoted. */
+	UPROPERTY(EditAnywhere, Category = Crowd)
+	TSubclassOf<AEnemy> EnemyClass;
+
+	/** How many agents to scatter around the actor when play starts. */
+	UPROPERTY(EditAnywhere, Category = Crowd)
+	int32 InitialAgents = 200;
+
+	UPROPERTY(EditAnywhere, Category = Crowd)
+	float SpawnRadius = 5000.0f;
+
+	UPROPERTY(EditAnywhere, Category = Crowd)
+	float AgentHP = 100.0f;
+
+	UPROPERTY(EditAnywhere, Category = Crowd)
+	float AgentSpeed = 300.0f;
+
+	/** Agents closer than this to a player start chasing them. */
+	UPROPERTY(EditAnywhere, Category = Crowd)
+	float ChaseDistance = 8000.0f;
+
+	/** Agents closer than this to a player become full enemies. */
+	UPROPERTY(EditAnywhere, Category = Crowd)
+	float PromoteDistance = 2500.0f;
+
+	/** Enemies we promoted turn back into agents past this distance. Keep it above PromoteDistance so they don't flip back and forth. */
+	UPROPERTY(EditAnywhere, Category = Crowd)
+	float DemoteDistance = 4000.0f;
+
+	/** A hit point has to be this close to an agent to count as hitting it. */
+	UPROPERTY(EditAnywhere, Category = Crowd)
+	float AgentHitRadius = 100.0f;
+
+	/** How many EnemyClass actors to spawn into the enemy pool when play starts, so promotions don't have to. */
+	UPROPERTY(EditAnywhere, Category = Crowd)
+	int32 PrewarmEnemies = 16;
+
+	/** Seconds between pushing agent positions to the instanced mesh. */
+	UPROPERTY(EditAnywhere, Category = Crowd)
+	float VisualUpdateInterval = 0.05f;
+
+protected:
+	virtual void BeginPlay() override;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Crowd)
+	TObjectPtr<UInstancedStaticMeshComponent> AgentMesh;
+
+private:
+	void SimulateAgents(float DeltaTime, TArrayView<const FVector> viewPoints);
+
+	/** Swaps nearby agents out for actors and far away promoted actors back into agents. */
+	void UpdatePromotions(TArrayView<const FVector> viewPoints);
+
+	void UpdateAgentMesh();
+
+	/** The closest agent within AgentHitRadius of pos, or INDEX_NONE. Only for plain OnHit, which doesn't say what was hit. */
+	int32 FindAgentAt(FVector pos) const;
+
+	/** The agent AgentMesh's instance is drawing, or INDEX_NONE if that agent is gone. */
+	int32 GetAgentForInstance(int32 instance) const { return instanceAgents.IsValidIndex(instance) ? instanceAgents[instance] : INDEX_NONE; }
+
+	/** Removes the agent if this kills it, otherwise promotes it. */
+	void ApplyAgentDamage(int32 index, float damage);
+
+	/** Queues an EnemyClass activation for the agent and removes the agent. The enemy shows up once UEnemyPoolSubsystem has budget for it. */
+	void PromoteAgent(int32 index);
+
+	void RemoveAgent(int32 index);
+
+	static float GetClosestDistanceSquared(FVector location, TArrayView<const FVector> viewPoints);
+
+	FEnemyCrowdAgents agents;
+
+	/** Set whenever an agent is removed so the next mesh update also fixes the instance count. */
+	bool bAgentCountChanged = false;
+
+	float timeUntilVisualUpdate = 0.0f;
+
+	TArray<TWeakObjectPtr<AEnemy>> promotedEnemies;
+
+	TArray<FTransform> instanceTransforms;
+
+	/** Inverse of FEnemyCrowdAgents::Instances. Instances only move on mesh updates, so removed agents are patched in here until then. */
+	TArray<int32> instanceAgents;
+};
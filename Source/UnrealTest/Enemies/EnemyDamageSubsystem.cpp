@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EnemyDamageSubsystem.h"
+#include "Enemy.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static FAutoConsoleCommandWithWorld GDumpEnemyDamageStats(
+	TEXT("ut.Damage.Stats"),
+	TEXT("Prints the queued and processed enemy damage and deaths for the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UEnemyDamageSubsystem* subsystem = World ? World->GetSubsystem<UEnemyDamageSubsystem>() : nullptr) {
+			FEnemyDamageStats stats = subsystem->GetStats();
+			UE_LOG(LogTemp, Display, TEXT("Enemy damage: %d/%d processed, deaths %d/%d processed (%d pending), %.3f ms last frame, %.3f ms total"),
+				stats.DamageProcessed, stats.DamageQueued, stats.DeathsProcessed, stats.DeathsQueued, stats.DeathsPending, stats.LastFrameMs, stats.TotalMs);
+		}
+	})
+);
+
+bool UEnemyDamageSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UEnemyDamageSubsystem::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemyDamageSubsystem, STATGROUP_Tickables);
+}
+
+void UEnemyDamageSubsystem::QueueDamage(AEnemy* enemy, float damage) {
+	if (enemy == nullptr) {
+		return;
+	}
+	damageQueue.Add({ enemy, damage });
+	stats.DamageQueued++;
+}
+
+void UEnemyDamageSubsystem::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+
+	if (damageQueue.Num() == 0 && deathQueueHead >= deathQueue.Num()) {
+		stats.LastFrameMs = 0.0f;
+		return;
+	}
+
+	const double startTime = FPlatformTime::Seconds();
+
+	// Everything from this frame in one go. Enemies that die are only marked here.
+	for (const FQueuedDamage& queued : damageQueue) {
+		stats.DamageProcessed++;
+		AEnemy* enemy = queued.enemy.Get();
+		if (enemy != nullptr && enemy->ApplyQueuedDamage(queued.damage)) {
+			deathQueue.Add(enemy);
+			stats.DeathsQueued++;
+		}
+	}
+	damageQueue.Reset();
+
+	// The actual teardown is the expensive part, so that's what gets spread out over frames.
+	const double budgetEnd = startTime + DeathBudgetMs / 1000.0;
+	int32 processedThisFrame = 0;
+	while (deathQueueHead < deathQueue.Num()) {
+		if (processedThisFrame >= MinDeathsPerFrame && FPlatformTime::Seconds() >= budgetEnd) {
+			break;
+		}
+
+		if (AEnemy* enemy = deathQueue[deathQueueHead].Get()) {
+			enemy->FinishDeath();
+		}
+		deathQueueHead++;
+		processedThisFrame++;
+		stats.DeathsProcessed++;
+	}
+
+	// Drop what's been cleaned up every pass, so kills that keep outpacing the budget can't grow the queue forever.
+	if (deathQueueHead >= deathQueue.Num()) {
+		deathQueue.Reset();
+	}
+	else if (deathQueueHead > 0) {
+		deathQueue.RemoveAt(0, deathQueueHead, false);
+	}
+	deathQueueHead = 0;
+
+	stats.LastFrameMs = (FPlatformTime::Seconds() - startTime) * 1000.0;
+	stats.TotalMs += stats.LastFrameMs;
+}
+
+FEnemyDamageStats UEnemyDamageSubsystem::GetStats() const {
+	FEnemyDamageStats current = stats;
+	current.DeathsPending = deathQueue.Num() - deathQueueHead;
+	return current;
+}
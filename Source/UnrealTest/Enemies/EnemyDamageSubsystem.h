@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "EnemyDamageSubsystem.generated.h"
+
+class AEnemy;
+
+USTRUCT(BlueprintType)
+struct FEnemyDamageStats {
+	GENERATED_BODY()
+public:
+	UPROPERTY(BlueprintReadOnly, Category = Damage)
+	int32 DamageQueued = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Damage)
+	int32 DamageProcessed = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Damage)
+	int32 DeathsQueued = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Damage)
+	int32 DeathsProcessed = 0;
+
+	/** Enemies that are dead but haven't been cleaned up yet. */
+	UPROPERTY(BlueprintReadOnly, Category = Damage)
+	int32 DeathsPending = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Damage)
+	float LastFrameMs = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = Damage)
+	float TotalMs = 0.0f;
+};
+
+/**
+ * Holds on to enemy damage until the end of the frame instead of applying it in the middle of whatever caused it (like a weapon trace).
+ * All of the frame's damage is applied in one pass, and the enemies it kills are cleaned up a few at a time under DeathBudgetMs.
+ */
+UCLASS(config=Game)
+class UNREALTEST_API UEnemyDamageSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void QueueDamage(AEnemy* enemy, float damage);
+
+	UFUNCTION(BlueprintCallable, Category = Damage)
+	FEnemyDamageStats GetStats() const;
+
+public:
+	/** How long we're allowed to spend cleaning up dead enemies each frame. */
+	UPROPERTY(config, EditAnywhere, Category = Damage)
+	float DeathBudgetMs = 1.0f;
+
+	/** Always clean up at least this many dead enemies a frame, even if the budget is gone, so the queue can't get stuck. */
+	UPROPERTY(config, EditAnywhere, Category = Damage)
+	int32 MinDeathsPerFrame = 1;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FQueuedDamage {
+		TWeakObjectPtr<AEnemy> enemy;
+		float damage;
+	};
+
+	TArray<FQueuedDamage> damageQueue;
+
+	/** First in, first out. deathQueueHead is the next one to clean up. */
+	TArray<TWeakObjectPtr<AEnemy>> deathQueue;
+	int32 deathQueueHead = 0;
+
+	FEnemyDamageStats stats;
+};
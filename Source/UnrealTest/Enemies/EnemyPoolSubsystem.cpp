@@ -0,0 +1,224 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EnemyPoolSubsystem.h"
+#include "Enemy.h"
+#include "Engine/World.h"
+#include "GameFramework/WorldSettings.h"
+#include "HAL/IConsoleManager.h"
+
+static FAutoConsoleCommandWithWorld GDumpEnemyPoolStats(
+	TEXT("ut.Enemies.PoolStats"),
+	TEXT("Prints how many enemies each pool has spawned and reused, and how much spawn time that saved."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UEnemyPoolSubsystem* subsystem = World ? World->GetSubsystem<UEnemyPoolSubsystem>() : nullptr) {
+			subsystem->LogPoolStats();
+		}
+	})
+);
+
+bool UEnemyPoolSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UEnemyPoolSubsystem::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemyPoolSubsystem, STATGROUP_Tickables);
+}
+
+void UEnemyPoolSubsystem::Deinitialize() {
+	// Useful for sizing the prewarm counts per map.
+	LogPoolStats();
+	activationQueue.Empty();
+	activationQueueHead = 0;
+	pools.Empty();
+
+	Super::Deinitialize();
+}
+
+void UEnemyPoolSubsystem::OnWorldBeginPlay(UWorld& InWorld) {
+	Super::OnWorldBeginPlay(InWorld);
+
+	// Still part of loading: actors' BeginPlay (and any wave spawner's first wave) comes after this.
+	const FString mapName = UWorld::RemovePIEPrefix(InWorld.GetMapName());
+	for (const FEnemyPoolPrewarm& entry : PrewarmList) {
+		if (!entry.Map.IsEmpty() && entry.Map != mapName) {
+			continue;
+		}
+		if (UClass* enemyClass = entry.EnemyClass.LoadSynchronous()) {
+			Prewarm(enemyClass, entry.Count);
+		}
+		else {
+			UE_LOG(LogTemp, Warning, TEXT("Enemy pool: couldn't load %s to prewarm"), *entry.EnemyClass.ToString());
+		}
+	}
+}
+
+FEnemyPoolStats UEnemyPoolSubsystem::GetStats() const {
+	FEnemyPoolStats current = stats;
+	current.ActivationsPending = activationQueue.Num() - activationQueueHead;
+	const float meanSpawnMs = current.Spawned > 0 ? current.SpawnMs / current.Spawned : 0.0f;
+	current.SpawnMsAvoided = current.Reused * meanSpawnMs - current.ActivationMs;
+	return current;
+}
+
+void UEnemyPoolSubsystem::LogPoolStats() const {
+	const FEnemyPoolStats current = GetStats();
+	UE_LOG(LogTemp, Display, TEXT("Enemy pools: %d spawned (%.2fms), %d reused, %d missed, %d released (%d adopted), %d/%d activations pending, %.2fms spent activating, %.2fms of spawning avoided"),
+		current.Spawned, current.SpawnMs, current.Reused, current.Missed, current.Released, current.Adopted, current.ActivationsPending, current.ActivationsQueued, current.ActivationMs, current.SpawnMsAvoided);
+
+	const FString mapName = GetWorld() ? GetWorld()->GetMapName() : FString();
+	for (const TPair<TObjectPtr<UClass>, FEnemyPool>& pair : pools) {
+		const FEnemyPool& pool = pair.Value;
+		UE_LOG(LogTemp, Display, TEXT("Enemy pool %s on %s: high-water mark %d, %d active, %d free"),
+			*GetNameSafe(pair.Key), *mapName, pool.HighWaterMark, pool.Active, pool.Free.Num());
+	}
+}
+
+AEnemy* UEnemyPoolSubsystem::SpawnPooled(TSubclassOf<AEnemy> enemyClass) {
+	const double startTime = FPlatformTime::Seconds();
+
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	// Not at the origin, where an enemy could turn up in the middle of the level for the moment before it's deactivated.
+	FVector location = PoolLocation;
+	if (const AWorldSettings* worldSettings = GetWorld()->GetWorldSettings()) {
+		location.Z = FMath::Max(location.Z, worldSettings->KillZ + 1000.0f);
+	}
+
+	AEnemy* enemy = GetWorld()->SpawnActor<AEnemy>(enemyClass, FTransform(location), spawnParams);
+	if (enemy != nullptr) {
+		enemy->DeactivateForPool();
+		stats.Spawned++;
+		stats.SpawnMs += (FPlatformTime::Seconds() - startTime) * 1000.0;
+	}
+	return enemy;
+}
+
+void UEnemyPoolSubsystem::Prewarm(TSubclassOf<AEnemy> enemyClass, int32 count) {
+	if (enemyClass == nullptr || GetWorld() == nullptr) {
+		return;
+	}
+
+	FEnemyPool& pool = pools.FindOrAdd(enemyClass);
+	int32 missing = count - (pool.Free.Num() + pool.Active);
+	for (int32 i = 0; i < missing; i++) {
+		if (AEnemy* enemy = SpawnPooled(enemyClass)) {
+			// Spawning can add pools (the enemy's BeginPlay could prewarm something), so don't hold on to the pool reference across it.
+			pools.FindChecked(enemyClass).Free.Add(enemy);
+		}
+	}
+}
+
+AEnemy* UEnemyPoolSubsystem::Acquire(TSubclassOf<AEnemy> enemyClass, const FTransform& transform, float hp) {
+	if (enemyClass == nullptr || GetWorld() == nullptr) {
+		return nullptr;
+	}
+
+	const double startTime = FPlatformTime::Seconds();
+	AEnemy* enemy = nullptr;
+	FEnemyPool* pool = &pools.FindOrAdd(enemyClass);
+	while (enemy == nullptr && pool->Free.Num() > 0) {
+		// Anything that got destroyed out from under us is just dropped.
+		AEnemy* candidate = pool->Free.Pop(false);
+		if (IsValid(candidate)) {
+			enemy = candidate;
+		}
+	}
+
+	if (enemy == nullptr) {
+		enemy = SpawnPooled(enemyClass);
+		pool = &pools.FindChecked(enemyClass);
+		if (enemy == nullptr) {
+			return nullptr;
+		}
+		stats.Missed++;
+	}
+	else {
+		stats.Reused++;
+	}
+
+	pool->Active++;
+	pool->HighWaterMark = FMath::Max(pool->HighWaterMark, pool->Active);
+
+	enemy->ActivateFromPool(transform, hp);
+	stats.ActivationMs += (FPlatformTime::Seconds() - startTime) * 1000.0;
+	return enemy;
+}
+
+void UEnemyPoolSubsystem::QueueActivation(TSubclassOf<AEnemy> enemyClass, const FTransform& transform, float hp, FOnEnemyActivated onActivated) {
+	if (enemyClass == nullptr) {
+		return;
+	}
+	pools.FindOrAdd(enemyClass);
+	activationQueue.Add({ enemyClass, transform, hp, MoveTemp(onActivated) });
+	stats.ActivationsQueued++;
+}
+
+void UEnemyPoolSubsystem::QueueActivationDynamic(TSubclassOf<AEnemy> enemyClass, const FTransform& transform, float hp, FOnEnemyActivatedDynamic onActivated) {
+	QueueActivation(enemyClass, transform, hp, FOnEnemyActivated::CreateLambda([onActivated](AEnemy* enemy) {
+		onActivated.ExecuteIfBound(enemy);
+	}));
+}
+
+void UEnemyPoolSubsystem::Release(AEnemy* enemy) {
+	// Dying and being despawned by a crowd in the same frame would otherwise release it twice.
+	if (!IsValid(enemy) || enemy->IsInPool()) {
+		return;
+	}
+
+	FEnemyPool& pool = pools.FindOrAdd(enemy->GetClass());
+	if (enemy->IsPooled()) {
+		pool.Active = FMath::Max(pool.Active - 1, 0);
+	}
+	else {
+		// Never counted as active, since the pool didn't hand it out.
+		if (pool.Free.Num() >= MaxAdoptedPerClass) {
+			enemy->Destroy();
+			return;
+		}
+		stats.Adopted++;
+	}
+
+	enemy->DeactivateForPool();
+	pool.Free.Add(enemy);
+	stats.Released++;
+}
+
+void UEnemyPoolSubsystem::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+
+	if (activationQueueHead >= activationQueue.Num()) {
+		stats.LastFrameMs = 0.0f;
+		return;
+	}
+
+	const double startTime = FPlatformTime::Seconds();
+	const double budgetEnd = startTime + ActivationBudgetMs / 1000.0;
+	int32 activatedThisFrame = 0;
+	while (activationQueueHead < activationQueue.Num()) {
+		if (activatedThisFrame >= MinActivationsPerFrame && FPlatformTime::Seconds() >= budgetEnd) {
+			break;
+		}
+
+		// Copied out, since the callback could queue more and move the array.
+		FQueuedActivation activation = MoveTemp(activationQueue[activationQueueHead]);
+		activationQueueHead++;
+		activatedThisFrame++;
+
+		if (AEnemy* enemy = Acquire(activation.enemyClass, activation.transform, activation.hp)) {
+			activation.onActivated.ExecuteIfBound(enemy);
+		}
+	}
+
+	// Drop what's been activated every pass, so waves that keep outpacing the budget can't grow the queue forever.
+	if (activationQueueHead >= activationQueue.Num()) {
+		activationQueue.Reset();
+	}
+	else if (activationQueueHead > 0) {
+		activationQueue.RemoveAt(0, activationQueueHead, false);
+	}
+	activationQueueHead = 0;
+
+	stats.LastFrameMs = (FPlatformTime::Seconds() - startTime) * 1000.0;
+}
@@ -0,0 +1,174 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "EnemyPoolSubsystem.generated.h"
+
+class AEnemy;
+
+DECLARE_DELEGATE_OneParam(FOnEnemyActivated, AEnemy*);
+DECLARE_DYNAMIC_DELEGATE_OneParam(FOnEnemyActivatedDynamic, AEnemy*, Enemy);
+
+/** An enemy class to prewarm when a level starts, from config. */
+USTRUCT()
+struct FEnemyPoolPrewarm {
+	GENERATED_BODY()
+public:
+	UPROPERTY(EditAnywhere, Category = Pool)
+	TSoftClassPtr<AEnemy> EnemyClass;
+
+	UPROPERTY(EditAnywhere, Category = Pool)
+	int32 Count = 0;
+
+	/** Only prewarm on this map (its short name, like FirstPersonMap). Empty prewarms on every map. */
+	UPROPERTY(EditAnywhere, Category = Pool)
+	FString Map;
+};
+
+USTRUCT()
+struct FEnemyPool {
+	GENERATED_BODY()
+public:
+	/** Deactivated enemies waiting to be brought back. */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AEnemy>> Free;
+
+	int32 Active = 0;
+
+	/** Most enemies of this class that were out at once. This is what the pool should be prewarmed to. */
+	int32 HighWaterMark = 0;
+};
+
+USTRUCT(BlueprintType)
+struct FEnemyPoolStats {
+	GENERATED_BODY()
+public:
+	/** Enemies that had to be spawned, including the prewarmed ones. */
+	UPROPERTY(BlueprintReadOnly, Category = Pool)
+	int32 Spawned = 0;
+
+	/** Activations that got an enemy out of the pool instead of spawning one. */
+	UPROPERTY(BlueprintReadOnly, Category = Pool)
+	int32 Reused = 0;
+
+	/** Activations that found the pool empty and had to spawn. */
+	UPROPERTY(BlueprintReadOnly, Category = Pool)
+	int32 Missed = 0;
+
+	/** Enemies put back in the pool instead of being destroyed. */
+	UPROPERTY(BlueprintReadOnly, Category = Pool)
+	int32 Released = 0;
+
+	/** Of Released, enemies that weren't spawned by the pool (placed in the level, or spawned by something else) and were taken in when they died. */
+	UPROPERTY(BlueprintReadOnly, Category = Pool)
+	int32 Adopted = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Pool)
+	int32 ActivationsQueued = 0;
+
+	/** Activations still waiting for a frame with budget left. */
+	UPROPERTY(BlueprintReadOnly, Category = Pool)
+	int32 ActivationsPending = 0;
+
+	/** Time spent spawning enemies, prewarming included. */
+	UPROPERTY(BlueprintReadOnly, Category = Pool)
+	float SpawnMs = 0.0f;
+
+	/** Time spent bringing enemies back out of the pool. */
+	UPROPERTY(BlueprintReadOnly, Category = Pool)
+	float ActivationMs = 0.0f;
+
+	/** What the reused enemies would have cost to spawn (at the average spawn time), minus what activating them did cost. */
+	UPROPERTY(BlueprintReadOnly, Category = Pool)
+	float SpawnMsAvoided = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = Pool)
+	float LastFrameMs = 0.0f;
+};
+
+/**
+ * Keeps dead and despawned enemies around, deactivated, so wave spawns don't construct a character (and its weapon mesh and attachment)
+ * for every enemy and destroy it again when it dies. Pools in PrewarmList are prewarmed when the level starts, and activations are
+ * queued and handed out a few at a time under ActivationBudgetMs. Enemies that weren't spawned by the pool are taken in when they die.
+ */
+UCLASS(config=Game)
+class UNREALTEST_API UEnemyPoolSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	/** Makes sure at least count enemies of this class exist, spawning the missing ones deactivated. */
+	UFUNCTION(BlueprintCallable, Category = Pool)
+	void Prewarm(TSubclassOf<AEnemy> enemyClass, int32 count);
+
+	/** Takes an enemy out of the pool (spawning one if it's empty) and brings it back to life at transform with hp, right away. */
+	UFUNCTION(BlueprintCallable, Category = Pool)
+	AEnemy* Acquire(TSubclassOf<AEnemy> enemyClass, const FTransform& transform, float hp);
+
+	/** Acquires an enemy in a later frame, once there's budget for it. onActivated gets it then, and isn't called if it couldn't be spawned. */
+	void QueueActivation(TSubclassOf<AEnemy> enemyClass, const FTransform& transform, float hp, FOnEnemyActivated onActivated = FOnEnemyActivated());
+
+	/** QueueActivation for Blueprints, which need a dynamic delegate for onActivated. */
+	UFUNCTION(BlueprintCallable, Category = Pool, meta = (DisplayName = "Queue Activation"))
+	void QueueActivationDynamic(TSubclassOf<AEnemy> enemyClass, const FTransform& transform, float hp, FOnEnemyActivatedDynamic onActivated);
+
+	/** Deactivates the enemy and puts it back in the pool. Enemies the pool didn't spawn are adopted, unless their pool already has MaxAdoptedPerClass free, in which case they're destroyed. */
+	UFUNCTION(BlueprintCallable, Category = Pool)
+	void Release(AEnemy* enemy);
+
+	UFUNCTION(BlueprintCallable, Category = Pool)
+	FEnemyPoolStats GetStats() const;
+
+	/** Logs the stats and how many enemies each pool has needed so far. */
+	void LogPoolStats() const;
+
+public:
+	/** How long we're allowed to spend on queued activations each frame. */
+	UPROPERTY(config, EditAnywhere, Category = Pool)
+	float ActivationBudgetMs = 1.0f;
+
+	/** Always activate at least this many queued enemies a frame, even if the budget is gone, so the queue can't get stuck. */
+	UPROPERTY(config, EditAnywhere, Category = Pool)
+	int32 MinActivationsPerFrame = 1;
+
+	/** Where pooled enemies are spawned, out of sight well below the map. Kept above the world's KillZ, so they aren't killed for being out of the world. */
+	UPROPERTY(config, EditAnywhere, Category = Pool)
+	FVector PoolLocation = FVector(0.0f, 0.0f, -50000.0f);
+
+	/** Enemy classes to prewarm when a level starts, before any actor's BeginPlay. */
+	UPROPERTY(config, EditAnywhere, Category = Pool)
+	TArray<FEnemyPoolPrewarm> PrewarmList;
+
+	/** Enemies the pool didn't spawn are kept when they die, until their class has this many free. Past that they're destroyed as before. */
+	UPROPERTY(config, EditAnywhere, Category = Pool)
+	int32 MaxAdoptedPerClass = 64;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	AEnemy* SpawnPooled(TSubclassOf<AEnemy> enemyClass);
+
+	UPROPERTY(Transient)
+	TMap<TObjectPtr<UClass>, FEnemyPool> pools;
+
+	struct FQueuedActivation {
+		/** Kept alive by its key in pools. */
+		UClass* enemyClass;
+		FTransform transform;
+		float hp;
+		FOnEnemyActivated onActivated;
+	};
+
+	/** First in, first out. activationQueueHead is the next one to activate. */
+	TArray<FQueuedActivation> activationQueue;
+	int32 activationQueueHead = 0;
+
+	FEnemyPoolStats stats;
+};
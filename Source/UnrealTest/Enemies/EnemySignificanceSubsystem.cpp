@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EnemySignificanceSubsystem.h"
+#include "Enemy.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Camera/PlayerCameraManager.h"
+#include "HAL/IConsoleManager.h"
+
+static FAutoConsoleCommandWithWorld GDumpEnemySignificance(
+	TEXT("ut.Enemies.Significance"),
+	TEXT("Prints how many enemies are in each significance bucket."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UEnemySignificanceSubsystem* subsystem = World ? World->GetSubsystem<UEnemySignificanceSubsystem>() : nullptr) {
+			subsystem->LogBuckets();
+		}
+	})
+);
+
+bool UEnemySignificanceSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UEnemySignificanceSubsystem::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemySignificanceSubsystem, STATGROUP_Tickables);
+}
+
+void UEnemySignificanceSubsystem::RegisterEnemy(AEnemy* enemy) {
+	if (enemy == nullptr || enemies.ContainsByPredicate([enemy](const FTrackedEnemy& tracked) { return tracked.enemy.Get() == enemy; })) {
+		return;
+	}
+
+	FTrackedEnemy& tracked = enemies.AddDefaulted_GetRef();
+	tracked.enemy = enemy;
+	// Make sure new enemies get bucketed quickly rather than ticking at full rate until the next update.
+	timeUntilUpdate = FMath::Min(timeUntilUpdate, 0.0f);
+}
+
+void UEnemySignificanceSubsystem::UnregisterEnemy(AEnemy* enemy) {
+	enemies.RemoveAllSwap([enemy](const FTrackedEnemy& tracked) { return !tracked.enemy.IsValid() || tracked.enemy.Get() == enemy; });
+}
+
+void UEnemySignificanceSubsystem::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+
+	timeUntilUpdate -= DeltaTime;
+	if (timeUntilUpdate <= 0.0f) {
+		timeUntilUpdate = UpdateInterval;
+		UpdateSignificance();
+	}
+}
+
+int32 UEnemySignificanceSubsystem::GetBucket(float distance) const {
+	for (int32 i = 0; i < Buckets.Num(); i++) {
+		if (distance <= Buckets[i].MaxDistance) {
+			return i;
+		}
+	}
+	return Buckets.Num();
+}
+
+bool UEnemySignificanceSubsystem::IsIdle(const AEnemy* enemy) {
+	const UCharacterMovementComponent* movement = enemy->GetCharacterMovement();
+	if (movement == nullptr || !movement->IsMovingOnGround()) {
+		return false;
+	}
+
+	const AController* controller = enemy->GetController();
+	if (controller != nullptr && controller->IsFollowingAPath()) {
+		return false;
+	}
+	return movement->Velocity.IsNearlyZero() && movement->GetCurrentAcceleration().IsNearlyZero();
+}
+
+void UEnemySignificanceSubsystem::UpdateSignificance() {
+	UWorld* world = GetWorld();
+	if (world == nullptr || Buckets.Num() == 0) {
+		return;
+	}
+
+	// Measure from every local player's camera and take the closest.
+	TArray<FVector, TInlineAllocator<4>> viewPoints;
+	for (FConstPlayerControllerIterator it = world->GetPlayerControllerIterator(); it; ++it) {
+		APlayerController* controller = it->Get();
+		if (controller != nullptr && controller->PlayerCameraManager != nullptr) {
+			viewPoints.Add(controller->PlayerCameraManager->GetCameraLocation());
+		}
+	}
+	if (viewPoints.Num() == 0) {
+		return;
+	}
+
+	for (int32 i = enemies.Num() - 1; i >= 0; i--) {
+		FTrackedEnemy& tracked = enemies[i];
+		AEnemy* enemy = tracked.enemy.Get();
+		if (enemy == nullptr) {
+			enemies.RemoveAtSwap(i);
+			continue;
+		}
+		// Dead enemies have already turned their own ticking off.
+		if (enemy->IsDying()) {
+			continue;
+		}
+
+		const FVector location = enemy->GetActorLocation();
+		float closestSquared = TNumericLimits<float>::Max();
+		for (const FVector& viewPoint : viewPoints) {
+			closestSquared = FMath::Min(closestSquared, (float)FVector::DistSquared(location, viewPoint));
+		}
+
+		float distance = FMath::Sqrt(closestSquared);
+		if (!enemy->WasRecentlyRendered(0.2f)) {
+			distance *= NotVisibleDistanceScale;
+		}
+
+		const int32 bucket = GetBucket(distance);
+		const bool dormant = bucket >= Buckets.Num();
+		UCharacterMovementComponent* movement = enemy->GetCharacterMovement();
+
+		if (bucket != tracked.bucket) {
+			tracked.bucket = bucket;
+			const float interval = dormant ? 0.0f : Buckets[bucket].TickInterval;
+
+			enemy->SetActorTickEnabled(!dormant);
+			enemy->SetActorTickInterval(interval);
+			if (movement != nullptr) {
+				// Dormant enemies that are still going somewhere (chasing from out of view, say) keep moving at the slowest rate.
+				movement->SetComponentTickInterval(dormant ? Buckets.Last().TickInterval : interval);
+			}
+		}
+
+		// The closest bucket always keeps moving, so nothing right in front of the player freezes up.
+		// Everywhere else, only idle enemies stop moving.
+		const bool movementTicking = bucket == 0 || !IsIdle(enemy);
+		if (movement != nullptr && movementTicking != tracked.bMovementTicking) {
+			tracked.bMovementTicking = movementTicking;
+			movement->SetComponentTickEnabled(movementTicking);
+		}
+	}
+}
+
+void UEnemySignificanceSubsystem::LogBuckets() const {
+	TArray<int32> counts;
+	counts.SetNumZeroed(Buckets.Num() + 1);
+	int32 movementAsleep = 0;
+	for (const FTrackedEnemy& tracked : enemies) {
+		if (tracked.enemy.IsValid() && tracked.bucket != INDEX_NONE) {
+			counts[tracked.bucket]++;
+			movementAsleep += tracked.bMovementTicking ? 0 : 1;
+		}
+	}
+
+	for (int32 i = 0; i < Buckets.Num(); i++) {
+		UE_LOG(LogTemp, Display, TEXT("Significance bucket %d (<= %.0f, %.2fs interval): %d enemies"), i, Buckets[i].MaxDistance, Buckets[i].TickInterval, counts[i]);
+	}
+	UE_LOG(LogTemp, Display, TEXT("Dormant: %d enemies. Movement not ticking: %d of %d"), counts[Buckets.Num()], movementAsleep, enemies.Num());
+}
@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "EnemySignificanceSubsystem.generated.h"
+
+class AEnemy;
+
+USTRUCT()
+struct FEnemySignificanceBucket {
+	GENERATED_BODY()
+public:
+	/** Enemies closer to the player than this (and further than the previous bucket) land in this bucket. */
+	UPROPERTY(EditAnywhere, Category = Significance)
+	float MaxDistance = 0.0f;
+
+	/** Tick interval for the enemy and its movement component. 0 ticks every frame. */
+	UPROPERTY(EditAnywhere, Category = Significance)
+	float TickInterval = 0.0f;
+};
+
+/**
+ * Sorts enemies into buckets by how far they are from the player and slows down their actor and movement ticks to match.
+ * Enemies past the last bucket stop their actor tick, but keep moving at the last bucket's rate. Only the movement of an enemy that's
+ * standing around idle outside the first bucket stops entirely.
+ */
+UCLASS(config=Game)
+class UNREALTEST_API UEnemySignificanceSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void RegisterEnemy(AEnemy* enemy);
+	void UnregisterEnemy(AEnemy* enemy);
+
+	/** Logs how many enemies are in each bucket. */
+	void LogBuckets() const;
+
+public:
+	/** Ordered from closest to furthest. */
+	UPROPERTY(config, EditAnywhere, Category = Significance)
+	TArray<FEnemySignificanceBucket> Buckets;
+
+	/** Seconds between re-bucketing every enemy. */
+	UPROPERTY(config, EditAnywhere, Category = Significance)
+	float UpdateInterval = 0.25f;
+
+	/** Enemies that haven't been rendered lately are treated as being this many times further away. */
+	UPROPERTY(config, EditAnywhere, Category = Significance)
+	float NotVisibleDistanceScale = 2.0f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void UpdateSignificance();
+
+	/** Returns the bucket for this distance, or Buckets.Num() when the enemy is past all of them. */
+	int32 GetBucket(float distance) const;
+
+	/** Standing still with nowhere to go. */
+	static bool IsIdle(const AEnemy* enemy);
+
+	struct FTrackedEnemy {
+		TWeakObjectPtr<AEnemy> enemy;
+		int32 bucket = INDEX_NONE;
+		bool bMovementTicking = true;
+	};
+
+	TArray<FTrackedEnemy> enemies;
+
+	float timeUntilUpdate = 0.0f;
+};
@@ -6,6 +6,29 @@
 #include "UnrealTest/FP_Character/TP_WeaponComponent.h"
 #include "HitBehaviorInterface.generated.h"
 
+/** Everything one shot did to one actor, with all of its pellets added together. */
+USTRUCT(BlueprintType)
+struct FShotHit {
+	GENERATED_BODY()
+public:
+	UPROPERTY(BlueprintReadOnly, Category = "Hit Behavior")
+	int32 PelletCount = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Hit Behavior")
+	float TotalDamage = 0.0f;
+
+	/** Impact point of every pellet, in the order they were traced. */
+	UPROPERTY(BlueprintReadOnly, Category = "Hit Behavior")
+	TArray<FVector> HitPoints;
+
+	/** The component each pellet struck, matching HitPoints. */
+	UPROPERTY(BlueprintReadOnly, Category = "Hit Behavior")
+	TArray<TObjectPtr<UPrimitiveComponent>> HitComponents;
+
+	/** FHitResult::Item for each pellet, matching HitPoints. On an instanced mesh, that's the instance it struck. */
+	UPROPERTY(BlueprintReadOnly, Category = "Hit Behavior")
+	TArray<int32> HitItems;
+};
 
 UINTERFACE(MinimalAPI)
 class UHitBehaviorInterface : public UInterface
@@ -18,4 +41,8 @@ class IHitBehaviorInterface {
 public:
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category="Hit Behavior")
 	void OnHit(FVector pos, FWeapon weaponUsed);
+
+	/** Called once per shot, instead of once per pellet. shot.TotalDamage already adds up every pellet that hit. */
+	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category="Hit Behavior")
+	void OnShotHit(const FShotHit& shot, FWeapon weaponUsed);
 };
\ No newline at end of file
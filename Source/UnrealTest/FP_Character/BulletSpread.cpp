@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BulletSpread.h"
+#include "Math/RandomStream.h"
+#include "Math/QuatRotationTranslationMatrix.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<bool> CVarBatchSpreadRotate(
+	TEXT("ut.Weapon.BatchSpreadRotate"),
+	true,
+	TEXT("Rotate all of a shot's pellet directions through one rotation matrix instead of one FQuat::RotateVector at a time."));
+
+void FBulletSpreadTable::Build(const FBulletSpreadPattern& pattern) {
+	directions.Reset();
+	pelletsPerVariant = 0;
+
+	switch (pattern.Mode) {
+		case EBulletSpreadMode::Fixed:
+			for (const FVector& direction : pattern.FixedDirections) {
+				directions.Add(direction.GetSafeNormal(UE_SMALL_NUMBER, FVector::ForwardVector));
+			}
+			pelletsPerVariant = directions.Num();
+		break;
+		case EBulletSpreadMode::SeededRandom: {
+			const int32 pellets = FMath::Max(pattern.PelletCount, 1);
+			const int32 variants = FMath::Max(pattern.Variants, 1);
+			const float coneRadians = FMath::DegreesToRadians(FMath::Clamp(pattern.ConeHalfAngle, 0.0f, 90.0f));
+
+			FRandomStream stream(pattern.Seed);
+			directions.Reserve(pellets * variants);
+			for (int32 i = 0; i < pellets * variants; i++) {
+				directions.Add(stream.VRandCone(FVector::ForwardVector, coneRadians));
+			}
+			pelletsPerVariant = pellets;
+		}
+		break;
+		default:
+		break;
+	}
+}
+
+TArrayView<const FVector> FBulletSpreadTable::GetVariant(int32 variant) const {
+	if (pelletsPerVariant == 0) {
+		return TArrayView<const FVector>();
+	}
+	return TArrayView<const FVector>(directions.GetData() + (variant % NumVariants()) * pelletsPerVariant, pelletsPerVariant);
+}
+
+void FBulletSpreadTable::RotateDirections(const FQuat& rotation, TArrayView<const FVector> from, TArrayView<FVector> to) {
+	check(from.Num() == to.Num());
+
+	if (CVarBatchSpreadRotate.GetValueOnGameThread()) {
+		// Turning the quaternion into a matrix once leaves nine multiply-adds per direction, with no dependency between
+		// directions, instead of the two cross products FQuat::RotateVector does for each one.
+		const FMatrix matrix = FQuatRotationMatrix(rotation);
+		const double xx = matrix.M[0][0], xy = matrix.M[0][1], xz = matrix.M[0][2];
+		const double yx = matrix.M[1][0], yy = matrix.M[1][1], yz = matrix.M[1][2];
+		const double zx = matrix.M[2][0], zy = matrix.M[2][1], zz = matrix.M[2][2];
+
+		const FVector* RESTRICT in = from.GetData();
+		FVector* RESTRICT out = to.GetData();
+		const int32 count = from.Num();
+		for (int32 i = 0; i < count; i++) {
+			const double x = in[i].X, y = in[i].Y, z = in[i].Z;
+			// Row vector times matrix, same as FMatrix::TransformVector.
+			out[i].X = x * xx + y * yx + z * zx;
+			out[i].Y = x * xy + y * yy + z * zy;
+			out[i].Z = x * xz + y * yz + z * zz;
+		}
+	}
+	else {
+		for (int32 i = 0; i < from.Num(); i++) {
+			to[i] = rotation.RotateVector(from[i]);
+		}
+	}
+}
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BulletSpread.generated.h"
+
+UENUM(BlueprintType)
+enum class EBulletSpreadMode : uint8 {
+	/** Calls GetBulletSpread every shot, so Blueprint overrides still work. */
+	Event,
+	/** Always fires along FixedDirections. */
+	Fixed,
+	/** PelletCount directions inside the cone, generated once from Seed. */
+	SeededRandom
+};
+
+/**
+ * Spread written down as data, so it can be worked out once when the weapon starts instead of every shot.
+ * Directions are all relative to (1, 0, 0) being forward, same as GetBulletSpread.
+ */
+USTRUCT(BlueprintType)
+struct FBulletSpreadPattern {
+	GENERATED_BODY()
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Spread)
+	EBulletSpreadMode Mode = EBulletSpreadMode::Event;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Spread, meta = (EditCondition = "Mode == EBulletSpreadMode::Fixed"))
+	TArray<FVector> FixedDirections;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Spread, meta = (ClampMin = "1", EditCondition = "Mode == EBulletSpreadMode::SeededRandom"))
+	int32 PelletCount = 8;
+
+	/** In degrees. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Spread, meta = (ClampMin = "0", ClampMax = "90", EditCondition = "Mode == EBulletSpreadMode::SeededRandom"))
+	float ConeHalfAngle = 5.0f;
+
+	/** The same seed always gives the same pellets, which makes hits reproducible. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Spread, meta = (EditCondition = "Mode == EBulletSpreadMode::SeededRandom"))
+	int32 Seed = 0;
+
+	/** How many different random patterns to generate. Shots cycle through them in order. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Spread, meta = (ClampMin = "1", EditCondition = "Mode == EBulletSpreadMode::SeededRandom"))
+	int32 Variants = 1;
+};
+
+/**
+ * The precomputed directions of a FBulletSpreadPattern, stored variant after variant in one flat array.
+ */
+struct FBulletSpreadTable {
+public:
+	/** Fills the table from the pattern. Leaves it empty for EBulletSpreadMode::Event. */
+	void Build(const FBulletSpreadPattern& pattern);
+
+	bool IsEmpty() const { return pelletsPerVariant == 0; }
+
+	int32 NumVariants() const { return pelletsPerVariant > 0 ? directions.Num() / pelletsPerVariant : 0; }
+
+	TArrayView<const FVector> GetVariant(int32 variant) const;
+
+	/** Rotates every direction in from by rotation into to. Builds one rotation matrix for the whole batch unless ut.Weapon.BatchSpreadRotate is 0. */
+	static void RotateDirections(const FQuat& rotation, TArrayView<const FVector> from, TArrayView<FVector> to);
+
+private:
+	TArray<FVector> directions;
+	int32 pelletsPerVariant = 0;
+};
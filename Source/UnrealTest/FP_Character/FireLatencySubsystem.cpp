@@ -0,0 +1,207 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FireLatencySubsystem.h"
+#include "UnrealTest/Benchmark/BenchmarkReport.h"
+#include "Engine/World.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/Count.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/Parse.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+#include "ProfilingDebugging/MiscTrace.h"
+
+// "stat FireLatency" in game.
+DECLARE_STATS_GROUP(TEXT("Fire Latency"), STATGROUP_FireLatency, STATCAT_Advanced);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Shots Tracked"), STAT_FireLatencyShots, STATGROUP_FireLatency);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Last Fire (ms)"), STAT_FireLatencyFire, STATGROUP_FireLatency);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Last Traced (ms)"), STAT_FireLatencyTraced, STATGROUP_FireLatency);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Last Hit (ms)"), STAT_FireLatencyHit, STATGROUP_FireLatency);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Last Decal (ms)"), STAT_FireLatencyDecal, STATGROUP_FireLatency);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Last Sound (ms)"), STAT_FireLatencySound, STATGROUP_FireLatency);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Last Montage (ms)"), STAT_FireLatencyMontage, STATGROUP_FireLatency);
+
+// A bookmark per stage, per shot. Turn it on in Insights with -trace=default,FireLatency.
+UE_TRACE_CHANNEL(FireLatencyChannel);
+
+static TAutoConsoleVariable<bool> CVarFireLatencyTracking(
+	TEXT("ut.Fire.LatencyTracking"),
+	true,
+	TEXT("Time every shot from its input to each stage of the fire path."));
+
+static FAutoConsoleCommandWithWorld GLogFireLatency(
+	TEXT("ut.Fire.Latency"),
+	TEXT("Prints the p50/p95/p99 latency of every stage of the fire path."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UFireLatencySubsystem* subsystem = World ? World->GetSubsystem<UFireLatencySubsystem>() : nullptr) {
+			subsystem->LogLatency();
+		}
+	})
+);
+
+static FAutoConsoleCommandWithWorldAndArgs GWriteFireLatencyCsv(
+	TEXT("ut.Fire.LatencyCsv"),
+	TEXT("Writes the fire path latency per stage to Saved/Benchmarks/FireLatency.csv. Arguments: Reset=0/1 (start over afterwards)"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World) {
+		if (UFireLatencySubsystem* subsystem = World ? World->GetSubsystem<UFireLatencySubsystem>() : nullptr) {
+			bool bReset = false;
+			FParse::Bool(*FString::Join(Args, TEXT(" ")), TEXT("Reset="), bReset);
+			subsystem->WriteCsv();
+			if (bReset) {
+				subsystem->Reset();
+			}
+		}
+	})
+);
+
+namespace {
+	// Upper edges of the histogram buckets, in milliseconds. Anything slower goes in one last bucket.
+	const double HistogramBucketsMs[] = { 4.0, 8.0, 16.0, 33.0, 50.0, 100.0 };
+}
+
+void UFireLatencySubsystem::FStageSamples::Add(double sampleMs, uint32 sampleFrames, int32 maxSamples) {
+	if (ms.Num() < maxSamples) {
+		ms.Add(sampleMs);
+		frames.Add(sampleFrames);
+		return;
+	}
+	next = next % ms.Num();
+	ms[next] = sampleMs;
+	frames[next] = sampleFrames;
+	next++;
+}
+
+bool UFireLatencySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+const TCHAR* UFireLatencySubsystem::GetStageName(EFireLatencyStage stage) {
+	switch (stage) {
+		case EFireLatencyStage::Fire: return TEXT("Fire");
+		case EFireLatencyStage::Traced: return TEXT("Traced");
+		case EFireLatencyStage::Hit: return TEXT("Hit");
+		case EFireLatencyStage::Decal: return TEXT("Decal");
+		case EFireLatencyStage::Sound: return TEXT("Sound");
+		case EFireLatencyStage::Montage: return TEXT("Montage");
+		default: return TEXT("Unknown");
+	}
+}
+
+uint32 UFireLatencySubsystem::BeginShot() {
+	if (!CVarFireLatencyTracking.GetValueOnGameThread()) {
+		return 0;
+	}
+
+	// Input is read at the start of the frame, so that's as early as the game could have known about the shot.
+	// With a fixed time step the frame times aren't real, so it's timed from here instead.
+	const double now = FPlatformTime::Seconds();
+	const double inputTime = FApp::UseFixedTimeStep() ? now : FMath::Min(FApp::GetCurrentTime(), now);
+
+	// Drop shots that are never going to get any further.
+	shots.RemoveAllSwap([now, this](const FShot& shot) { return now - shot.inputTime > ShotTimeout; }, false);
+
+	FShot& shot = shots.AddDefaulted_GetRef();
+	shot.id = nextShotId++;
+	if (nextShotId == 0) {
+		nextShotId = 1;
+	}
+	shot.inputTime = inputTime;
+	shot.inputFrame = GFrameCounter;
+	INC_DWORD_STAT(STAT_FireLatencyShots);
+	return shot.id;
+}
+
+void UFireLatencySubsystem::MarkStage(uint32 shotId, EFireLatencyStage stage) {
+	if (shotId == 0) {
+		return;
+	}
+	FShot* shot = shots.FindByPredicate([shotId](const FShot& entry) { return entry.id == shotId; });
+	const uint8 stageBit = 1 << (uint8)stage;
+	if (shot == nullptr || (shot->stagesReached & stageBit) != 0) {
+		return;
+	}
+	shot->stagesReached |= stageBit;
+
+	const double ms = (FPlatformTime::Seconds() - shot->inputTime) * 1000.0;
+	const uint32 frames = (uint32)(GFrameCounter - shot->inputFrame);
+	stages[(int32)stage].Add(ms, frames, FMath::Max(MaxSamples, 1));
+
+	switch (stage) {
+		case EFireLatencyStage::Fire: SET_FLOAT_STAT(STAT_FireLatencyFire, ms); break;
+		case EFireLatencyStage::Traced: SET_FLOAT_STAT(STAT_FireLatencyTraced, ms); break;
+		case EFireLatencyStage::Hit: SET_FLOAT_STAT(STAT_FireLatencyHit, ms); break;
+		case EFireLatencyStage::Decal: SET_FLOAT_STAT(STAT_FireLatencyDecal, ms); break;
+		case EFireLatencyStage::Sound: SET_FLOAT_STAT(STAT_FireLatencySound, ms); break;
+		case EFireLatencyStage::Montage: SET_FLOAT_STAT(STAT_FireLatencyMontage, ms); break;
+		default: break;
+	}
+
+	if (UE_TRACE_CHANNELEXPR_IS_ENABLED(FireLatencyChannel)) {
+		TRACE_BOOKMARK(TEXT("Shot %u %s: %.2fms, %u frames"), shotId, GetStageName(stage), ms, frames);
+	}
+}
+
+void UFireLatencySubsystem::Reset() {
+	shots.Reset();
+	for (FStageSamples& samples : stages) {
+		samples = FStageSamples();
+	}
+}
+
+void UFireLatencySubsystem::LogLatency() const {
+	for (int32 i = 0; i < (int32)EFireLatencyStage::Count; i++) {
+		TArray<double> ms = stages[i].ms;
+		if (ms.Num() == 0) {
+			continue;
+		}
+		const int32 lateFrames = Algo::CountIf(stages[i].frames, [](uint32 frames) { return frames > 0; });
+		const double p50 = FBenchmarkReport::Percentile(ms, 0.5);
+		const double p95 = FBenchmarkReport::Percentile(ms, 0.95);
+		const double p99 = FBenchmarkReport::Percentile(ms, 0.99);
+		UE_LOG(LogTemp, Display, TEXT("Fire latency %-8s %5d samples: p50 %.2fms, p95 %.2fms, p99 %.2fms, %d a frame or more late"),
+			GetStageName((EFireLatencyStage)i), ms.Num(), p50, p95, p99, lateFrames);
+	}
+}
+
+void UFireLatencySubsystem::WriteCsv() const {
+	FBenchmarkReport report(TEXT("FireLatency"));
+	const FString timestamp = FDateTime::Now().ToIso8601();
+
+	for (int32 i = 0; i < (int32)EFireLatencyStage::Count; i++) {
+		TArray<double> ms = stages[i].ms;
+		const TArray<uint32>& frames = stages[i].frames;
+
+		double meanFrames = 0.0;
+		uint32 maxFrames = 0;
+		for (uint32 sample : frames) {
+			meanFrames += sample;
+			maxFrames = FMath::Max(maxFrames, sample);
+		}
+		meanFrames = frames.Num() > 0 ? meanFrames / frames.Num() : 0.0;
+
+		report.AddRow();
+		report.Set(TEXT("timestamp"), timestamp);
+		report.Set(TEXT("stage"), FString(GetStageName((EFireLatencyStage)i)));
+		report.Set(TEXT("samples"), ms.Num());
+		report.Set(TEXT("mean_ms"), FBenchmarkReport::Mean(ms));
+		report.Set(TEXT("p50_ms"), FBenchmarkReport::Percentile(ms, 0.5));
+		report.Set(TEXT("p95_ms"), FBenchmarkReport::Percentile(ms, 0.95));
+		report.Set(TEXT("p99_ms"), FBenchmarkReport::Percentile(ms, 0.99));
+		report.Set(TEXT("max_ms"), ms.Num() > 0 ? ms.Last() : 0.0);
+		report.Set(TEXT("mean_frames"), meanFrames);
+		report.Set(TEXT("max_frames"), (int64)maxFrames);
+
+		// ms is sorted by now, so each bucket is just how far along it the edge is.
+		int32 counted = 0;
+		for (double edge : HistogramBucketsMs) {
+			const int32 below = Algo::LowerBound(ms, edge);
+			report.Set(FString::Printf(TEXT("under_%.0fms"), edge), below - counted);
+			counted = below;
+		}
+		report.Set(FString::Printf(TEXT("over_%.0fms"), HistogramBucketsMs[UE_ARRAY_COUNT(HistogramBucketsMs) - 1]), ms.Num() - counted);
+	}
+
+	report.Write();
+}
@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FireLatencySubsystem.generated.h"
+
+/** The points along the fire path that get timed, in the order they normally happen. */
+UENUM()
+enum class EFireLatencyStage : uint8 {
+	/** UTP_WeaponComponent::Fire ran. */
+	Fire,
+	/** The shot's traces came back and its hits started resolving. */
+	Traced,
+	/** OnShotHit and the impulses were sent out. */
+	Hit,
+	Decal,
+	Sound,
+	Montage,
+	Count UMETA(Hidden)
+};
+
+/**
+ * Times each shot from the input that fired it to every stage of its fire path, so changes to the path (like batching its traces)
+ * can be checked for added latency. Times are measured from the start of the frame the input was read in, and frames are counted too.
+ *
+ *   ut.Fire.Latency                 prints p50/p95/p99 per stage
+ *   ut.Fire.LatencyCsv Reset=0/1    writes Saved/Benchmarks/FireLatency.csv, one row per stage
+ */
+UCLASS(config=Game)
+class UNREALTEST_API UFireLatencySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	/** Starts timing a shot. Returns 0 (which every other call ignores) if tracking is off. */
+	uint32 BeginShot();
+
+	/** Records how long shot took to get to stage. Only the first time each stage is reached counts. */
+	void MarkStage(uint32 shot, EFireLatencyStage stage);
+
+	/** Logs every stage's percentiles. */
+	void LogLatency() const;
+
+	/** Writes every stage's percentiles and histogram to Saved/Benchmarks/FireLatency.csv. */
+	void WriteCsv() const;
+
+	void Reset();
+
+	static const TCHAR* GetStageName(EFireLatencyStage stage);
+
+public:
+	/** How many of the most recent samples to keep per stage. */
+	UPROPERTY(config, EditAnywhere, Category = Latency)
+	int32 MaxSamples = 4096;
+
+	/** A shot that hasn't reached a stage within this long never will (it missed, for instance), so it stops being tracked. */
+	UPROPERTY(config, EditAnywhere, Category = Latency)
+	float ShotTimeout = 1.0f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FShot {
+		uint32 id;
+		/** When the frame that read the input started. */
+		double inputTime;
+		uint64 inputFrame;
+		uint8 stagesReached = 0;
+	};
+
+	struct FStageSamples {
+		/** A ring of the latest MaxSamples, in milliseconds. */
+		TArray<double> ms;
+		TArray<uint32> frames;
+		int32 next = 0;
+
+		void Add(double sampleMs, uint32 sampleFrames, int32 maxSamples);
+	};
+
+	TArray<FShot> shots;
+	FStageSamples stages[(int32)EFireLatencyStage::Count];
+	uint32 nextShotId = 1;
+};
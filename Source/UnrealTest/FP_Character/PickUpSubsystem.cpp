@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PickUpSubsystem.h"
+#include "TP_PickUpComponent.h"
+#include "UnrealTestCharacter.h"
+#include "Components/CapsuleComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static FAutoConsoleCommandWithWorld GDumpPickUps(
+	TEXT("ut.PickUps.Stats"),
+	TEXT("Prints how many pickups and grid cells there are, and how many the last frame checked."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UPickUpSubsystem* subsystem = World ? World->GetSubsystem<UPickUpSubsystem>() : nullptr) {
+			subsystem->LogStats();
+		}
+	})
+);
+
+bool UPickUpSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UPickUpSubsystem::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UPickUpSubsystem, STATGROUP_Tickables);
+}
+
+FIntVector UPickUpSubsystem::GetCell(FVector location) const {
+	return FIntVector(FMath::FloorToInt(location.X / CellSize), FMath::FloorToInt(location.Y / CellSize), FMath::FloorToInt(location.Z / CellSize));
+}
+
+void UPickUpSubsystem::RegisterPickUp(UTP_PickUpComponent* pickUp) {
+	if (pickUp == nullptr || pickUpIndices.Contains(pickUp)) {
+		return;
+	}
+	AddToGrid(pickUp);
+}
+
+void UPickUpSubsystem::UnregisterPickUp(UTP_PickUpComponent* pickUp) {
+	RemoveFromGrid(pickUp);
+}
+
+void UPickUpSubsystem::UpdatePickUp(UTP_PickUpComponent* pickUp) {
+	const int32* found = pickUpIndices.Find(pickUp);
+	if (found == nullptr) {
+		return;
+	}
+	const int32 index = *found;
+
+	// Most moves stay inside the same cells.
+	const FBoxSphereBounds bounds = pickUp->Bounds;
+	if (GetCell(bounds.Origin - FVector(bounds.SphereRadius)) == pickUps[index].minCell && GetCell(bounds.Origin + FVector(bounds.SphereRadius)) == pickUps[index].maxCell) {
+		return;
+	}
+	RemoveFromGrid(pickUp);
+	AddToGrid(pickUp);
+}
+
+void UPickUpSubsystem::AddToGrid(UTP_PickUpComponent* pickUp) {
+	const FBoxSphereBounds bounds = pickUp->Bounds;
+
+	pickUpIndices.Add(pickUp, pickUps.Num());
+	FIndexedPickUp& indexed = pickUps.AddDefaulted_GetRef();
+	indexed.pickUp = pickUp;
+	indexed.minCell = GetCell(bounds.Origin - FVector(bounds.SphereRadius));
+	indexed.maxCell = GetCell(bounds.Origin + FVector(bounds.SphereRadius));
+
+	for (int32 x = indexed.minCell.X; x <= indexed.maxCell.X; x++) {
+		for (int32 y = indexed.minCell.Y; y <= indexed.maxCell.Y; y++) {
+			for (int32 z = indexed.minCell.Z; z <= indexed.maxCell.Z; z++) {
+				grid.FindOrAdd(FIntVector(x, y, z)).Add(pickUp);
+			}
+		}
+	}
+}
+
+void UPickUpSubsystem::RemoveFromGrid(UTP_PickUpComponent* pickUp) {
+	int32 index = INDEX_NONE;
+	if (!pickUpIndices.RemoveAndCopyValue(pickUp, index)) {
+		return;
+	}
+
+	const FIndexedPickUp indexed = pickUps[index];
+	pickUps.RemoveAtSwap(index);
+	// The last pickup has moved into the gap.
+	if (pickUps.IsValidIndex(index)) {
+		pickUpIndices[pickUps[index].pickUp] = index;
+	}
+
+	for (int32 x = indexed.minCell.X; x <= indexed.maxCell.X; x++) {
+		for (int32 y = indexed.minCell.Y; y <= indexed.maxCell.Y; y++) {
+			for (int32 z = indexed.minCell.Z; z <= indexed.maxCell.Z; z++) {
+				const FIntVector cell(x, y, z);
+				if (TArray<UTP_PickUpComponent*>* cellPickUps = grid.Find(cell)) {
+					cellPickUps->RemoveSingleSwap(pickUp);
+					if (cellPickUps->Num() == 0) {
+						grid.Remove(cell);
+					}
+				}
+			}
+		}
+	}
+}
+
+void UPickUpSubsystem::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+
+	lastFrameCandidates = 0;
+	lastFrameCharacters = 0;
+	if (pickUps.Num() == 0) {
+		return;
+	}
+
+	// Only players pick things up, so nobody else (enemies included) needs checking.
+	for (FConstPlayerControllerIterator iterator = GetWorld()->GetPlayerControllerIterator(); iterator; ++iterator) {
+		APlayerController* controller = iterator->Get();
+		AUnrealTestCharacter* character = controller ? Cast<AUnrealTestCharacter>(controller->GetPawn()) : nullptr;
+		if (character == nullptr) {
+			continue;
+		}
+		lastFrameCharacters++;
+
+		const UCapsuleComponent* capsule = character->GetCapsuleComponent();
+		const float capsuleRadius = capsule->GetScaledCapsuleRadius();
+		const float capsuleHalfHeight = capsule->GetScaledCapsuleHalfHeight_WithoutHemisphere();
+		const FVector capsuleUp = capsule->GetUpVector();
+		const FVector capsuleCenter = capsule->GetComponentLocation();
+		const FVector segmentStart = capsuleCenter - capsuleUp * capsuleHalfHeight;
+		const FVector segmentEnd = capsuleCenter + capsuleUp * capsuleHalfHeight;
+
+		const FBox capsuleBounds = capsule->Bounds.GetBox();
+		const FIntVector minCell = GetCell(capsuleBounds.Min);
+		const FIntVector maxCell = GetCell(capsuleBounds.Max);
+
+		for (int32 x = minCell.X; x <= maxCell.X; x++) {
+			for (int32 y = minCell.Y; y <= maxCell.Y; y++) {
+				for (int32 z = minCell.Z; z <= maxCell.Z; z++) {
+					const TArray<UTP_PickUpComponent*>* cellPickUps = grid.Find(FIntVector(x, y, z));
+					if (cellPickUps == nullptr) {
+						continue;
+					}
+
+					for (UTP_PickUpComponent* pickUp : *cellPickUps) {
+						lastFrameCandidates++;
+						// Sphere against capsule: close enough to the capsule's middle segment.
+						const FVector center = pickUp->GetComponentLocation();
+						const float reach = pickUp->GetScaledSphereRadius() + capsuleRadius;
+						if (FMath::PointDistToSegmentSquared(center, segmentStart, segmentEnd) <= reach * reach) {
+							// A pickup spanning several cells can come up more than once.
+							touched.AddUnique(TPair<UTP_PickUpComponent*, AUnrealTestCharacter*>(pickUp, character));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	for (const TPair<UTP_PickUpComponent*, AUnrealTestCharacter*>& pair : touched) {
+		// An earlier pickup this frame could have taken this one out (two characters on the same pickup, for instance).
+		if (pickUpIndices.Contains(pair.Key)) {
+			pickedUp++;
+			pair.Key->PickUp(pair.Value);
+		}
+	}
+	touched.Reset();
+}
+
+void UPickUpSubsystem::LogStats() const {
+	int32 mostInCell = 0;
+	for (const TPair<FIntVector, TArray<UTP_PickUpComponent*>>& pair : grid) {
+		mostInCell = FMath::Max(mostInCell, pair.Value.Num());
+	}
+	UE_LOG(LogTemp, Display, TEXT("Pickups: %d in %d cells (at most %d in a cell), %d picked up. Last frame checked %d characters against %d candidates."),
+		pickUps.Num(), grid.Num(), mostInCell, pickedUp, lastFrameCharacters, lastFrameCandidates);
+}
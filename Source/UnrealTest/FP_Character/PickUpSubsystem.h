@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PickUpSubsystem.generated.h"
+
+class UTP_PickUpComponent;
+class AUnrealTestCharacter;
+
+/**
+ * Keeps every UTP_PickUpComponent in a uniform grid instead of in the physics scene. Each frame, only the players' characters are
+ * checked, against the pickups in the cells around them, and a pickup they touch gets picked up just like it would have on overlap.
+ */
+UCLASS(config=Game)
+class UNREALTEST_API UPickUpSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void RegisterPickUp(UTP_PickUpComponent* pickUp);
+	void UnregisterPickUp(UTP_PickUpComponent* pickUp);
+	/** Re-indexes a pickup that's moved or changed size. */
+	void UpdatePickUp(UTP_PickUpComponent* pickUp);
+
+	/** Logs how many pickups and cells there are, and how much checking the last frame did. */
+	void LogStats() const;
+
+public:
+	/** Size of a grid cell. Pickups are small, so this only needs to be a bit bigger than a character. */
+	UPROPERTY(config, EditAnywhere, Category = PickUps)
+	float CellSize = 500.0f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	FIntVector GetCell(FVector location) const;
+
+	void AddToGrid(UTP_PickUpComponent* pickUp);
+	void RemoveFromGrid(UTP_PickUpComponent* pickUp);
+
+	struct FIndexedPickUp {
+		UTP_PickUpComponent* pickUp = nullptr;
+		FIntVector minCell;
+		FIntVector maxCell;
+	};
+
+	TArray<FIndexedPickUp> pickUps;
+
+	/** Where each pickup is in pickUps, so moving pickups (bobbing, spinning) don't have to search for themselves every update. */
+	TMap<UTP_PickUpComponent*, int32> pickUpIndices;
+
+	TMap<FIntVector, TArray<UTP_PickUpComponent*>> grid;
+
+	/** Scratch space for Tick. Touched pickups only get picked up once every check is done, since that can change the grid. */
+	TArray<TPair<UTP_PickUpComponent*, AUnrealTestCharacter*>> touched;
+
+	int32 lastFrameCandidates = 0;
+	int32 lastFrameCharacters = 0;
+	int32 pickedUp = 0;
+};
@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProjectilePoolSubsystem.h"
+#include "UnrealTestProjectile.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static FAutoConsoleCommandWithWorld GDumpProjectilePoolStats(
+	TEXT("ut.Projectiles.PoolStats"),
+	TEXT("Prints the high-water mark of every projectile pool in the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UProjectilePoolSubsystem* subsystem = World ? World->GetSubsystem<UProjectilePoolSubsystem>() : nullptr) {
+			subsystem->LogPoolStats();
+		}
+	})
+);
+
+bool UProjectilePoolSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UProjectilePoolSubsystem::Deinitialize() {
+	// Useful for sizing the pools per map.
+	LogPoolStats();
+	pools.Empty();
+
+	Super::Deinitialize();
+}
+
+void UProjectilePoolSubsystem::LogPoolStats() const {
+	const FString mapName = GetWorld() ? GetWorld()->GetMapName() : FString();
+	for (const TPair<TObjectPtr<UClass>, FProjectilePool>& pair : pools) {
+		const FProjectilePool& pool = pair.Value;
+		UE_LOG(LogTemp, Display, TEXT("Projectile pool %s on %s: high-water mark %d, %d spawned, %d fired, %d active, %d free"),
+			*GetNameSafe(pair.Key), *mapName, pool.HighWaterMark, pool.Spawned, pool.Acquires, pool.Active, pool.Free.Num());
+	}
+}
+
+AUnrealTestProjectile* UProjectilePoolSubsystem::SpawnPooled(TSubclassOf<AUnrealTestProjectile> projectileClass) {
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	AUnrealTestProjectile* projectile = GetWorld()->SpawnActor<AUnrealTestProjectile>(projectileClass, FTransform::Identity, spawnParams);
+	if (projectile != nullptr) {
+		projectile->DeactivateForPool();
+		pools.FindOrAdd(projectileClass).Spawned++;
+	}
+	return projectile;
+}
+
+void UProjectilePoolSubsystem::Prewarm(TSubclassOf<AUnrealTestProjectile> projectileClass, int32 count) {
+	if (projectileClass == nullptr || GetWorld() == nullptr) {
+		return;
+	}
+
+	FProjectilePool& pool = pools.FindOrAdd(projectileClass);
+	int32 missing = count - (pool.Free.Num() + pool.Active);
+	for (int32 i = 0; i < missing; i++) {
+		if (AUnrealTestProjectile* projectile = SpawnPooled(projectileClass)) {
+			// SpawnPooled can add to the map, so don't hold on to the pool reference across it.
+			pools.FindChecked(projectileClass).Free.Add(projectile);
+		}
+	}
+}
+
+AUnrealTestProjectile* UProjectilePoolSubsystem::Acquire(TSubclassOf<AUnrealTestProjectile> projectileClass, const FTransform& transform, AActor* owner, APawn* instigator) {
+	if (projectileClass == nullptr || GetWorld() == nullptr) {
+		return nullptr;
+	}
+
+	AUnrealTestProjectile* projectile = nullptr;
+	FProjectilePool* pool = &pools.FindOrAdd(projectileClass);
+	while (projectile == nullptr && pool->Free.Num() > 0) {
+		// Anything that got destroyed out from under us is just dropped.
+		AUnrealTestProjectile* candidate = pool->Free.Pop(false);
+		if (IsValid(candidate)) {
+			projectile = candidate;
+		}
+	}
+
+	if (projectile == nullptr) {
+		projectile = SpawnPooled(projectileClass);
+		pool = &pools.FindChecked(projectileClass);
+		if (projectile == nullptr) {
+			return nullptr;
+		}
+	}
+
+	pool->Acquires++;
+	pool->Active++;
+	pool->HighWaterMark = FMath::Max(pool->HighWaterMark, pool->Active);
+
+	projectile->SetOwner(owner);
+	projectile->SetInstigator(instigator);
+	projectile->ActivateFromPool(transform);
+	return projectile;
+}
+
+void UProjectilePoolSubsystem::Release(AUnrealTestProjectile* projectile) {
+	// Hitting something and running out of lifetime in the same frame would otherwise release it twice.
+	if (!IsValid(projectile) || projectile->IsInPool()) {
+		return;
+	}
+
+	projectile->DeactivateForPool();
+
+	FProjectilePool& pool = pools.FindOrAdd(projectile->GetClass());
+	pool.Active = FMath::Max(pool.Active - 1, 0);
+	pool.Free.Add(projectile);
+}
@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ProjectilePoolSubsystem.generated.h"
+
+class AUnrealTestProjectile;
+
+USTRUCT()
+struct FProjectilePool {
+	GENERATED_BODY()
+public:
+	/** Deactivated projectiles waiting to be fired again. */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AUnrealTestProjectile>> Free;
+
+	int32 Active = 0;
+
+	/** Most projectiles of this class that were in flight at once. This is what the pool should be sized to. */
+	int32 HighWaterMark = 0;
+
+	/** Projectiles that had to be spawned, including the prewarmed ones. */
+	int32 Spawned = 0;
+
+	int32 Acquires = 0;
+};
+
+/**
+ * Keeps deactivated projectiles around so firing doesn't spawn and destroy an actor every shot.
+ */
+UCLASS(config=Game)
+class UNREALTEST_API UProjectilePoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual void Deinitialize() override;
+
+	/** Makes sure at least count projectiles of this class exist, spawning the missing ones deactivated. */
+	void Prewarm(TSubclassOf<AUnrealTestProjectile> projectileClass, int32 count);
+
+	/** Takes a projectile out of the pool (spawning one if it's empty) and launches it along the transform's forward. */
+	AUnrealTestProjectile* Acquire(TSubclassOf<AUnrealTestProjectile> projectileClass, const FTransform& transform, AActor* owner, APawn* instigator);
+
+	/** Deactivates the projectile and puts it back in the pool. */
+	void Release(AUnrealTestProjectile* projectile);
+
+	/** Logs how many projectiles each pool has needed so far. */
+	void LogPoolStats() const;
+
+public:
+	/** How many projectiles to prewarm per class when a weapon asks for a pool without a count. */
+	UPROPERTY(config, EditAnywhere, Category = Projectiles)
+	int32 DefaultPrewarmCount = 16;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	AUnrealTestProjectile* SpawnPooled(TSubclassOf<AUnrealTestProjectile> projectileClass);
+
+	UPROPERTY(Transient)
+	TMap<TObjectPtr<UClass>, FProjectilePool> pools;
+};
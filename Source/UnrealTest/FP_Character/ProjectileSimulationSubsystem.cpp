@@ -0,0 +1,378 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProjectileSimulationSubsystem.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "GameFramework/WorldSettings.h"
+#include "Engine/World.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+static FAutoConsoleCommandWithWorld GDumpProjectileSimulationStats(
+	TEXT("ut.Projectiles.Stats"),
+	TEXT("Prints the simulated projectile stats for the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UProjectileSimulationSubsystem* subsystem = World ? World->GetSubsystem<UProjectileSimulationSubsystem>() : nullptr) {
+			FProjectileSimulationStats stats = subsystem->GetStats();
+			UE_LOG(LogTemp, Display, TEXT("Simulated projectiles: %d live (%d max), %d launched, %d sweeps, %d hits, %d bounces, %.3f ms last frame, %.3f ms total"),
+				stats.Live, stats.LiveMax, stats.Launched, stats.Sweeps, stats.Hits, stats.Bounces, stats.LastFrameMs, stats.TotalMs);
+		}
+	})
+);
+
+namespace {
+	// Same collision as AUnrealTestProjectile's sphere.
+	const FName ProjectileProfile(TEXT("Projectile"));
+}
+
+void UProjectileSimulationSubsystem::FProjectileArrays::Add(FVector location, FVector velocity, float gravity, float lifeSpan, uint16 sourceIndex, uint8 bounces) {
+	x.Add(location.X);
+	y.Add(location.Y);
+	z.Add(location.Z);
+	vx.Add(velocity.X);
+	vy.Add(velocity.Y);
+	vz.Add(velocity.Z);
+	gravityZ.Add(gravity);
+	startX.Add(location.X);
+	startY.Add(location.Y);
+	startZ.Add(location.Z);
+	timeLeft.Add(lifeSpan);
+	source.Add(sourceIndex);
+	bouncesLeft.Add(bounces);
+}
+
+void UProjectileSimulationSubsystem::FProjectileArrays::RemoveAtSwap(int32 index) {
+	x.RemoveAtSwap(index, 1, false);
+	y.RemoveAtSwap(index, 1, false);
+	z.RemoveAtSwap(index, 1, false);
+	vx.RemoveAtSwap(index, 1, false);
+	vy.RemoveAtSwap(index, 1, false);
+	vz.RemoveAtSwap(index, 1, false);
+	gravityZ.RemoveAtSwap(index, 1, false);
+	startX.RemoveAtSwap(index, 1, false);
+	startY.RemoveAtSwap(index, 1, false);
+	startZ.RemoveAtSwap(index, 1, false);
+	timeLeft.RemoveAtSwap(index, 1, false);
+	source.RemoveAtSwap(index, 1, false);
+	bouncesLeft.RemoveAtSwap(index, 1, false);
+}
+
+void UProjectileSimulationSubsystem::FProjectileArrays::Reset() {
+	x.Reset();
+	y.Reset();
+	z.Reset();
+	vx.Reset();
+	vy.Reset();
+	vz.Reset();
+	gravityZ.Reset();
+	startX.Reset();
+	startY.Reset();
+	startZ.Reset();
+	timeLeft.Reset();
+	source.Reset();
+	bouncesLeft.Reset();
+}
+
+bool UProjectileSimulationSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UProjectileSimulationSubsystem::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UProjectileSimulationSubsystem, STATGROUP_Tickables);
+}
+
+void UProjectileSimulationSubsystem::Deinitialize() {
+	Clear();
+	for (UInstancedStaticMeshComponent* visual : visuals) {
+		if (visual != nullptr) {
+			visual->DestroyComponent();
+		}
+	}
+	visuals.Empty();
+	visualTransforms.Empty();
+	sources.Empty();
+
+	Super::Deinitialize();
+}
+
+FProjectileSimulationStats UProjectileSimulationSubsystem::GetStats() const {
+	FProjectileSimulationStats result = stats;
+	result.Live = projectiles.Num();
+	return result;
+}
+
+int32 UProjectileSimulationSubsystem::UpdateSource(const UObject* owner, const FSimulatedProjectileSettings& settings, const FWeapon& weaponStats, AActor* ignoredActor) {
+	int32 index = sources.IndexOfByPredicate([owner](const FSource& source) { return source.owner.Get() == owner; });
+	if (index == INDEX_NONE) {
+		// Projectiles only have 16 bits for it. A source is one per weapon, so this would take a lot of weapons.
+		if (!ensure(sources.Num() <= MAX_uint16)) {
+			return INDEX_NONE;
+		}
+		index = sources.AddDefaulted();
+		sources[index].owner = owner;
+	}
+
+	FSource& source = sources[index];
+	source.settings = settings;
+	source.weaponStats = weaponStats;
+	source.shape = FCollisionShape::MakeSphere(settings.Radius);
+	source.queryParams = FCollisionQueryParams(SCENE_QUERY_STAT(SimulatedProjectile), false);
+	source.queryParams.AddIgnoredActor(ignoredActor);
+
+	source.visual = INDEX_NONE;
+	if (settings.Mesh != nullptr) {
+		source.visual = visuals.IndexOfByPredicate([&settings](const UInstancedStaticMeshComponent* visual) { return visual != nullptr && visual->GetStaticMesh() == settings.Mesh; });
+		if (source.visual == INDEX_NONE) {
+			// Like the decals, these just need an actor to live under.
+			UWorld* world = GetWorld();
+			UInstancedStaticMeshComponent* visual = NewObject<UInstancedStaticMeshComponent>(world->GetWorldSettings(), NAME_None, RF_Transient);
+			visual->SetStaticMesh(settings.Mesh);
+			visual->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+			visual->SetCastShadow(false);
+			visual->SetMobility(EComponentMobility::Movable);
+			visual->RegisterComponentWithWorld(world);
+			source.visual = visuals.Add(visual);
+			visualTransforms.AddDefaulted();
+		}
+	}
+	return index;
+}
+
+void UProjectileSimulationSubsystem::Launch(int32 source, FVector location, FVector direction) {
+	if (!sources.IsValidIndex(source)) {
+		return;
+	}
+
+	const FSimulatedProjectileSettings& settings = sources[source].settings;
+	const float gravity = GetWorld()->GetGravityZ() * settings.GravityScale;
+	projectiles.Add(location, direction * settings.Speed, gravity, settings.LifeSpan, (uint16)source, (uint8)FMath::Clamp(settings.MaxBounces, 0, MAX_uint8));
+
+	stats.Launched++;
+	stats.LiveMax = FMath::Max(stats.LiveMax, projectiles.Num());
+}
+
+void UProjectileSimulationSubsystem::Clear() {
+	projectiles.Reset();
+	pendingSweeps.Reset();
+	hits.Reset();
+	UpdateVisuals();
+}
+
+void UProjectileSimulationSubsystem::Tick(float DeltaTime) {
+	Super::Tick(DeltaTime);
+
+	if (projectiles.Num() == 0 && pendingSweeps.Num() == 0) {
+		stats.LastFrameMs = 0.0f;
+		return;
+	}
+
+	const double startTime = FPlatformTime::Seconds();
+
+	// Last frame's async sweeps get dealt with first, before anything moves or gets removed, since they're by index.
+	if (pendingSweeps.Num() > 0) {
+		CollectAsyncSweeps();
+		ApplyHits();
+	}
+	RemoveFinished();
+
+	Integrate(DeltaTime);
+
+	if (bAsyncSweeps) {
+		QueueAsyncSweeps();
+	}
+	else {
+		Sweep();
+		ApplyHits();
+		RemoveFinished();
+	}
+
+	UpdateVisuals();
+
+	stats.LastFrameMs = (FPlatformTime::Seconds() - startTime) * 1000.0;
+	stats.TotalMs += stats.LastFrameMs;
+}
+
+void UProjectileSimulationSubsystem::Integrate(float DeltaTime) {
+	const int32 count = projectiles.Num();
+	const float halfDeltaSquared = 0.5f * DeltaTime * DeltaTime;
+
+	FMemory::Memcpy(projectiles.startX.GetData(), projectiles.x.GetData(), count * sizeof(double));
+	FMemory::Memcpy(projectiles.startY.GetData(), projectiles.y.GetData(), count * sizeof(double));
+	FMemory::Memcpy(projectiles.startZ.GetData(), projectiles.z.GetData(), count * sizeof(double));
+
+	// One plain loop per array, with no branches or lookups, so they all vectorize.
+	double* RESTRICT x = projectiles.x.GetData();
+	double* RESTRICT y = projectiles.y.GetData();
+	double* RESTRICT z = projectiles.z.GetData();
+	float* RESTRICT vz = projectiles.vz.GetData();
+	const float* RESTRICT vx = projectiles.vx.GetData();
+	const float* RESTRICT vy = projectiles.vy.GetData();
+	const float* RESTRICT gravityZ = projectiles.gravityZ.GetData();
+	float* RESTRICT timeLeft = projectiles.timeLeft.GetData();
+
+	for (int32 i = 0; i < count; i++) {
+		x[i] += vx[i] * DeltaTime;
+	}
+	for (int32 i = 0; i < count; i++) {
+		y[i] += vy[i] * DeltaTime;
+	}
+	for (int32 i = 0; i < count; i++) {
+		z[i] += vz[i] * DeltaTime + gravityZ[i] * halfDeltaSquared;
+		vz[i] += gravityZ[i] * DeltaTime;
+	}
+	for (int32 i = 0; i < count; i++) {
+		timeLeft[i] -= DeltaTime;
+	}
+}
+
+void UProjectileSimulationSubsystem::Sweep() {
+	UWorld* world = GetWorld();
+	const int32 count = projectiles.Num();
+	sweepResults.SetNum(count, false);
+	stats.Sweeps += count;
+
+	// Scene queries are safe to run side by side (it's what async traces do), and each sweep only writes its own result.
+	const bool bSingleThread = count < ParallelSweepMinProjectiles;
+	ParallelFor(count, [this, world](int32 index) {
+		FHitResult& out = sweepResults[index];
+		out = FHitResult();
+		const FSource& source = sources[projectiles.source[index]];
+		world->SweepSingleByProfile(out, projectiles.GetStart(index), projectiles.GetLocation(index), FQuat::Identity, ProjectileProfile, source.shape, source.queryParams);
+	}, bSingleThread ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+
+	for (int32 i = 0; i < count; i++) {
+		if (sweepResults[i].bBlockingHit) {
+			hits.Add({ i, sweepResults[i] });
+		}
+	}
+}
+
+void UProjectileSimulationSubsystem::QueueAsyncSweeps() {
+	UWorld* world = GetWorld();
+	const int32 count = projectiles.Num();
+	pendingSweeps.SetNum(count, false);
+	stats.Sweeps += count;
+
+	for (int32 i = 0; i < count; i++) {
+		const FSource& source = sources[projectiles.source[i]];
+		pendingSweeps[i] = world->AsyncSweepByProfile(EAsyncTraceType::Single, projectiles.GetStart(i), projectiles.GetLocation(i), FQuat::Identity, ProjectileProfile, source.shape, source.queryParams);
+	}
+}
+
+void UProjectileSimulationSubsystem::CollectAsyncSweeps() {
+	UWorld* world = GetWorld();
+	FTraceDatum datum;
+	for (int32 i = 0; i < pendingSweeps.Num(); i++) {
+		// Anything that didn't come back (the world can drop them, on a level change for instance) counts as a miss.
+		if (!world->QueryTraceData(pendingSweeps[i], datum)) {
+			continue;
+		}
+		for (const FHitResult& hit : datum.OutHits) {
+			if (hit.bBlockingHit) {
+				hits.Add({ i, hit });
+				break;
+			}
+		}
+	}
+	pendingSweeps.Reset();
+}
+
+void UProjectileSimulationSubsystem::ApplyHits() {
+	if (hits.Num() == 0) {
+		return;
+	}
+	stats.Hits += hits.Num();
+
+	// Grouped by source, so each weapon's hits go out together with its own stats.
+	hits.Sort([this](const FProjectileHit& a, const FProjectileHit& b) { return projectiles.source[a.index] < projectiles.source[b.index]; });
+
+	int32 batchSource = projectiles.source[hits[0].index];
+	for (const FProjectileHit& entry : hits) {
+		const int32 index = entry.index;
+		const int32 sourceIndex = projectiles.source[index];
+		if (sourceIndex != batchSource) {
+			shotHits.Resolve(sources[batchSource].weaponStats);
+			batchSource = sourceIndex;
+		}
+
+		const FSource& source = sources[sourceIndex];
+		const FHitResult& hit = entry.hit;
+		const FVector velocity = projectiles.GetVelocity(index);
+		const AActor* actor = hit.GetActor();
+		const UPrimitiveComponent* component = hit.GetComponent();
+
+		// Physics bodies and things that take damage stop the projectile, the way they stopped AUnrealTestProjectile.
+		const bool bStops = projectiles.bouncesLeft[index] == 0
+			|| (component != nullptr && component->IsSimulatingPhysics(hit.BoneName))
+			|| (actor != nullptr && FShotHitAggregator::ImplementsHitBehavior(actor->GetClass()));
+		if (bStops) {
+			shotHits.AddHit(hit, source.weaponStats.baseDamage, velocity * source.settings.ImpulseScale);
+			projectiles.timeLeft[index] = -1.0f;
+			continue;
+		}
+
+		// A projectile that just bounced can start its next sweep touching the surface. It's already heading away, so let it go.
+		const float speedIntoSurface = FVector::DotProduct(velocity, hit.Normal);
+		if (speedIntoSurface >= 0.0f) {
+			continue;
+		}
+
+		projectiles.SetLocation(index, hit.Location);
+		projectiles.SetVelocity(index, velocity - (1.0f + source.settings.Bounciness) * speedIntoSurface * hit.Normal);
+		projectiles.bouncesLeft[index]--;
+		stats.Bounces++;
+	}
+	shotHits.Resolve(sources[batchSource].weaponStats);
+
+	hits.Reset();
+}
+
+void UProjectileSimulationSubsystem::RemoveFinished() {
+	// Backwards, so every swap brings in one that's already been checked.
+	for (int32 i = projectiles.Num() - 1; i >= 0; i--) {
+		if (projectiles.timeLeft[i] <= 0.0f) {
+			projectiles.RemoveAtSwap(i);
+		}
+	}
+}
+
+void UProjectileSimulationSubsystem::UpdateVisuals() {
+	if (visuals.Num() == 0) {
+		return;
+	}
+
+	for (TArray<FTransform>& transforms : visualTransforms) {
+		transforms.Reset();
+	}
+	for (int32 i = 0; i < projectiles.Num(); i++) {
+		const FSource& source = sources[projectiles.source[i]];
+		if (source.visual != INDEX_NONE) {
+			// Pointing along the velocity, like bRotationFollowsVelocity.
+			visualTransforms[source.visual].Emplace(projectiles.GetVelocity(i).ToOrientationQuat(), projectiles.GetLocation(i), source.settings.MeshScale);
+		}
+	}
+
+	for (int32 v = 0; v < visuals.Num(); v++) {
+		UInstancedStaticMeshComponent* visual = visuals[v];
+		if (!IsValid(visual)) {
+			continue;
+		}
+
+		// Instances are only added or taken off the end, and everything is moved in one batch.
+		const TArray<FTransform>& transforms = visualTransforms[v];
+		const int32 existing = visual->GetInstanceCount();
+		if (transforms.Num() < existing) {
+			TArray<int32> toRemove;
+			for (int32 i = existing - 1; i >= transforms.Num(); i--) {
+				toRemove.Add(i);
+			}
+			visual->RemoveInstances(toRemove);
+		}
+		else if (transforms.Num() > existing) {
+			visual->AddInstances(TArray<FTransform>(transforms.GetData() + existing, transforms.Num() - existing), false, true);
+		}
+		if (transforms.Num() > 0) {
+			visual->BatchUpdateInstancesTransforms(0, transforms, true, true);
+		}
+	}
+}
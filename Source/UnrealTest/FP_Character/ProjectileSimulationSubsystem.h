@@ -0,0 +1,172 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+#include "TP_WeaponComponent.h"
+#include "ShotHitAggregator.h"
+#include "ProjectileSimulationSubsystem.generated.h"
+
+class UInstancedStaticMeshComponent;
+
+USTRUCT(BlueprintType)
+struct FProjectileSimulationStats {
+	GENERATED_BODY()
+public:
+	UPROPERTY(BlueprintReadOnly, Category = Projectiles)
+	int32 Live = 0;
+
+	/** Most projectiles that were in flight at once. */
+	UPROPERTY(BlueprintReadOnly, Category = Projectiles)
+	int32 LiveMax = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Projectiles)
+	int32 Launched = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Projectiles)
+	int32 Sweeps = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Projectiles)
+	int32 Hits = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Projectiles)
+	int32 Bounces = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = Projectiles)
+	float LastFrameMs = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly, Category = Projectiles)
+	float TotalMs = 0.0f;
+};
+
+/**
+ * Flies projectiles without an actor each. Every projectile in flight is a row across a set of flat arrays,
+ * which get integrated in one tight loop per frame. Each frame's collision sweeps go out together (across worker threads,
+ * or as async sweeps resolved next frame), and all of the frame's hits are applied together through FShotHitAggregator.
+ * Drawing them is optional, as instances of one mesh per weapon.
+ */
+UCLASS(config=Game)
+class UNREALTEST_API UProjectileSimulationSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+	virtual void Deinitialize() override;
+
+	/**
+	 * Adds or refreshes the source for owner (usually a weapon), and returns the index to launch its projectiles with.
+	 * Projectiles only carry this index; everything they have in common lives on the source.
+	 */
+	int32 UpdateSource(const UObject* owner, const FSimulatedProjectileSettings& settings, const FWeapon& weaponStats, AActor* ignoredActor);
+
+	/** Fires a projectile from location along direction, which should be normalized. */
+	void Launch(int32 source, FVector location, FVector direction);
+
+	/** Removes every projectile in flight. */
+	void Clear();
+
+	int32 Num() const { return projectiles.Num(); }
+
+	UFUNCTION(BlueprintCallable, Category = Projectiles)
+	FProjectileSimulationStats GetStats() const;
+
+public:
+	/**
+	 * Sweep with async traces, and deal with the results at the start of next frame instead of waiting on them.
+	 * A hit then lands a frame after the projectile got there, which isn't noticeable at these speeds.
+	 */
+	UPROPERTY(config, EditAnywhere, Category = Projectiles)
+	bool bAsyncSweeps = true;
+
+	/** With sync sweeps, spread them across worker threads once there are at least this many. */
+	UPROPERTY(config, EditAnywhere, Category = Projectiles)
+	int32 ParallelSweepMinProjectiles = 64;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FSource {
+		TWeakObjectPtr<const UObject> owner;
+		FSimulatedProjectileSettings settings;
+		FWeapon weaponStats;
+		FCollisionQueryParams queryParams;
+		FCollisionShape shape;
+		/** Into visuals, or INDEX_NONE if these aren't drawn. */
+		int32 visual = INDEX_NONE;
+	};
+
+	/** One array per field, all the same length. A projectile is the same index in each. */
+	struct FProjectileArrays {
+		TArray<double> x, y, z;
+		TArray<float> vx, vy, vz;
+		/** Gravity's pull on each projectile, so the integration doesn't have to look up its source. */
+		TArray<float> gravityZ;
+		/** Where each one was at the start of the frame, so the sweep covers the whole frame's motion. */
+		TArray<double> startX, startY, startZ;
+		TArray<float> timeLeft;
+		TArray<uint16> source;
+		TArray<uint8> bouncesLeft;
+
+		int32 Num() const { return x.Num(); }
+		void Add(FVector location, FVector velocity, float gravity, float lifeSpan, uint16 sourceIndex, uint8 bounces);
+		void RemoveAtSwap(int32 index);
+		void Reset();
+
+		FVector GetLocation(int32 index) const { return FVector(x[index], y[index], z[index]); }
+		FVector GetStart(int32 index) const { return FVector(startX[index], startY[index], startZ[index]); }
+		FVector GetVelocity(int32 index) const { return FVector(vx[index], vy[index], vz[index]); }
+		void SetLocation(int32 index, FVector location) { x[index] = location.X; y[index] = location.Y; z[index] = location.Z; }
+		void SetVelocity(int32 index, FVector velocity) { vx[index] = velocity.X; vy[index] = velocity.Y; vz[index] = velocity.Z; }
+	};
+
+	struct FProjectileHit {
+		int32 index;
+		FHitResult hit;
+	};
+
+	/** Moves everything along by DeltaTime and counts down their life spans. */
+	void Integrate(float DeltaTime);
+
+	/** Sweeps every projectile from its start to where Integrate put it, filling in hits. */
+	void Sweep();
+
+	/** Queues the same sweeps as Sweep, to be collected next frame. */
+	void QueueAsyncSweeps();
+
+	/** Fills in hits from last frame's async sweeps. */
+	void CollectAsyncSweeps();
+
+	/** Bounces or stops every projectile in hits, then sends the frame's damage and impulses out, one batch per source. */
+	void ApplyHits();
+
+	/** Drops every projectile that's out of time or was stopped by a hit. */
+	void RemoveFinished();
+
+	void UpdateVisuals();
+
+	FProjectileArrays projectiles;
+	TArray<FSource> sources;
+
+	/** Only filled in between sweeping and applying hits. */
+	TArray<FProjectileHit> hits;
+
+	/** Async sweeps in flight, by projectile index. Nothing gets removed until they're collected, so the indices hold. */
+	TArray<FTraceHandle> pendingSweeps;
+
+	/** Scratch space for the sync sweeps, one per projectile. */
+	TArray<FHitResult> sweepResults;
+
+	FShotHitAggregator shotHits;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UInstancedStaticMeshComponent>> visuals;
+
+	/** Scratch space for UpdateVisuals, one array per entry in visuals. */
+	TArray<TArray<FTransform>> visualTransforms;
+
+	FProjectileSimulationStats stats;
+};
@@ -0,0 +1,102 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShotHitAggregator.h"
+#include "Components/PrimitiveComponent.h"
+#include "UObject/ObjectKey.h"
+
+void FShotHitAggregator::Reset() {
+	actors.Reset();
+	bodies.Reset();
+}
+
+bool FShotHitAggregator::ImplementsHitBehavior(const UClass* actorClass) {
+	// Only ever touched from the game thread. Keyed by TObjectKey so a recompiled BP class can't pick up a stale answer.
+	static TMap<TObjectKey<UClass>, bool> cache;
+
+	if (actorClass == nullptr) {
+		return false;
+	}
+
+	const TObjectKey<UClass> key(actorClass);
+	if (const bool* cached = cache.Find(key)) {
+		return *cached;
+	}
+	return cache.Add(key, actorClass->ImplementsInterface(UHitBehaviorInterface::StaticClass()));
+}
+
+bool FShotHitAggregator::HandlesShotHit(const UClass* actorClass) {
+	static TMap<TObjectKey<UClass>, bool> cache;
+
+	if (actorClass == nullptr) {
+		return false;
+	}
+
+	const TObjectKey<UClass> key(actorClass);
+	if (const bool* cached = cache.Find(key)) {
+		return *cached;
+	}
+	// Casting to the interface only works for classes that implement it natively.
+	const bool bNative = Cast<IHitBehaviorInterface>(actorClass->GetDefaultObject()) != nullptr;
+	return cache.Add(key, bNative || actorClass->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(IHitBehaviorInterface, OnShotHit)));
+}
+
+void FShotHitAggregator::AddHit(const FHitResult& hit, float damage, FVector impulse) {
+	AActor* actor = hit.GetActor();
+	if (actor != nullptr && ImplementsHitBehavior(actor->GetClass())) {
+		FActorHits* actorHits = actors.FindByPredicate([actor](const FActorHits& entry) { return entry.actor.Get() == actor; });
+		if (actorHits == nullptr) {
+			actorHits = &actors.AddDefaulted_GetRef();
+			actorHits->actor = actor;
+		}
+		actorHits->shot.PelletCount++;
+		actorHits->shot.TotalDamage += damage;
+		actorHits->shot.HitPoints.Add(hit.ImpactPoint);
+		actorHits->shot.HitComponents.Add(hit.GetComponent());
+		actorHits->shot.HitItems.Add(hit.Item);
+	}
+
+	UPrimitiveComponent* component = hit.GetComponent();
+	if (component != nullptr && component->IsSimulatingPhysics(hit.BoneName)) {
+		const FName boneName = hit.BoneName;
+		FBodyHits* bodyHits = bodies.FindByPredicate([component, boneName](const FBodyHits& entry) { return entry.component.Get() == component && entry.boneName == boneName; });
+		if (bodyHits == nullptr) {
+			bodyHits = &bodies.AddDefaulted_GetRef();
+			bodyHits->component = component;
+			bodyHits->boneName = boneName;
+		}
+		bodyHits->impulse += impulse;
+		bodyHits->location += hit.ImpactPoint;
+		bodyHits->count++;
+	}
+}
+
+void FShotHitAggregator::Resolve(const FWeapon& weaponUsed) {
+	// Physics first, so an actor that gets destroyed by its OnShotHit doesn't take the impulse with it.
+	for (const FBodyHits& body : bodies) {
+		if (UPrimitiveComponent* component = body.component.Get()) {
+			component->AddImpulseAtLocation(body.impulse, body.location / body.count, body.boneName);
+		}
+	}
+
+	for (const FActorHits& actorHits : actors) {
+		if (AActor* actor = actorHits.actor.Get()) {
+			if (HandlesShotHit(actor->GetClass())) {
+				IHitBehaviorInterface::Execute_OnShotHit(actor, actorHits.shot, weaponUsed);
+				continue;
+			}
+
+			// Only OnHit in Blueprint, so it gets what it got before shots were aggregated: one call per pellet.
+			FWeapon pellet = weaponUsed;
+			pellet.baseDamage = actorHits.shot.TotalDamage / FMath::Max(actorHits.shot.PelletCount, 1);
+			for (const FVector& hitPoint : actorHits.shot.HitPoints) {
+				if (!IsValid(actor)) {
+					break;
+				}
+				IHitBehaviorInterface::Execute_OnHit(actor, hitPoint, pellet);
+			}
+		}
+	}
+
+	Reset();
+}
@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UnrealTest/Enemies/HitBehaviorInterface.h"
+
+/**
+ * Groups every pellet hit from one shot by actor and by physics body, so each actor gets one OnShotHit
+ * and each body gets one impulse no matter how many pellets landed on it.
+ */
+class UNREALTEST_API FShotHitAggregator {
+public:
+	/** Clears the hits but keeps the memory around for the next shot. */
+	void Reset();
+
+	/** impulse is what this one pellet would have applied to a simulating body. */
+	void AddHit(const FHitResult& hit, float damage, FVector impulse);
+
+	/**
+	 * Applies the combined impulses, sends OnShotHit to every actor that implements IHitBehaviorInterface, then resets.
+	 * Blueprint-only implementers that don't override OnShotHit get the old OnHit per pellet instead.
+	 */
+	void Resolve(const FWeapon& weaponUsed);
+
+	/** Same as ImplementsInterface(UHitBehaviorInterface), but only looked up once per class. */
+	static bool ImplementsHitBehavior(const UClass* actorClass);
+
+	/** Whether the class does something with OnShotHit: it implements the interface in C++ (which has to cover OnShotHit), or overrides OnShotHit in Blueprint. Cached per class. */
+	static bool HandlesShotHit(const UClass* actorClass);
+
+private:
+	struct FActorHits {
+		TWeakObjectPtr<AActor> actor;
+		FShotHit shot;
+	};
+
+	struct FBodyHits {
+		TWeakObjectPtr<UPrimitiveComponent> component;
+		FName boneName;
+		FVector impulse = FVector::ZeroVector;
+		/** Summed up, then divided by count to apply the impulse at the average impact point. */
+		FVector location = FVector::ZeroVector;
+		int32 count = 0;
+	};
+
+	TArray<FActorHits, TInlineAllocator<8>> actors;
+	TArray<FBodyHits, TInlineAllocator<8>> bodies;
+};
@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SimulatedProjectileSettings.generated.h"
+
+class UStaticMesh;
+
+/** How a weapon's simulated projectiles fly. The defaults match AUnrealTestProjectile's movement. */
+USTRUCT(BlueprintType)
+struct FSimulatedProjectileSettings {
+	GENERATED_BODY()
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Projectile)
+	float Speed = 3000.0f;
+
+	/** Multiplies the world's gravity. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Projectile)
+	float GravityScale = 1.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Projectile)
+	float Radius = 5.0f;
+
+	/** Seconds before a projectile that hasn't hit anything is removed. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Projectile)
+	float LifeSpan = 3.0f;
+
+	/** How much of the speed into a surface is kept when bouncing off it. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Projectile)
+	float Bounciness = 0.6f;
+
+	/** Bounces off anything that isn't a physics body or an IHitBehaviorInterface actor, this many times. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Projectile)
+	int32 MaxBounces = 3;
+
+	/** A hit body gets the projectile's velocity times this as an impulse. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Projectile)
+	float ImpulseScale = 100.0f;
+
+	/** Drawn as an instance at every projectile. Leave empty to not draw them at all. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Projectile)
+	TObjectPtr<UStaticMesh> Mesh;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Projectile)
+	FVector MeshScale = FVector(0.1f);
+};
@@ -1,6 +1,14 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "TP_PickUpComponent.h"
+#include "PickUpSubsystem.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<bool> CVarPickUpGrid(
+	TEXT("ut.PickUps.Grid"),
+	true,
+	TEXT("Pickups that start after this is set are found by UPickUpSubsystem's grid, and leave the physics scene. When off, they use overlap events."));
 
 UTP_PickUpComponent::UTP_PickUpComponent()
 {
@@ -12,20 +20,67 @@ void UTP_PickUpComponent::BeginPlay()
 {
 	Super::BeginPlay();
 
+	UPickUpSubsystem* pickUps = GetWorld()->GetSubsystem<UPickUpSubsystem>();
+	if (CVarPickUpGrid.GetValueOnGameThread() && pickUps != nullptr) {
+		// No collision means no physics body at all, so nothing for the broadphase to keep track of.
+		SetGenerateOverlapEvents(false);
+		SetCollisionEnabled(ECollisionEnabled::NoCollision);
+
+		bInPickUpGrid = true;
+		pickUps->RegisterPickUp(this);
+		TransformUpdated.AddUObject(this, &UTP_PickUpComponent::OnTransformUpdated);
+		return;
+	}
+
 	// Register our Overlap Event
 	OnComponentBeginOverlap.AddDynamic(this, &UTP_PickUpComponent::OnSphereBeginOverlap);
 }
 
+void UTP_PickUpComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (bInPickUpGrid) {
+		if (UPickUpSubsystem* pickUps = GetWorld()->GetSubsystem<UPickUpSubsystem>()) {
+			pickUps->UnregisterPickUp(this);
+		}
+		TransformUpdated.RemoveAll(this);
+		bInPickUpGrid = false;
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UTP_PickUpComponent::OnTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	if (UPickUpSubsystem* pickUps = GetWorld()->GetSubsystem<UPickUpSubsystem>()) {
+		pickUps->UpdatePickUp(this);
+	}
+}
+
 void UTP_PickUpComponent::OnSphereBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
 {
 	// Checking if it is a First Person Character overlapping
 	AUnrealTestCharacter* Character = Cast<AUnrealTestCharacter>(OtherActor);
 	if(Character != nullptr)
 	{
-		// Notify that the actor is being picked up
-		OnPickUp.Broadcast(Character);
+		PickUp(Character);
+	}
+}
 
+void UTP_PickUpComponent::PickUp(AUnrealTestCharacter* Character)
+{
+	// Stop listening first, in case whoever handles OnPickUp moves or destroys this
+	if (bInPickUpGrid) {
+		if (UPickUpSubsystem* pickUps = GetWorld()->GetSubsystem<UPickUpSubsystem>()) {
+			pickUps->UnregisterPickUp(this);
+		}
+		TransformUpdated.RemoveAll(this);
+		bInPickUpGrid = false;
+	}
+	else {
 		// Unregister from the Overlap Event so it is no longer triggered
 		OnComponentBeginOverlap.RemoveAll(this);
 	}
+
+	// Notify that the actor is being picked up
+	OnPickUp.Broadcast(Character);
 }
@@ -23,12 +23,24 @@ public:
 	FOnPickUp OnPickUp;
 
 	UTP_PickUpComponent();
+
+	/** Notifies that Character picked this up, and stops it from being picked up again. */
+	void PickUp(AUnrealTestCharacter* Character);
+
 protected:
 
 	/** Called when the game starts */
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	/** Code for when something overlaps this component */
 	UFUNCTION()
 	void OnSphereBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
-};
\ No newline at end of file
+
+private:
+	void OnTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
+	/** Set while UPickUpSubsystem is the one checking for characters, instead of overlap events. */
+	bool bInPickUpGrid = false;
+};
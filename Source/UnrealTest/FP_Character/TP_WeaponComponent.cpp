@@ -4,72 +4,454 @@
 #include "TP_WeaponComponent.h"
 #include "UnrealTestCharacter.h"
 #include "UnrealTestProjectile.h"
+#include "ProjectilePoolSubsystem.h"
+#include "ProjectileSimulationSubsystem.h"
+#include "ShotHitAggregator.h"
+#include "FireLatencySubsystem.h"
 #include "GameFramework/PlayerController.h"
 #include "Camera/PlayerCameraManager.h"
 #include "Kismet/GameplayStatics.h"
 #include "Components/DecalComponent.h"
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
-#include "UnrealTest/Enemies/HitBehaviorInterface.h"
+#include "UnrealTest/Effects/ImpactDecalSubsystem.h"
+#include "UnrealTest/Benchmark/AllocationCounter.h"
+#include "Engine/AssetManager.h"
+#include "HAL/IConsoleManager.h"
+
+namespace {
+	struct FWeaponPreloadStats {
+		int32 Requested = 0;
+		int32 Completed = 0;
+		double TotalMs = 0.0;
+		double MaxMs = 0.0;
+		/** First shots that found everything already loaded. Each one is a hitch that didn't happen. */
+		int32 HitchesAvoided = 0;
+		/** First shots that had to load something on the spot. */
+		int32 SyncLoads = 0;
+	};
+	FWeaponPreloadStats GWeaponPreloadStats;
+}
+
+static FAutoConsoleCommand GDumpWeaponPreloadStats(
+	TEXT("ut.Weapons.Preload"),
+	TEXT("Prints how weapon asset preloading has done: how long it takes, and how many first shots it saved from loading on the spot."),
+	FConsoleCommandDelegate::CreateLambda([]() {
+		const FWeaponPreloadStats& stats = GWeaponPreloadStats;
+		UE_LOG(LogTemp, Display, TEXT("Weapon preloads: %d/%d done, %.2fms on average, %.2fms at most. First shots: %d hitches avoided, %d loaded on the spot"),
+			stats.Completed, stats.Requested, stats.Completed > 0 ? stats.TotalMs / stats.Completed : 0.0, stats.MaxMs, stats.HitchesAvoided, stats.SyncLoads);
+	})
+);
 
 // Sets default values for this component's properties
 UTP_WeaponComponent::UTP_WeaponComponent()
 {
 	fireTraceParams = FCollisionQueryParams();
+
+	// Only ticks while the trigger is held, to fire the shots that come due.
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
 }
 
-void UTP_WeaponComponent::FireFromTrace(UWorld* World, FVector from, FVector forward, FVector newForward) {
+FVector UTP_WeaponComponent::GetPelletDirection(FVector forward, FVector newForward) {
 	// newForward assumes that it's oriented based on (1, 0, 0) being absolute forward. We need to put it in terms of the actual forward vector.
-
-	FVector to = forward - FVector::ForwardVector;
-	to.Normalize();
 	FRotator toRotation = forward.Rotation();
 
 	FVector rotated = toRotation.RotateVector(newForward);
 	rotated.Normalize();
-	
-	FHitResult out;
-	bool hit = World->LineTraceSingleByChannel(out, from, from + rotated  * WeaponRange, ECC_WorldDynamic, fireTraceParams);
+	return rotated;
+}
+
+void UTP_WeaponComponent::GetShotDirections(FVector forward, FPelletDirections& out) {
+	out.Reset();
+
+	if (spreadTable.IsEmpty()) {
+		// No pattern, so ask GetBulletSpread (which might be overridden in BP).
+		TArray<FVector> spreadVectors = GetBulletSpread();
+		for (int i = 0; i < spreadVectors.Num(); i++) {
+			out.Add(GetPelletDirection(forward, spreadVectors[i]));
+		}
+		return;
+	}
+
+	TArrayView<const FVector> variant = spreadTable.GetVariant(nextSpreadVariant);
+	nextSpreadVariant = (nextSpreadVariant + 1) % spreadTable.NumVariants();
+
+	// Same rotation GetPelletDirection does, but worked out once for the whole shot.
+	out.AddUninitialized(variant.Num());
+	FBulletSpreadTable::RotateDirections(forward.Rotation().Quaternion(), variant, out);
+}
+
+void UTP_WeaponComponent::RebuildSpreadTable() {
+	spreadTable.Build(SpreadPattern);
+	nextSpreadVariant = 0;
+}
+
+void UTP_WeaponComponent::UpdateSimulatedProjectileSource() {
+	UWorld* World = GetWorld();
+	UProjectileSimulationSubsystem* simulation = World ? World->GetSubsystem<UProjectileSimulationSubsystem>() : nullptr;
+	if (simulation != nullptr) {
+		simulatedProjectileSource = simulation->UpdateSource(this, SimulatedProjectile, WeaponStats, Character);
+	}
+}
+
+void UTP_WeaponComponent::PreloadAssets() {
+	if (bAssetsLoaded || preloadHandle.IsValid()) {
+		return;
+	}
+
+	TArray<FSoftObjectPath> paths;
+	if (!DefaultFiringDecal.IsNull()) {
+		paths.Add(DefaultFiringDecal.ToSoftObjectPath());
+	}
+	if (!ProjectileClass.IsNull()) {
+		paths.Add(ProjectileClass.ToSoftObjectPath());
+	}
+	if (!FireSound.IsNull()) {
+		paths.Add(FireSound.ToSoftObjectPath());
+	}
+	if (!FireAnimation.IsNull()) {
+		paths.Add(FireAnimation.ToSoftObjectPath());
+	}
+
+	GWeaponPreloadStats.Requested++;
+	preloadStartTime = FPlatformTime::Seconds();
+	if (paths.Num() == 0) {
+		OnAssetsLoaded();
+		return;
+	}
+	preloadHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(paths, FStreamableDelegate::CreateUObject(this, &UTP_WeaponComponent::OnAssetsLoaded), FStreamableManager::AsyncLoadHighPriority);
+}
+
+void UTP_WeaponComponent::OnAssetsLoaded() {
+	// EnsureAssetsLoaded can get here first, and then the streaming callback comes in too.
+	if (bAssetsLoaded) {
+		return;
+	}
+	bAssetsLoaded = true;
+
+	const double ms = (FPlatformTime::Seconds() - preloadStartTime) * 1000.0;
+	GWeaponPreloadStats.Completed++;
+	GWeaponPreloadStats.TotalMs += ms;
+	GWeaponPreloadStats.MaxMs = FMath::Max(GWeaponPreloadStats.MaxMs, ms);
+
+	loadedAssets.Reset();
+	for (UObject* asset : { (UObject*)DefaultFiringDecal.Get(), (UObject*)ProjectileClass.Get(), (UObject*)FireSound.Get(), (UObject*)FireAnimation.Get() }) {
+		if (asset != nullptr) {
+			loadedAssets.Add(asset);
+		}
+	}
+	preloadHandle.Reset();
+
+	// Now that they're in, get the pools ready too, so the first shots don't have to create components or spawn actors.
+	UWorld* World = GetWorld();
+	if (World == nullptr) {
+		return;
+	}
+	if (UMaterialInterface* decal = DefaultFiringDecal.Get()) {
+		if (UImpactDecalSubsystem* decals = World->GetSubsystem<UImpactDecalSubsystem>()) {
+			decals->Prewarm(decal, DecalPrewarmCount);
+		}
+	}
+	if (FireMode == EWeaponFireMode::Projectile && ProjectileClass.Get() != nullptr) {
+		if (UProjectilePoolSubsystem* pool = World->GetSubsystem<UProjectilePoolSubsystem>()) {
+			pool->Prewarm(ProjectileClass.Get(), ProjectilePrewarmCount > 0 ? ProjectilePrewarmCount : pool->DefaultPrewarmCount);
+		}
+	}
+}
+
+void UTP_WeaponComponent::EnsureAssetsLoaded() {
+	if (!bHasFired) {
+		bHasFired = true;
+		if (bAssetsLoaded) {
+			GWeaponPreloadStats.HitchesAvoided++;
+		}
+		else {
+			GWeaponPreloadStats.SyncLoads++;
+		}
+	}
+	if (bAssetsLoaded) {
+		return;
+	}
 
-	if (hit) {
-		UPrimitiveComponent* comp = out.GetComponent();
+	if (preloadHandle.IsValid()) {
+		preloadHandle->WaitUntilComplete();
+	}
+	else {
+		if (preloadStartTime == 0.0) {
+			preloadStartTime = FPlatformTime::Seconds();
+			GWeaponPreloadStats.Requested++;
+		}
+		DefaultFiringDecal.LoadSynchronous();
+		ProjectileClass.LoadSynchronous();
+		FireSound.LoadSynchronous();
+		FireAnimation.LoadSynchronous();
+	}
+	OnAssetsLoaded();
+}
+
+USoundBase* UTP_WeaponComponent::GetFireSound() const {
+	return FireSound.LoadSynchronous();
+}
+
+UAnimMontage* UTP_WeaponComponent::GetFireAnimation() const {
+	return FireAnimation.LoadSynchronous();
+}
+
+UMaterialInterface* UTP_WeaponComponent::GetDefaultFiringDecal() const {
+	return DefaultFiringDecal.LoadSynchronous();
+}
+
+void UTP_WeaponComponent::BeginPlay() {
+	Super::BeginPlay();
+	RebuildSpreadTable();
+	PreloadAssets();
+	if (FireMode == EWeaponFireMode::SimulatedProjectile) {
+		UpdateSimulatedProjectileSource();
+	}
+}
+
+#if WITH_EDITOR
+void UTP_WeaponComponent::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) {
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	RebuildSpreadTable();
+	if (FireMode == EWeaponFireMode::SimulatedProjectile && HasBegunPlay()) {
+		UpdateSimulatedProjectileSource();
+	}
+}
+#endif
+
+bool UTP_WeaponComponent::FireFromTrace(UWorld* World, FVector from, FVector direction, FHitResult& out) {
+	return World->LineTraceSingleByChannel(out, from, from + direction * WeaponRange, ECC_WorldDynamic, fireTraceParams);
+}
+
+void UTP_WeaponComponent::FireProjectile(UWorld* World, FVector from, FVector direction) {
+	FRotator spawnRotation = direction.Rotation();
+	FVector spawnLocation = from + spawnRotation.RotateVector(MuzzleOffset);
+
+	if (UProjectilePoolSubsystem* pool = World->GetSubsystem<UProjectilePoolSubsystem>()) {
+		pool->Acquire(ProjectileClass.Get(), FTransform(spawnRotation, spawnLocation), Character, Character);
+	}
+}
+
+void UTP_WeaponComponent::FireSimulatedProjectiles(UWorld* World, FVector from, TArrayView<const FVector> directions) {
+	UProjectileSimulationSubsystem* simulation = World->GetSubsystem<UProjectileSimulationSubsystem>();
+	if (simulation == nullptr) {
+		return;
+	}
+	if (simulatedProjectileSource == INDEX_NONE) {
+		UpdateSimulatedProjectileSource();
+	}
+
+	for (int i = 0; i < directions.Num(); i++) {
+		// Same spot FireProjectile spawns at.
+		simulation->Launch(simulatedProjectileSource, from + directions[i].Rotation().RotateVector(MuzzleOffset), directions[i]);
+	}
+}
+
+void UTP_WeaponComponent::FireAsyncTraceBatch(UWorld* World, FVector from, TArrayView<const FVector> directions) {
+	if (!asyncTraceDelegate.IsBound()) {
+		asyncTraceDelegate.BindUObject(this, &UTP_WeaponComponent::OnAsyncTraceDone);
+	}
+
+	FPendingTraceBatch& batch = pendingTraceBatches.AddDefaulted_GetRef();
+	batch.id = nextTraceBatchId++;
+	batch.outstanding = directions.Num();
+	batch.latencyShot = firingShot;
+
+	// All of these get kicked off together at the end of the frame, and come back at the start of the next one.
+	for (int i = 0; i < directions.Num(); i++) {
+		World->AsyncLineTraceByChannel(EAsyncTraceType::Single, from, from + directions[i] * WeaponRange, ECC_WorldDynamic, fireTraceParams, FCollisionResponseParams::DefaultResponseParam, &asyncTraceDelegate, batch.id);
+	}
+}
+
+void UTP_WeaponComponent::OnAsyncTraceDone(const FTraceHandle& handle, FTraceDatum& datum) {
+	int32 batchIndex = pendingTraceBatches.IndexOfByPredicate([&datum](const FPendingTraceBatch& batch) { return batch.id == datum.UserData; });
+	if (batchIndex == INDEX_NONE) {
+		return;
+	}
+
+	FPendingTraceBatch& batch = pendingTraceBatches[batchIndex];
+	for (const FHitResult& hit : datum.OutHits) {
+		if (hit.bBlockingHit) {
+			batch.hits.Add(hit);
+		}
+	}
+
+	batch.outstanding--;
+	if (batch.outstanding > 0) {
+		return;
+	}
+
+	// Every pellet is back, so resolve the whole shot in one go.
+	// The batch is moved out first in case resolving a hit ends up firing again.
+	FPendingTraceBatch finished = MoveTemp(batch);
+	pendingTraceBatches.RemoveAtSwap(batchIndex);
+
+	if (AsyncResolveCost == nullptr) {
+		ResolveHits(finished.hits, finished.latencyShot);
+		return;
+	}
+
+	FAllocationCounter::Start();
+	const uint64 startCycles = FPlatformTime::Cycles64();
+	ResolveHits(finished.hits, finished.latencyShot);
+	const uint64 endCycles = FPlatformTime::Cycles64();
+	AsyncResolveCost->Allocations += FAllocationCounter::Stop();
+	AsyncResolveCost->Ms.Add(FPlatformTime::ToMilliseconds64(endCycles - startCycles));
+}
+
+void UTP_WeaponComponent::ResolveHits(TArrayView<const FHitResult> hits, uint32 latencyShot) {
+	UMaterialInterface* decal = DefaultFiringDecal.Get();
+	UImpactDecalSubsystem* decals = GetWorld()->GetSubsystem<UImpactDecalSubsystem>();
+	UFireLatencySubsystem* latency = latencyShot != 0 ? GetWorld()->GetSubsystem<UFireLatencySubsystem>() : nullptr;
+	FShotHitAggregator shotHits;
+
+	if (latency != nullptr) {
+		latency->MarkStage(latencyShot, EFireLatencyStage::Traced);
+	}
+
+	for (const FHitResult& out : hits) {
 		//DrawDebugLine(World, from, out.ImpactPoint, FColor::Red, false, 5.0f);
 		//GEngine->AddOnScreenDebugMessage(-1, 15.0f, FColor::Yellow, FString::Printf(TEXT("%s %s"), *out.GetActor()->GetName(), *out.GetComponent()->GetName()));
 		UPrimitiveComponent* componentHit = out.GetComponent();
 
-		UMaterialInterface* decal = DefaultFiringDecal;
-
-		AActor* currActor = out.GetActor();
-		if (currActor != nullptr) {
-			bool doesImp = currActor->GetClass()->ImplementsInterface(UHitBehaviorInterface::StaticClass());
-			if (doesImp) {
-				IHitBehaviorInterface::Execute_OnHit(currActor, out.ImpactPoint, WeaponStats);
+		// Every pellet still gets its own decal, since they all land in different spots.
+		// Decals are pooled, so this recycles the oldest one once the cap is hit instead of creating a new component.
+		if (decal != nullptr && decals != nullptr) {
+			decals->SpawnDecal(decal, FVector::OneVector * 10.0f, componentHit, out.ImpactPoint, FRotator::ZeroRotator);
+			if (latency != nullptr) {
+				latency->MarkStage(latencyShot, EFireLatencyStage::Decal);
 			}
 		}
 
-		if (decal != nullptr) {
-			
-			UDecalComponent* spawnedDecal = UGameplayStatics::SpawnDecalAttached(DefaultFiringDecal, FVector::OneVector * 10.0f, componentHit, NAME_None, out.ImpactPoint, FRotator::ZeroRotator, EAttachLocation::KeepWorldPosition);
-			if (spawnedDecal != nullptr) {
-				spawnedDecal->SetFadeScreenSize(0.0f);
-				// This only works if the Material has the Decal Lifetime Opacity value.
-				spawnedDecal->SetFadeOut(13.0f, 2.0f, false);
-			}
+		shotHits.AddHit(out, WeaponStats.baseDamage, -out.ImpactNormal * FireForce);
+	}
+
+	// One OnShotHit per actor and one impulse per body, however many pellets hit them.
+	shotHits.Resolve(WeaponStats);
+	if (latency != nullptr && hits.Num() > 0) {
+		latency->MarkStage(latencyShot, EFireLatencyStage::Hit);
+	}
+}
+
+void UTP_WeaponComponent::FireFromView(FVector viewLocation, FVector viewForward) {
+	UWorld* const World = GetWorld();
+	if (World == nullptr) {
+		return;
+	}
+
+	EnsureAssetsLoaded();
+
+	FPelletDirections directions;
+	GetShotDirections(viewForward, directions);
+
+	if (FireMode == EWeaponFireMode::Projectile && ProjectileClass.Get() != nullptr) {
+		for (int i = 0; i < directions.Num(); i++) {
+			FireProjectile(World, viewLocation, directions[i]);
 		}
-		if (comp != nullptr && comp->IsSimulatingPhysics()) {
-			componentHit->AddImpulseAtLocation(-out.ImpactNormal * FireForce, out.ImpactPoint);
+	}
+	else if (FireMode == EWeaponFireMode::SimulatedProjectile) {
+		FireSimulatedProjectiles(World, viewLocation, directions);
+	}
+	else if (bBatchAsyncTraces && directions.Num() > 1) {
+		FireAsyncTraceBatch(World, viewLocation, directions);
+	}
+	else {
+		TArray<FHitResult, TInlineAllocator<32>> hits;
+		for (int i = 0; i < directions.Num(); i++) {
+			FHitResult out;
+			if (FireFromTrace(World, viewLocation, directions[i], out)) {
+				hits.Add(out);
+			}
 		}
+		ResolveHits(hits, firingShot);
 	}
 }
 
 void UTP_WeaponComponent::Fire()
 {
-	if (Character == nullptr || Character->GetController() == nullptr)
+	UWorld* const World = GetWorld();
+	if (World != nullptr)
+	{
+		const double now = World->GetTimeSeconds();
+		FireShots(MakeArrayView(&now, 1));
+	}
+}
+
+void UTP_WeaponComponent::StartFiring()
+{
+	UWorld* const World = GetWorld();
+	if (World == nullptr)
 	{
 		return;
 	}
 
+	// A shot is due straight away, unless the last one was too recent. Tapping can't fire faster than holding.
+	bTriggerHeld = true;
+	nextShotTime = FMath::Max(nextShotTime, World->GetTimeSeconds());
+	SetComponentTickEnabled(true);
+}
+
+void UTP_WeaponComponent::StopFiring()
+{
+	bTriggerHeld = false;
+}
+
+void UTP_WeaponComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (!bTriggerHeld || RoundsPerMinute <= 0.0f) {
+		SetComponentTickEnabled(false);
+		return;
+	}
+
+	// Every shot that came due since last frame, each at the time it was due, so the rate doesn't depend on the frame rate.
+	const double now = GetWorld()->GetTimeSeconds();
+	const double interval = 60.0 / RoundsPerMinute;
+	TArray<double, TInlineAllocator<8>> shotTimes;
+	while (nextShotTime <= now && shotTimes.Num() < FMath::Max(MaxShotsPerFrame, 1)) {
+		shotTimes.Add(nextShotTime);
+		nextShotTime += interval;
+	}
+
+	// After a hitch, the shots that didn't fit are dropped instead of piling up for the next frames.
+	if (nextShotTime <= now) {
+		nextShotTime = now + interval;
+	}
+
+	if (shotTimes.Num() > 0) {
+		FireShots(shotTimes);
+	}
+}
+
+FRotator UTP_WeaponComponent::ApplyRecoil(double shotTime)
+{
+	// Recover towards the center for however long it's been since the last shot, then kick for this one.
+	const float recovery = RecoilRecoverySpeed * FMath::Max(shotTime - lastRecoilTime, 0.0);
+	recoilOffset.Pitch = FMath::FInterpConstantTo(recoilOffset.Pitch, 0.0f, 1.0f, recovery);
+	recoilOffset.Yaw = FMath::FInterpConstantTo(recoilOffset.Yaw, 0.0f, 1.0f, recovery);
+	lastRecoilTime = shotTime;
+
+	const FRotator used = recoilOffset;
+	recoilOffset += RecoilPerShot;
+	return used;
+}
+
+void UTP_WeaponComponent::FireShots(TArrayView<const double> shotTimes)
+{
+	if (Character == nullptr || Character->GetController() == nullptr || shotTimes.Num() == 0)
+	{
+		return;
+	}
+
+	EnsureAssetsLoaded();
+
 	UWorld* const World = GetWorld();
+	UFireLatencySubsystem* latency = World ? World->GetSubsystem<UFireLatencySubsystem>() : nullptr;
+	TArray<uint32, TInlineAllocator<8>> latencyShots;
+
 	if (World != nullptr)
 	{
 		APlayerController* PlayerController = Cast<APlayerController>(Character->GetController());
@@ -78,33 +460,49 @@ void UTP_WeaponComponent::Fire()
 
 		const FVector cameraPos = camera->GetCameraLocation();
 
-		const FVector forward = camera->GetActorForwardVector();
+		const FRotator cameraRotation = camera->GetCameraRotation();
 
-		//Set Spawn Collision Handling Override
-		FActorSpawnParameters ActorSpawnParams;
-		ActorSpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButDontSpawnIfColliding;
+		for (double shotTime : shotTimes)
+		{
+			const uint32 latencyShot = latency ? latency->BeginShot() : 0;
+			if (latency != nullptr)
+			{
+				latency->MarkStage(latencyShot, EFireLatencyStage::Fire);
+				latencyShots.Add(latencyShot);
+			}
 
-		TArray<FVector> spreadVectors = GetBulletSpread();
-		for (int i = 0; i < spreadVectors.Num(); i++) {
-			FVector vector = spreadVectors[i];
-			FireFromTrace(World, cameraPos, forward, vector);
+			// Each shot gets its own spread variant (GetShotDirections moves on to the next one) and the recoil as of when it was due.
+			const FVector forward = (cameraRotation + ApplyRecoil(shotTime)).Vector();
+
+			firingShot = latencyShot;
+			FireFromView(cameraPos, forward);
+			firingShot = 0;
 		}
 	}
 	
+	// The sound and animation only start once per frame, however many shots were in it.
 	// Try and play the sound if specified
-	if (FireSound != nullptr)
+	if (USoundBase* Sound = FireSound.Get())
 	{
-		UGameplayStatics::PlaySoundAtLocation(this, FireSound, Character->GetActorLocation());
+		UGameplayStatics::PlaySoundAtLocation(this, Sound, Character->GetActorLocation());
+		for (uint32 latencyShot : latencyShots)
+		{
+			latency->MarkStage(latencyShot, EFireLatencyStage::Sound);
+		}
 	}
 	
 	// Try and play a firing animation if specified
-	if (FireAnimation != nullptr)
+	if (UAnimMontage* Animation = FireAnimation.Get())
 	{
 		// Get the animation object for the arms mesh
 		UAnimInstance* AnimInstance = Character->GetMesh1P()->GetAnimInstance();
 		if (AnimInstance != nullptr)
 		{
-			AnimInstance->Montage_Play(FireAnimation, 1.f);
+			AnimInstance->Montage_Play(Animation, 1.f);
+			for (uint32 latencyShot : latencyShots)
+			{
+				latency->MarkStage(latencyShot, EFireLatencyStage::Montage);
+			}
 		}
 	}
 }
@@ -126,6 +524,13 @@ void UTP_WeaponComponent::AttachWeapon(AUnrealTestCharacter* TargetCharacter)
 	// switch bHasRifle so the animation blueprint can switch to another animation set
 	Character->SetHasRifle(true);
 
+	// Normally this started back when the weapon was spawned, and the projectiles and decals were made ready once it finished.
+	PreloadAssets();
+	if (FireMode == EWeaponFireMode::SimulatedProjectile) {
+		// The projectiles shouldn't hit whoever is now holding the weapon.
+		UpdateSimulatedProjectileSource();
+	}
+
 	// Set up action bindings
 	if (APlayerController* PlayerController = Cast<APlayerController>(Character->GetController()))
 	{
@@ -138,13 +543,34 @@ void UTP_WeaponComponent::AttachWeapon(AUnrealTestCharacter* TargetCharacter)
 		if (UEnhancedInputComponent* EnhancedInputComponent = Cast<UEnhancedInputComponent>(PlayerController->InputComponent))
 		{
 			// Fire
-			EnhancedInputComponent->BindAction(FireAction, ETriggerEvent::Triggered, this, &UTP_WeaponComponent::Fire);
+			if (RoundsPerMinute > 0.0f)
+			{
+				// Held fire is paced by the weapon's tick, instead of by however often Triggered comes in.
+				EnhancedInputComponent->BindAction(FireAction, ETriggerEvent::Started, this, &UTP_WeaponComponent::StartFiring);
+				EnhancedInputComponent->BindAction(FireAction, ETriggerEvent::Completed, this, &UTP_WeaponComponent::StopFiring);
+				EnhancedInputComponent->BindAction(FireAction, ETriggerEvent::Canceled, this, &UTP_WeaponComponent::StopFiring);
+			}
+			else
+			{
+				EnhancedInputComponent->BindAction(FireAction, ETriggerEvent::Triggered, this, &UTP_WeaponComponent::Fire);
+			}
 		}
+
+		// After the character, which comes after the controller that reads the input, so a press fires on the same frame.
+		PrimaryComponentTick.AddPrerequisite(Character, Character->PrimaryActorTick);
 	}
 }
 
 void UTP_WeaponComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
+	StopFiring();
+
+	if (preloadHandle.IsValid())
+	{
+		preloadHandle->CancelHandle();
+		preloadHandle.Reset();
+	}
+
 	if (Character == nullptr)
 	{
 		return;
@@ -4,10 +4,24 @@
 
 #include "CoreMinimal.h"
 #include "Components/SkeletalMeshComponent.h"
+#include "WorldCollision.h"
+#include "Engine/StreamableManager.h"
+#include "BulletSpread.h"
+#include "SimulatedProjectileSettings.h"
 #include "TP_WeaponComponent.generated.h"
 
 class AUnrealTestCharacter;
 
+UENUM(BlueprintType)
+enum class EWeaponFireMode : uint8 {
+	/** Line traces along every spread vector. */
+	Hitscan,
+	/** Fires ProjectileClass along every spread vector, out of the world's projectile pool. */
+	Projectile,
+	/** Fires SimulatedProjectile along every spread vector. These have no actor, and fly in UProjectileSimulationSubsystem. */
+	SimulatedProjectile
+};
+
 USTRUCT(BlueprintType)
 struct FWeapon {
 	GENERATED_BODY()
@@ -25,7 +39,7 @@ public:
 
 public:
 	UPROPERTY(EditAnywhere, Category = Firing)
-	UMaterialInterface* DefaultFiringDecal;
+	TSoftObjectPtr<UMaterialInterface> DefaultFiringDecal;
 
 	UPROPERTY(EditAnywhere, Category=Firing)
 	float WeaponRange = 10000.0f;
@@ -36,17 +50,69 @@ public:
 	UPROPERTY(EditAnywhere, Category=Firing)
 	FWeapon WeaponStats;
 
+	UPROPERTY(EditAnywhere, Category=Firing)
+	EWeaponFireMode FireMode = EWeaponFireMode::Hitscan;
+
+	/** 
+	* Fire rate while the trigger is held, the same at any frame rate. Every shot due in a frame is fired together.
+	* 0 (the default) fires once every time the fire action triggers instead, as weapons always have; set a rate to opt in.
+	*/
+	UPROPERTY(EditAnywhere, Category=Firing, meta=(ClampMin="0"))
+	float RoundsPerMinute = 0.0f;
+
+	/** Shots past this many in one frame (after a hitch) are dropped. */
+	UPROPERTY(EditAnywhere, Category=Firing, meta=(ClampMin="1"))
+	int32 MaxShotsPerFrame = 8;
+
+	/** How far each shot kicks the aim, in degrees. */
+	UPROPERTY(EditAnywhere, Category=Firing)
+	FRotator RecoilPerShot = FRotator::ZeroRotator;
+
+	/** How fast the aim settles back after recoil, in degrees per second. */
+	UPROPERTY(EditAnywhere, Category=Firing)
+	float RecoilRecoverySpeed = 10.0f;
+
+	/** 
+	* Where the bullets of each shot go. Anything other than Event is precomputed when play starts,
+	* and GetBulletSpread is no longer called.
+	*/
+	UPROPERTY(EditAnywhere, Category=Firing)
+	FBulletSpreadPattern SpreadPattern;
+
+	/** 
+	* Send every pellet of a shot as one async trace batch and resolve all of the hits together next frame.
+	* Shots with a single bullet are always traced synchronously.
+	*/
+	UPROPERTY(EditAnywhere, Category=Firing)
+	bool bBatchAsyncTraces = false;
+
 	/** Projectile class to spawn */
 	UPROPERTY(EditDefaultsOnly, Category=Projectile)
-	TSubclassOf<class AUnrealTestProjectile> ProjectileClass;
+	TSoftClassPtr<class AUnrealTestProjectile> ProjectileClass;
+
+	/** Gun muzzle's offset from the camera */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category=Projectile)
+	FVector MuzzleOffset = FVector(100.0f, 0.0f, 10.0f);
+
+	/** How many decals to have ready with DefaultFiringDecal once it's loaded. */
+	UPROPERTY(EditDefaultsOnly, Category=Firing)
+	int32 DecalPrewarmCount = 16;
+
+	/** How many projectiles to have ready when the weapon is picked up. 0 uses the pool's default. */
+	UPROPERTY(EditDefaultsOnly, Category=Projectile)
+	int32 ProjectilePrewarmCount = 0;
+
+	/** What gets fired in SimulatedProjectile mode. */
+	UPROPERTY(EditAnywhere, Category=Projectile)
+	FSimulatedProjectileSettings SimulatedProjectile;
 
 	/** Sound to play each time we fire */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Gameplay)
-	USoundBase* FireSound;
+	TSoftObjectPtr<USoundBase> FireSound;
 	
 	/** AnimMontage to play each time we fire */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay)
-	UAnimMontage* FireAnimation;
+	TSoftObjectPtr<UAnimMontage> FireAnimation;
 
 	/** MappingContext */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Input, meta=(AllowPrivateAccess = "true"))
@@ -68,6 +134,22 @@ public:
 	UFUNCTION(BlueprintCallable, Category="Weapon")
 	void Fire();
 
+	/** Fires one shot per entry in shotTimes (world times, oldest first), with a single sound and animation for all of them. */
+	void FireShots(TArrayView<const double> shotTimes);
+
+	/** Holds the trigger down. Shots are fired at RoundsPerMinute until StopFiring. */
+	void StartFiring();
+
+	void StopFiring();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/** 
+	* Fires one shot from viewLocation towards viewForward, without any sound or animation.
+	* Fire calls this with the camera's view. It doesn't need a Character, so benchmarks can call it directly.
+	*/
+	void FireFromView(FVector viewLocation, FVector viewForward);
+
 	/** 
 	* Get new forward vectors for where bullets should be firing to.
 	* @return A list of forwards (where 1,0,0 is the default forward) to fire towards.
@@ -77,16 +159,132 @@ public:
 
 	TArray<FVector> GetBulletSpread_Implementation() { auto arr = TArray<FVector>(); arr.Add(FVector::ForwardVector); return arr; }
 
+	/** 
+	* Starts streaming in the fire sound, animation, decal and projectile class, and gets their pools ready once they're in.
+	* This happens on its own when play starts, so they're in well before the weapon is picked up and fired.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Weapon")
+	void PreloadAssets();
+
+	/** Whether everything firing needs is loaded, so the first shot won't hitch. */
+	UFUNCTION(BlueprintCallable, Category = "Weapon")
+	bool AreAssetsReady() const { return bAssetsLoaded; }
+
+	/** FireSound itself, for Blueprints that used to read the property. Loads it on the spot if it hasn't streamed in yet. */
+	UFUNCTION(BlueprintPure, Category = "Gameplay")
+	USoundBase* GetFireSound() const;
+
+	/** FireAnimation itself, for Blueprints that used to read the property. Loads it on the spot if it hasn't streamed in yet. */
+	UFUNCTION(BlueprintPure, Category = "Gameplay")
+	UAnimMontage* GetFireAnimation() const;
+
+	/** DefaultFiringDecal itself, for Blueprints that used to read the property. Loads it on the spot if it hasn't streamed in yet. */
+	UFUNCTION(BlueprintPure, Category = "Firing")
+	UMaterialInterface* GetDefaultFiringDecal() const;
+
+	/** Recomputes the spread directions from SpreadPattern. Call this after changing SpreadPattern at runtime. */
+	UFUNCTION(BlueprintCallable, Category = "Firing")
+	void RebuildSpreadTable();
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
 protected:
+	virtual void BeginPlay() override;
+
 	/** Ends gameplay for this component. */
 	UFUNCTION()
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
-	void FireFromTrace(UWorld* World, FVector from, FVector forward, FVector newForward);
+	/** Enough room for a shotgun blast without touching the heap. */
+	using FPelletDirections = TArray<FVector, TInlineAllocator<32>>;
+
+	/** Gets the world space direction of every bullet in the next shot. */
+	void GetShotDirections(FVector forward, FPelletDirections& out);
+
+	/** Traces a single bullet. Returns true if it hit something. */
+	bool FireFromTrace(UWorld* World, FVector from, FVector direction, FHitResult& out);
+
+	void FireProjectile(UWorld* World, FVector from, FVector direction);
+
+	/** Hands every pellet of the shot to the projectile simulation. */
+	void FireSimulatedProjectiles(UWorld* World, FVector from, TArrayView<const FVector> directions);
+
+	/** Queues one async line trace per direction. The hits are resolved in OnAsyncTraceDone once the whole batch is back. */
+	void FireAsyncTraceBatch(UWorld* World, FVector from, TArrayView<const FVector> directions);
+
+	/** Places decals for every hit in a shot, then applies the shot's damage and impulses once per actor and body. */
+	void ResolveHits(TArrayView<const FHitResult> hits, uint32 latencyShot);
+
+	/** Returns the recoil offset for a shot fired at shotTime, and adds that shot's kick. */
+	FRotator ApplyRecoil(double shotTime);
+
+	/** Takes a spread vector (where 1,0,0 is forward) and puts it in terms of the actual forward vector. */
+	static FVector GetPelletDirection(FVector forward, FVector newForward);
+
+public:
+	/** What resolving shots cost after their async traces came back, separately from Fire since it happens a frame later. */
+	struct FAsyncResolveCost {
+		TArray<double> Ms;
+		uint64 Allocations = 0;
+	};
+
+	/** Set (by AHitscanBenchmark) to have every async resolve timed into it. */
+	FAsyncResolveCost* AsyncResolveCost = nullptr;
 
 private:
+	void OnAsyncTraceDone(const FTraceHandle& handle, FTraceDatum& datum);
+
+	void OnAssetsLoaded();
+
+	/** Loads whatever hasn't finished streaming in yet, right now. This is the hitch PreloadAssets is there to avoid. */
+	void EnsureAssetsLoaded();
+
+	/** Gives the projectile simulation this weapon's current settings. */
+	void UpdateSimulatedProjectileSource();
+
 	/** The Character holding this weapon*/
 	AUnrealTestCharacter* Character;
 
 	FCollisionQueryParams fireTraceParams;
+
+	FBulletSpreadTable spreadTable;
+	int32 nextSpreadVariant = 0;
+
+	TSharedPtr<FStreamableHandle> preloadHandle;
+	double preloadStartTime = 0.0;
+	bool bAssetsLoaded = false;
+	bool bHasFired = false;
+
+	/** Keeps the soft referenced assets loaded for as long as the weapon is around. */
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UObject>> loadedAssets;
+
+	bool bTriggerHeld = false;
+
+	/** World time the next held shot is due. */
+	double nextShotTime = 0.0;
+
+	FRotator recoilOffset = FRotator::ZeroRotator;
+	double lastRecoilTime = 0.0;
+
+	/** The shot Fire is in the middle of, for UFireLatencySubsystem. 0 when FireFromView is called on its own. */
+	uint32 firingShot = 0;
+
+	/** This weapon's source in UProjectileSimulationSubsystem. */
+	int32 simulatedProjectileSource = INDEX_NONE;
+
+	/** A shot whose pellets are still being traced asynchronously. */
+	struct FPendingTraceBatch {
+		uint32 id;
+		int32 outstanding;
+		/** The shot's id in UFireLatencySubsystem. */
+		uint32 latencyShot;
+		TArray<FHitResult, TInlineAllocator<16>> hits;
+	};
+
+	TArray<FPendingTraceBatch> pendingTraceBatches;
+	uint32 nextTraceBatchId = 0;
+	FTraceDelegate asyncTraceDelegate;
 };
\ No newline at end of file
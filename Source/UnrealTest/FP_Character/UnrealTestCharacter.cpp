@@ -9,6 +9,39 @@
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
 #include "UnrealTest/Movement/CharacterGravityComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<bool> CVarCoalesceInput(
+	TEXT("ut.Input.Coalesce"),
+	true,
+	TEXT("Sum Move and Look input over the frame and apply it once, before movement ticks, instead of on every input event."));
+
+static FAutoConsoleCommandWithWorld GDumpInputCoalescingStats(
+	TEXT("ut.Input.Stats"),
+	TEXT("Prints how many camera and child transform updates the local player's input coalescing has saved."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		APlayerController* controller = World ? World->GetFirstPlayerController() : nullptr;
+		if (AUnrealTestCharacter* character = controller ? Cast<AUnrealTestCharacter>(controller->GetPawn()) : nullptr) {
+			const FInputCoalescingStats& stats = character->GetInputCoalescingStats();
+			UE_LOG(LogTemp, Display, TEXT("Input coalescing: %d move and %d look events, %d camera updates, %d camera and %d child transform updates saved"),
+				stats.MoveEvents, stats.LookEvents, stats.CameraUpdates, stats.CameraUpdatesSaved, stats.ChildUpdatesSaved);
+		}
+	})
+);
+
+namespace {
+	/** Everything that moves along with component. */
+	int32 CountAttachedDescendants(const USceneComponent* component) {
+		int32 count = 0;
+		for (const USceneComponent* child : component->GetAttachChildren()) {
+			if (child != nullptr) {
+				count += 1 + CountAttachedDescendants(child);
+			}
+		}
+		return count;
+	}
+}
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -52,6 +85,14 @@ void AUnrealTestCharacter::BeginPlay()
 		}
 	}
 
+	// Input is handled in the controller's tick, which comes before ours. This makes sure ours comes before movement's, so the coalesced input lands this frame.
+	GetCharacterMovement()->PrimaryComponentTick.AddPrerequisite(this, PrimaryActorTick);
+}
+
+void AUnrealTestCharacter::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+	ApplyCoalescedInput();
 }
 
 //////////////////////////////////////////////////////////////////////////// Input
@@ -81,14 +122,9 @@ void AUnrealTestCharacter::Slide(const FInputActionValue& Value)
 	bool isSliding = Value.Get<bool>();
 	UCharacterGravityComponent* comp = Cast<UCharacterGravityComponent>(GetMovementComponent());
 	if (comp) {
-		if (isSliding) {
-			comp->SetMovementMode(EMovementMode::MOVE_Custom, 0);
-			comp->GravityShift(FVector::BackwardVector * 9.8f);
-		}
-		else {
-			comp->GravityShift(FVector::DownVector * 9.8f);
-			comp->SetMovementMode(EMovementMode::MOVE_Walking);
-		}
+		// Both go to the server with the next move: the shift as a shift event, the mode switch in its compressed flags.
+		comp->RequestGravityMovement(isSliding);
+		comp->GravityShift((isSliding ? FVector::BackwardVector : FVector::DownVector) * 9.8f);
 	}
 }
 
@@ -97,6 +133,53 @@ void AUnrealTestCharacter::Move(const FInputActionValue& Value)
 	// input is a Vector2D
 	FVector2D MovementVector = Value.Get<FVector2D>();
 
+	if (!CVarCoalesceInput.GetValueOnGameThread()) {
+		ApplyMove(MovementVector);
+		return;
+	}
+	pendingMove += MovementVector;
+	pendingMoveEvents++;
+}
+
+void AUnrealTestCharacter::Look(const FInputActionValue& Value)
+{
+	// input is a Vector2D
+	FVector2D LookAxisVector = Value.Get<FVector2D>();
+
+	if (!CVarCoalesceInput.GetValueOnGameThread()) {
+		ApplyLook(LookAxisVector);
+		return;
+	}
+	pendingLook += LookAxisVector;
+	pendingLookEvents++;
+}
+
+void AUnrealTestCharacter::ApplyCoalescedInput()
+{
+	if (pendingMoveEvents > 0) {
+		ApplyMove(pendingMove);
+		inputCoalescingStats.MoveEvents += pendingMoveEvents;
+	}
+
+	if (pendingLookEvents > 0) {
+		ApplyLook(pendingLook);
+		inputCoalescingStats.LookEvents += pendingLookEvents;
+		inputCoalescingStats.CameraUpdates++;
+
+		// Every event used to move the camera twice (once to add the rotation, once to clamp it), and everything under it each time.
+		const int32 saved = pendingLookEvents * 2 - 1;
+		inputCoalescingStats.CameraUpdatesSaved += saved;
+		inputCoalescingStats.ChildUpdatesSaved += saved * CountAttachedDescendants(FirstPersonCameraComponent);
+	}
+
+	pendingMove = FVector2D::ZeroVector;
+	pendingLook = FVector2D::ZeroVector;
+	pendingMoveEvents = 0;
+	pendingLookEvents = 0;
+}
+
+void AUnrealTestCharacter::ApplyMove(FVector2D MovementVector)
+{
 	if (Controller != nullptr)
 	{
 		// add movement 
@@ -105,16 +188,13 @@ void AUnrealTestCharacter::Move(const FInputActionValue& Value)
 	}
 }
 
-void AUnrealTestCharacter::Look(const FInputActionValue& Value)
+void AUnrealTestCharacter::ApplyLook(FVector2D LookAxisVector)
 {
-	// input is a Vector2D
-	FVector2D LookAxisVector = Value.Get<FVector2D>();
-
 	if (Controller != nullptr)
 	{
-		// add yaw and pitch input to controller
-		FirstPersonCameraComponent->AddLocalRotation(FRotator(-LookAxisVector.Y, LookAxisVector.X, 0));
-		FRotator cameraRot = FirstPersonCameraComponent->GetRelativeRotation();
+		// add yaw and pitch input to the camera's local rotation. Worked out here rather than with AddLocalRotation, so the camera only moves once.
+		const FQuat localRotation = FirstPersonCameraComponent->GetRelativeRotation().Quaternion() * FRotator(-LookAxisVector.Y, LookAxisVector.X, 0).Quaternion();
+		FRotator cameraRot = localRotation.Rotator();
 		if (FMath::Abs(cameraRot.Pitch) > 85) {
 			cameraRot.Pitch = FMath::Lerp(FMath::Sign(cameraRot.Pitch) * 85, cameraRot.Pitch, 0.1f);
 		}
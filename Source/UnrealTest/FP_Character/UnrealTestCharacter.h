@@ -13,6 +13,19 @@ class USceneComponent;
 class UCameraComponent;
 class UAnimMontage;
 class USoundBase;
+class UInputAction;
+
+/** How much per-frame input coalescing has saved, since the character spawned. */
+struct FInputCoalescingStats {
+	int32 MoveEvents = 0;
+	int32 LookEvents = 0;
+	/** Frames the camera was actually rotated. */
+	int32 CameraUpdates = 0;
+	/** Camera transform updates that would have been propagated without coalescing, but weren't. */
+	int32 CameraUpdatesSaved = 0;
+	/** The same, counted for every component attached under the camera (the arms, the weapon...). */
+	int32 ChildUpdatesSaved = 0;
+};
 
 UCLASS(config=Game)
 class AUnrealTestCharacter : public ACharacter
@@ -64,6 +77,10 @@ public:
 	UFUNCTION(BlueprintCallable, Category = Weapon)
 	bool GetHasRifle();
 
+	virtual void Tick(float DeltaSeconds) override;
+
+	const FInputCoalescingStats& GetInputCoalescingStats() const { return inputCoalescingStats; }
+
 protected:
 	virtual void BeginPlay();
 
@@ -75,6 +92,12 @@ protected:
 
 	void Slide(const FInputActionValue& Value);
 
+	/** Applies the Move and Look input summed up since last frame: one movement input, and one clamped camera rotation. */
+	void ApplyCoalescedInput();
+
+	void ApplyMove(FVector2D MovementVector);
+	void ApplyLook(FVector2D LookAxisVector);
+
 protected:
 	// APawn interface
 	virtual void SetupPlayerInputComponent(UInputComponent* InputComponent) override;
@@ -85,7 +108,19 @@ public:
 	USkeletalMeshComponent* GetMesh1P() const { return Mesh1P; }
 	/** Returns FirstPersonCameraComponent subobject **/
 	UCameraComponent* GetFirstPersonCameraComponent() const { return FirstPersonCameraComponent; }
-
+	/** Input actions, for recording and replaying input **/
+	UInputAction* GetJumpAction() const { return JumpAction; }
+	UInputAction* GetMoveAction() const { return MoveAction; }
+	UInputAction* GetSlideAction() const { return SlideAction; }
+
+private:
+	/** Move and Look input from this frame's Triggered events, waiting for Tick. */
+	FVector2D pendingMove = FVector2D::ZeroVector;
+	FVector2D pendingLook = FVector2D::ZeroVector;
+	int32 pendingMoveEvents = 0;
+	int32 pendingLookEvents = 0;
+
+	FInputCoalescingStats inputCoalescingStats;
 
 };
 
@@ -3,6 +3,8 @@
 #include "UnrealTestProjectile.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "Components/SphereComponent.h"
+#include "ProjectilePoolSubsystem.h"
+#include "TimerManager.h"
 
 AUnrealTestProjectile::AUnrealTestProjectile() 
 {
@@ -38,6 +40,59 @@ void AUnrealTestProjectile::OnHit(UPrimitiveComponent* HitComp, AActor* OtherAct
 	{
 		OtherComp->AddImpulseAtLocation(GetVelocity() * 100.0f, GetActorLocation());
 
+		ReturnToPool();
+	}
+}
+
+void AUnrealTestProjectile::ReturnToPool()
+{
+	UProjectilePoolSubsystem* Pool = GetWorld() ? GetWorld()->GetSubsystem<UProjectilePoolSubsystem>() : nullptr;
+	if (bPooled && Pool != nullptr)
+	{
+		Pool->Release(this);
+	}
+	else
+	{
 		Destroy();
 	}
+}
+
+void AUnrealTestProjectile::ActivateFromPool(const FTransform& Transform)
+{
+	bInPool = false;
+
+	SetActorTransform(Transform, false, nullptr, ETeleportType::ResetPhysics);
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+	SetActorTickEnabled(true);
+
+	// Start the movement over, as if the projectile had just been spawned here.
+	ProjectileMovement->SetUpdatedComponent(CollisionComp);
+	ProjectileMovement->ClearPendingForce(true);
+	ProjectileMovement->Velocity = GetActorForwardVector() * ProjectileMovement->InitialSpeed;
+	ProjectileMovement->UpdateComponentVelocity();
+	ProjectileMovement->Activate(true);
+
+	const float LifeSpan = GetClass()->GetDefaultObject<AActor>()->InitialLifeSpan;
+	if (LifeSpan > 0.f)
+	{
+		GetWorldTimerManager().SetTimer(PoolLifeSpanTimer, this, &AUnrealTestProjectile::ReturnToPool, LifeSpan, false);
+	}
+}
+
+void AUnrealTestProjectile::DeactivateForPool()
+{
+	bPooled = true;
+	bInPool = true;
+
+	// The pool takes care of the lifetime from here on out.
+	SetLifeSpan(0.f);
+	GetWorldTimerManager().ClearTimer(PoolLifeSpanTimer);
+
+	ProjectileMovement->StopMovementImmediately();
+	ProjectileMovement->Deactivate();
+
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+	SetActorTickEnabled(false);
 }
\ No newline at end of file
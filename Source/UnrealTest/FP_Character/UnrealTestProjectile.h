@@ -29,9 +29,29 @@ public:
 	UFUNCTION()
 	void OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
 
+	/** Puts the projectile back in its pool, or destroys it if it didn't come from one. */
+	void ReturnToPool();
+
+	/** Moves the projectile to transform and launches it along its forward vector, with fresh movement and collision state. */
+	void ActivateFromPool(const FTransform& transform);
+
+	/** Hides the projectile and turns off its movement, collision and ticking until it's fired again. */
+	void DeactivateForPool();
+
+	bool IsInPool() const { return bInPool; }
+
 	/** Returns CollisionComp subobject **/
 	USphereComponent* GetCollisionComp() const { return CollisionComp; }
 	/** Returns ProjectileMovement subobject **/
 	UProjectileMovementComponent* GetProjectileMovement() const { return ProjectileMovement; }
+
+private:
+	/** Set once a pool owns this projectile. Pooled projectiles are released instead of destroyed. */
+	bool bPooled = false;
+
+	bool bInPool = false;
+
+	/** Stands in for InitialLifeSpan while pooled, since an actor's life span destroys it. */
+	FTimerHandle PoolLifeSpanTimer;
 };
 
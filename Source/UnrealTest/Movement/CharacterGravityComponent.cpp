@@ -6,13 +6,40 @@
 #include "GameFramework/Character.h"
 #include "GameFramework/PhysicsVolume.h"
 #include "Components/CapsuleComponent.h"
-
-enum GravityMovementMode {
-	// Read my lips: no Bill Cipher jokes.
-	CUSTOM_GRAVITY_FALL, UMETA(DisplayName="Custom Gravity Falling")
-	CUSTOM_GRAVITY_WALK, UMETA(DisplayName = "Custom Gravity Walking")
-	CUSTOM_GRAVITY_JUMP, UMETA(DisplayName="Custom Gravity Jumping")
-};
+#include "GravityMovementSubsystem.h"
+#include "GravityMovementStats.h"
+#include "HAL/IConsoleManager.h"
+#include "Engine/Engine.h"
+
+UE_TRACE_CHANNEL_DEFINE(GravityMovementChannel);
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fall Iterations"), STAT_GravityFallIterations, STATGROUP_GravityMovement);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sweeps"), STAT_GravitySweeps, STATGROUP_GravityMovement);
+DECLARE_DWORD_COUNTER_STAT(TEXT("StepUps"), STAT_GravityStepUps, STATGROUP_GravityMovement);
+DECLARE_DWORD_COUNTER_STAT(TEXT("StepUp Failures"), STAT_GravityStepUpFailures, STATGROUP_GravityMovement);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Penetrations"), STAT_GravityPenetrations, STATGROUP_GravityMovement);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Walk To Fall"), STAT_GravityWalkToFall, STATGROUP_GravityMovement);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Fall To Walk"), STAT_GravityFallToWalk, STATGROUP_GravityMovement);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sleeping Walk Ticks"), STAT_GravitySleepingTicks, STATGROUP_GravityMovement);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Ballistic Fall Ticks"), STAT_GravityBallisticTicks, STATGROUP_GravityMovement);
+DECLARE_CYCLE_STAT(TEXT("Tick"), STAT_GravityTick, STATGROUP_GravityMovement);
+DECLARE_CYCLE_STAT(TEXT("Walk"), STAT_GravityWalk, STATGROUP_GravityMovement);
+DECLARE_CYCLE_STAT(TEXT("Fall"), STAT_GravityFall, STATGROUP_GravityMovement);
+
+// Bumps this component's running total and the frame's stat counter together.
+#define COUNT_GRAVITY_MOVEMENT(Field, Stat) do { counters.Field++; INC_DWORD_STAT(Stat); } while (0)
+
+static TAutoConsoleVariable<bool> CVarBallisticFall(
+	TEXT("ut.Movement.BallisticFall"),
+	true,
+	TEXT("Let falling gravity characters move along arcs checked ahead of time instead of sweeping every substep."));
+
+#if !UE_BUILD_SHIPPING
+static TAutoConsoleVariable<bool> CVarGravityDebugOverlay(
+	TEXT("ut.Movement.DebugOverlay"),
+	false,
+	TEXT("Show each gravity character's movement mode, gravity and what its movement did this frame on screen."));
+#endif
 
 UCharacterGravityComponent::UCharacterGravityComponent() {
 	// So we can do our own gravity:
@@ -24,6 +51,9 @@ UCharacterGravityComponent::UCharacterGravityComponent() {
 	bAutoRegister = true;
 	bWantsInitializeComponent = true;
 	bAutoActivate = true;
+
+	SetNetworkMoveDataContainer(moveDataContainer);
+	SetMoveResponseDataContainer(moveResponseContainer);
 }
 
 FRotator UCharacterGravityComponent::GetRotatorFromGravity(FVector grav) {
@@ -64,6 +94,19 @@ FRotator UCharacterGravityComponent::GetRotatorFromGravity(FVector grav) {
 }
 
 void UCharacterGravityComponent::GravityShift(FVector newGravity) {
+	// Rounded to what gets sent, so the client and server simulate exactly the same gravity.
+	ApplyGravityShiftEvent(gravityShiftId + 1, FQuantizedGravity::Quantize(newGravity).Dequantize());
+}
+
+void UCharacterGravityComponent::ApplyGravityShiftEvent(uint8 shiftId, FVector newGravity) {
+	gravityShiftId = shiftId;
+	shiftedGravity = newGravity;
+	if (!bInGravityField) {
+		ApplyGravity(newGravity);
+	}
+}
+
+void UCharacterGravityComponent::ApplyGravity(FVector newGravity) {
 	previousGravity = internalGravity;
 	internalGravity = newGravity;
 
@@ -71,16 +114,34 @@ void UCharacterGravityComponent::GravityShift(FVector newGravity) {
 	previousRotation = GetActorTransform().Rotator();
 
 	gravityRotationCompletion = 0.0f;
+	// Anything prepared was rotating towards the old gravity.
+	prepared.bHasRotation = false;
+	// And "down" isn't where the floor was any more.
+	InvalidateFloorCache();
+	ballisticArc.bValid = false;
 }
 
-bool UCharacterGravityComponent::RotateTowardsGravity(float DeltaTime, FRotator& out) {
-	if (gravityRotationCompletion < 1) {
-		gravityRotationCompletion += DeltaTime * GravityRotationRate;
-		if (gravityRotationCompletion >= 1) {
-			gravityRotationCompletion = 1;
+void UCharacterGravityComponent::RetargetGravity(FVector newGravity) {
+	internalGravity = newGravity;
+	gravityRotation = GetRotatorFromGravity(newGravity);
+	prepared.bHasRotation = false;
+
+	// Already done rotating, so the turn is made in one step: the next advance lands right on the new rotation.
+	// The floor cache and ballistic arc check gravity themselves, so they only go if this turn was big enough to change it.
+	if (gravityRotationCompletion >= 1.0f) {
+		previousRotation = GetActorTransform().Rotator();
+		gravityRotationCompletion = 1.0f - UE_KINDA_SMALL_NUMBER;
+	}
+}
+
+bool UCharacterGravityComponent::AdvanceGravityRotation(float DeltaTime, float& completion, FRotator& out) const {
+	if (completion < 1) {
+		completion += DeltaTime * GravityRotationRate;
+		if (completion >= 1) {
+			completion = 1;
 		}
 
-		out = (1 - gravityRotationCompletion) * previousRotation + gravityRotation * gravityRotationCompletion;
+		out = (1 - completion) * previousRotation + gravityRotation * completion;
 		out.Normalize();
 		return true;
 	}
@@ -89,28 +150,202 @@ bool UCharacterGravityComponent::RotateTowardsGravity(float DeltaTime, FRotator&
 	}
 }
 
+bool UCharacterGravityComponent::RotateTowardsGravity(float DeltaTime, FRotator& out) {
+	if (prepared.bHasRotation && IsPrepared(DeltaTime)) {
+		prepared.bHasRotation = false;
+		if (prepared.bRotating) {
+			gravityRotationCompletion = prepared.rotationCompletion;
+			out = prepared.rotation;
+		}
+		return prepared.bRotating;
+	}
+	return AdvanceGravityRotation(DeltaTime, gravityRotationCompletion, out);
+}
+
+bool UCharacterGravityComponent::IsPrepared(float DeltaTime) const {
+	return prepared.frame == GFrameCounter && prepared.deltaTime == DeltaTime;
+}
+
+bool UCharacterGravityComponent::CanPrepareMovement() const {
+	// Components on a tick interval get a different DeltaTime than the world's, so they work everything out as they tick.
+	if (UpdatedComponent == nullptr || !IsComponentTickEnabled() || PrimaryComponentTick.TickInterval > 0.0f) {
+		return false;
+	}
+
+	// Servers move clients' characters when their moves arrive, not on the tick, and a client with a correction to replay starts from a different state.
+	if (IsServerForRemoteClient()) {
+		return false;
+	}
+	return ClientPredictionData == nullptr || !ClientPredictionData->bUpdatePosition;
+}
+
+bool UCharacterGravityComponent::IsServerForRemoteClient() const {
+	return CharacterOwner != nullptr && CharacterOwner->GetLocalRole() == ROLE_Authority && CharacterOwner->GetRemoteRole() == ROLE_AutonomousProxy && !CharacterOwner->IsLocallyControlled();
+}
+
+FVector UCharacterGravityComponent::FallVelocity(const FVector& initialVelocity, const FVector& gravity, float deltaTime, float terminalVelocity) {
+	// Same as UCharacterMovementComponent::NewFallVelocity.
+	FVector result = initialVelocity;
+	if (deltaTime > 0.0f) {
+		result += gravity * deltaTime;
+		const float terminalLimit = FMath::Abs(terminalVelocity);
+		if (result.SizeSquared() > FMath::Square(terminalLimit)) {
+			const FVector gravityDirection = gravity.GetSafeNormal();
+			if ((result | gravityDirection) > terminalLimit) {
+				result = FVector::PointPlaneProject(result, FVector::ZeroVector, gravityDirection) + gravityDirection * terminalLimit;
+			}
+		}
+	}
+	return result;
+}
+
+void UCharacterGravityComponent::PrepareMovement(float DeltaTime, float terminalVelocity) {
+	const uint64 startCycles = FPlatformTime::Cycles64();
+
+	prepared = FPreparedGravityMovement();
+	prepared.frame = GFrameCounter;
+	prepared.deltaTime = DeltaTime;
+
+	UpdateGravityFromField();
+	prepared.bFieldSampled = true;
+
+	// Done after the field, since a change of gravity restarts the rotation.
+	prepared.rotationCompletion = gravityRotationCompletion;
+	prepared.bRotating = AdvanceGravityRotation(DeltaTime, prepared.rotationCompletion, prepared.rotation);
+	prepared.bHasRotation = true;
+
+	if (MovementMode == EMovementMode::MOVE_Custom && CustomMovementMode == CUSTOM_GRAVITY_FALL) {
+		// The first substep can't be the last iteration, so this never takes the branch of GetSimulationTimeStep that isn't thread safe.
+		prepared.fallTimeTick = GetSimulationTimeStep(DeltaTime, 1);
+		prepared.fallStartVelocity = Velocity;
+		prepared.fallGravity = internalGravity;
+		prepared.fallTerminalVelocity = terminalVelocity;
+		prepared.fallVelocity = FallVelocity(Velocity, internalGravity * 100.0f, prepared.fallTimeTick, terminalVelocity);
+		prepared.fallDelta = 0.5f * (Velocity + prepared.fallVelocity) * prepared.fallTimeTick;
+		prepared.bHasFall = true;
+	}
+
+	// Counted as CPU time, wherever it ran.
+	counters.Seconds += FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - startCycles);
+}
+
+bool UCharacterGravityComponent::UsePreparedFall(float timeTick, FVector& outDelta) {
+	if (!prepared.bHasFall || prepared.frame != GFrameCounter) {
+		return false;
+	}
+	prepared.bHasFall = false;
+
+	// Anything that's touched velocity or gravity since (forces, impulses, a gravity shift, a new physics volume) means it has to be redone.
+	if (timeTick != prepared.fallTimeTick || Velocity != prepared.fallStartVelocity || internalGravity != prepared.fallGravity
+		|| GetPhysicsVolume()->TerminalVelocity != prepared.fallTerminalVelocity) {
+		return false;
+	}
+
+	Velocity = prepared.fallVelocity;
+	outDelta = prepared.fallDelta;
+	return true;
+}
+
 void UCharacterGravityComponent::OnMovementModeChanged(EMovementMode PreviousMovementMode, uint8 PreviousCustomMode) {
 	Super::OnMovementModeChanged(PreviousMovementMode, PreviousCustomMode);
+	InvalidateFloorCache();
+
+	if (PreviousMovementMode != EMovementMode::MOVE_Custom || MovementMode != EMovementMode::MOVE_Custom) {
+		return;
+	}
+	if (PreviousCustomMode == CUSTOM_GRAVITY_WALK && CustomMovementMode == CUSTOM_GRAVITY_FALL) {
+		COUNT_GRAVITY_MOVEMENT(WalkToFall, STAT_GravityWalkToFall);
+	}
+	else if (PreviousCustomMode == CUSTOM_GRAVITY_FALL && CustomMovementMode == CUSTOM_GRAVITY_WALK) {
+		COUNT_GRAVITY_MOVEMENT(FallToWalk, STAT_GravityFallToWalk);
+	}
+}
+
+bool UCharacterGravityComponent::CanSleepOnFloor(FRotator newRotation) const {
+	if (!floorCache.bValid) {
+		return false;
+	}
+
+	// Anything that would get the character moving: input, leftover velocity (which covers impulses and forces, since they're applied before this), root motion or turning.
+	if (!Acceleration.IsNearlyZero() || !Velocity.IsNearlyZero() || HasAnimRootMotion() || CurrentRootMotion.HasActiveRootMotionSources() || gravityRotationCompletion < 1.0f) {
+		return false;
+	}
+
+	// Anything that's moved since the floor was found: the character (teleports, corrections), gravity, or the floor itself.
+	const UPrimitiveComponent* floor = floorCache.floor.Get();
+	if (floor == nullptr || !floor->GetComponentTransform().Equals(floorCache.floorTransform)) {
+		return false;
+	}
+	if (!UpdatedComponent->GetComponentLocation().Equals(floorCache.location) || !UpdatedComponent->GetComponentQuat().Equals(floorCache.rotation) || !newRotation.Quaternion().Equals(floorCache.rotation)) {
+		return false;
+	}
+	return internalGravity.Equals(floorCache.gravity);
+}
+
+bool UCharacterGravityComponent::FindFloorAlongGravity(FHitResult& out) {
+	const FVector down = internalGravity.GetSafeNormal();
+	if (down.IsNearlyZero() || UpdatedPrimitive == nullptr) {
+		return false;
+	}
+
+	FCollisionQueryParams params(SCENE_QUERY_STAT(GravityFloorProbe), false, CharacterOwner);
+	FCollisionResponseParams responseParams;
+	InitCollisionParams(params, responseParams);
+
+	// Shrunk a touch, so that standing right on the floor doesn't count as starting inside it.
+	const FVector start = UpdatedComponent->GetComponentLocation();
+	COUNT_GRAVITY_MOVEMENT(Sweeps, STAT_GravitySweeps);
+	const bool bHit = GetWorld()->SweepSingleByChannel(out, start, start + down * FloorProbeDistance, UpdatedComponent->GetComponentQuat(), UpdatedComponent->GetCollisionObjectType(), UpdatedPrimitive->GetCollisionShape(-1.0f), params, responseParams);
+
+	// Same test CustomGravityFall uses to decide it's landed.
+	return bHit && !out.bStartPenetrating && out.GetComponent() != nullptr && out.Normal.Dot(-down) > 0.5;
 }
 
 void UCharacterGravityComponent::CustomGravityWalk(float DeltaTime, FRotator newRotation) {
+	SCOPE_CYCLE_COUNTER(STAT_GravityWalk);
+	GRAVITY_MOVEMENT_SCOPE(CustomGravityWalk);
+
+	if (CanSleepOnFloor(newRotation)) {
+		COUNT_GRAVITY_MOVEMENT(SleepingTicks, STAT_GravitySleepingTicks);
+		Velocity = FVector::ZeroVector;
+		return;
+	}
+	InvalidateFloorCache();
+
 	CalcVelocity(DeltaTime, GroundFriction, false, BrakingDecelerationWalking);
 	FVector delta = (Velocity)*DeltaTime;
 	FVector RampVector = FVector(delta);
 	FHitResult Hit(1.f);
 	SafeMoveUpdatedComponent(delta, newRotation, true, Hit);
 	if (!Hit.IsValidBlockingHit()) {
+		// A character that's come to a stop doesn't push into the floor, so its move won't hit anything. Look for the floor before deciding it's falling,
+		// and remember it so the next ticks don't have to sweep at all.
+		FHitResult floorHit;
+		if (Velocity.IsNearlyZero() && Acceleration.IsNearlyZero() && FindFloorAlongGravity(floorHit)) {
+			Velocity = FVector::ZeroVector;
+			floorCache.bValid = true;
+			floorCache.floor = floorHit.GetComponent();
+			floorCache.floorTransform = floorHit.GetComponent()->GetComponentTransform();
+			floorCache.normal = floorHit.Normal;
+			floorCache.location = UpdatedComponent->GetComponentLocation();
+			floorCache.rotation = UpdatedComponent->GetComponentQuat();
+			floorCache.gravity = internalGravity;
+			return;
+		}
 		SetMovementMode(EMovementMode::MOVE_Custom, CUSTOM_GRAVITY_FALL);
 		return;
 	}
 
 	float LastMoveTimeSlice = DeltaTime;
-	GEngine->AddOnScreenDebugMessage(-1, 1.0f, FColor::Yellow, FString::Printf(TEXT("Blocking: %d Walkable Ramp: %d"), Hit.IsValidBlockingHit(), (Hit.Time > 0.f) && (Hit.Normal.Z > UE_KINDA_SMALL_NUMBER) && IsWalkable(Hit)));
+#if !UE_BUILD_SHIPPING
+	bDebugLastWalkableRamp = (Hit.Time > 0.f) && (Hit.Normal.Z > UE_KINDA_SMALL_NUMBER) && IsWalkable(Hit);
+#endif
 
 	// Taken wholesale (and modified some beyond that) from CharacterMovementComponent.cpp's MoveAlongFloor:
 
 	// I've yet to see when this is called:
 	if (Hit.bStartPenetrating) {
+		COUNT_GRAVITY_MOVEMENT(Penetrations, STAT_GravityPenetrations);
 		HandleImpact(Hit);
 		SlideAlongSurface(delta, 1.f, Hit.Normal, Hit, true);
 
@@ -142,15 +377,20 @@ void UCharacterGravityComponent::CustomGravityWalk(float DeltaTime, FRotator new
 				const FVector PreStepUpLocation = UpdatedComponent->GetComponentLocation();
 				const FVector GravDir(0.f, 0.f, -1.f);
 				FStepDownResult out;
-				if (!StepUp(GravDir, delta * (1.f - PercentTimeApplied), Hit, &out))
+				COUNT_GRAVITY_MOVEMENT(StepUps, STAT_GravityStepUps);
+				bool bSteppedUp;
+				{
+					GRAVITY_MOVEMENT_SCOPE(StepUp);
+					bSteppedUp = StepUp(GravDir, delta * (1.f - PercentTimeApplied), Hit, &out);
+				}
+				if (!bSteppedUp)
 				{
-					UE_LOG(LogTemp, Verbose, TEXT("- StepUp (ImpactNormal %s, Normal %s"), *Hit.ImpactNormal.ToString(), *Hit.Normal.ToString());
+					COUNT_GRAVITY_MOVEMENT(StepUpFailures, STAT_GravityStepUpFailures);
 					HandleImpact(Hit, LastMoveTimeSlice, RampVector);
 					SlideAlongSurface(delta, 1.f - PercentTimeApplied, Hit.Normal, Hit, true);
 				}
 				else
 				{
-					UE_LOG(LogTemp, Verbose, TEXT("+ StepUp (ImpactNormal %s, Normal %s"), *Hit.ImpactNormal.ToString(), *Hit.Normal.ToString());
 					if (!bMaintainHorizontalGroundVelocity)
 					{
 						// Don't recalculate velocity based on this height adjustment, if considering vertical adjustments. Only consider horizontal movement.
@@ -174,26 +414,153 @@ void UCharacterGravityComponent::CustomGravityWalk(float DeltaTime, FRotator new
 }
 
 // READ MY LIPS. NO BILL CIPHER JOKES.
+bool UCharacterGravityComponent::FallAlongClearedArc(float DeltaTime, FRotator newRotation) {
+	if (!bBallisticFall || !CVarBallisticFall.GetValueOnGameThread() || UpdatedPrimitive == nullptr) {
+		return false;
+	}
+
+	// The sweeps were done with the capsule as it was, so it can't be turning.
+	const FQuat rotation = UpdatedComponent->GetComponentQuat();
+	if (gravityRotationCompletion < 1.0f || !newRotation.Quaternion().Equals(rotation) || HasAnimRootMotion() || CurrentRootMotion.HasActiveRootMotionSources()) {
+		ballisticArc.bValid = false;
+		return false;
+	}
+
+	// Still on the arc from last time, unless something (an impulse, a teleport, a gravity change) has knocked the character off it.
+	const FVector location = UpdatedComponent->GetComponentLocation();
+	const FVector acceleration = internalGravity * 100.0f;
+	const bool bOnArc = ballisticArc.bValid && ballisticArc.acceleration == acceleration
+		&& location.Equals(ballisticArc.PositionAt(ballisticArc.elapsed), 0.1f) && Velocity.Equals(ballisticArc.VelocityAt(ballisticArc.elapsed), 0.1f);
+
+	if (!bOnArc) {
+		ballisticArc.retryIn -= DeltaTime;
+		if (ballisticArc.retryIn > 0.0f) {
+			ballisticArc.bValid = false;
+			return false;
+		}
+		CheckBallisticArc(location);
+	}
+
+	const float time = ballisticArc.elapsed + DeltaTime;
+	// A freshly checked arc was just swept all the way to clearUntil. Further along one, the stretch this frame covers might need sweeping again.
+	if (bOnArc && time > ballisticArc.recheckedUntil && time <= ballisticArc.clearUntil) {
+		RecheckBallisticArc(time);
+	}
+	if (!ballisticArc.bValid || time > ballisticArc.clearUntil || (bOnArc && time > ballisticArc.recheckedUntil)) {
+		// Something's coming up, so let the substeps handle getting there. Don't bother checking again until it's had a chance to.
+		if (!bOnArc) {
+			ballisticArc.retryIn = BallisticLookahead * 0.5f;
+		}
+		ballisticArc.bValid = false;
+		return false;
+	}
+
+	COUNT_GRAVITY_MOVEMENT(BallisticTicks, STAT_GravityBallisticTicks);
+	bJustTeleported = false;
+
+	// This stretch was swept within the last BallisticRecheckInterval, so there's no need to sweep it again.
+	FHitResult Hit(1.f);
+	SafeMoveUpdatedComponent(ballisticArc.PositionAt(time) - location, newRotation, false, Hit);
+	Velocity = ballisticArc.VelocityAt(time);
+	ballisticArc.elapsed = time;
+	return true;
+}
+
+void UCharacterGravityComponent::CheckBallisticArc(FVector location) {
+	ballisticArc = FBallisticArc();
+	ballisticArc.origin = location;
+	ballisticArc.startVelocity = Velocity;
+	ballisticArc.acceleration = internalGravity * 100.0f;
+
+	const float accelerationSquared = ballisticArc.acceleration.SizeSquared();
+	if (accelerationSquared < UE_KINDA_SMALL_NUMBER) {
+		return;
+	}
+
+	// NewFallVelocity caps speed at the volume's terminal velocity, and past that the arc isn't a parabola any more.
+	float horizon = BallisticLookahead;
+	const float terminalVelocity = GetPhysicsVolume()->TerminalVelocity;
+	const float c = Velocity.SizeSquared() - terminalVelocity * terminalVelocity;
+	if (c >= 0.0f) {
+		return;
+	}
+	const float b = 2.0f * FVector::DotProduct(Velocity, ballisticArc.acceleration);
+	horizon = FMath::Min(horizon, (-b + FMath::Sqrt(b * b - 4.0f * accelerationSquared * c)) / (2.0f * accelerationSquared));
+
+	// A chord over time T is at most |a| T^2 / 8 away from the arc, so keep segments short enough for that to fit in the tolerance.
+	ballisticArc.segmentTime = FMath::Sqrt(8.0f * BallisticTolerance / FMath::Sqrt(accelerationSquared));
+	const int32 segments = FMath::Clamp(FMath::CeilToInt(horizon / ballisticArc.segmentTime), 1, 8);
+	const float step = horizon / segments;
+
+	FCollisionQueryParams params(SCENE_QUERY_STAT(GravityBallisticArc), false, CharacterOwner);
+	FCollisionResponseParams responseParams;
+	InitCollisionParams(params, responseParams);
+	const FCollisionShape shape = UpdatedPrimitive->GetCollisionShape(BallisticTolerance);
+	const FQuat rotation = UpdatedComponent->GetComponentQuat();
+
+	ballisticArc.bValid = true;
+	ballisticArc.clearUntil = horizon;
+	for (int32 i = 0; i < segments; i++) {
+		const float start = step * i;
+		FHitResult hit;
+		COUNT_GRAVITY_MOVEMENT(Sweeps, STAT_GravitySweeps);
+		if (GetWorld()->SweepSingleByChannel(hit, ballisticArc.PositionAt(start), ballisticArc.PositionAt(start + step), rotation, UpdatedComponent->GetCollisionObjectType(), shape, params, responseParams)) {
+			// Points on the chord and the arc line up by time, so the arc is clear for the same fraction of the segment.
+			ballisticArc.clearUntil = hit.bStartPenetrating ? start : start + step * hit.Time;
+			break;
+		}
+	}
+	ballisticArc.recheckedUntil = FMath::Min(BallisticRecheckInterval, ballisticArc.clearUntil);
+}
+
+void UCharacterGravityComponent::RecheckBallisticArc(float until) {
+	// One sweep, short enough to stay within tolerance of the arc.
+	const float start = ballisticArc.elapsed;
+	const float end = FMath::Min3(FMath::Max(start + BallisticRecheckInterval, until), start + ballisticArc.segmentTime, ballisticArc.clearUntil);
+
+	FCollisionQueryParams params(SCENE_QUERY_STAT(GravityBallisticArc), false, CharacterOwner);
+	FCollisionResponseParams responseParams;
+	InitCollisionParams(params, responseParams);
+	const FCollisionShape shape = UpdatedPrimitive->GetCollisionShape(BallisticTolerance);
+
+	FHitResult hit;
+	COUNT_GRAVITY_MOVEMENT(Sweeps, STAT_GravitySweeps);
+	if (GetWorld()->SweepSingleByChannel(hit, ballisticArc.PositionAt(start), ballisticArc.PositionAt(end), UpdatedComponent->GetComponentQuat(), UpdatedComponent->GetCollisionObjectType(), shape, params, responseParams)) {
+		ballisticArc.clearUntil = hit.bStartPenetrating ? start : start + (end - start) * hit.Time;
+	}
+	ballisticArc.recheckedUntil = FMath::Min(end, ballisticArc.clearUntil);
+}
+
 void UCharacterGravityComponent::CustomGravityFall(float DeltaTime, FRotator newRotation, int32 Iterations) {
+	SCOPE_CYCLE_COUNTER(STAT_GravityFall);
+	GRAVITY_MOVEMENT_SCOPE(CustomGravityFall);
+
+	if (FallAlongClearedArc(DeltaTime, newRotation)) {
+		return;
+	}
 
 	// Taken mostly from CharacterMovementComponent.cpp's PhysFalling:
 	float remainingTime = DeltaTime;
 	while (remainingTime >= MIN_TICK_TIME && Iterations < MaxSimulationIterations) {
 		Iterations++;
+		COUNT_GRAVITY_MOVEMENT(Iterations, STAT_GravityFallIterations);
 		float timeTick = GetSimulationTimeStep(remainingTime, Iterations);
 		remainingTime -= timeTick;
 
 		const FVector OldLocation = UpdatedComponent->GetComponentLocation();
 		bJustTeleported = false;
 
-		const FVector OldVelocityWithRootMotion = Velocity;
+		FVector Adjusted;
+		if (Iterations > 1 || !UsePreparedFall(timeTick, Adjusted)) {
+			const FVector OldVelocityWithRootMotion = Velocity;
 
-		float GravityTime = timeTick;
+			float GravityTime = timeTick;
 
-		Velocity = NewFallVelocity(Velocity, internalGravity * 100.0f, GravityTime);
+			Velocity = NewFallVelocity(Velocity, internalGravity * 100.0f, GravityTime);
 
-		// Compute change in position (using midpoint integration method).
-		FVector Adjusted = 0.5f * (OldVelocityWithRootMotion + Velocity) * timeTick;
+			// Compute change in position (using midpoint integration method).
+			Adjusted = 0.5f * (OldVelocityWithRootMotion + Velocity) * timeTick;
+		}
 
 		FHitResult Hit(1.f);
 		SafeMoveUpdatedComponent(Adjusted, newRotation, true, Hit);
@@ -209,18 +576,259 @@ void UCharacterGravityComponent::CustomGravityFall(float DeltaTime, FRotator new
 	}
 }
 
+void UCharacterGravityComponent::BeginPlay() {
+	Super::BeginPlay();
+
+	shiftedGravity = internalGravity;
+	gravityField = GetWorld()->GetSubsystem<UGravityFieldSubsystem>();
+
+	if (UGravityMovementSubsystem* movement = GetWorld()->GetSubsystem<UGravityMovementSubsystem>()) {
+		movement->RegisterComponent(this);
+	}
+}
+
+void UCharacterGravityComponent::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+	if (UGravityMovementSubsystem* movement = GetWorld()->GetSubsystem<UGravityMovementSubsystem>()) {
+		movement->UnregisterComponent(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UCharacterGravityComponent::UpdateGravityFromField() {
+	if (!bUseGravityField || gravityField == nullptr || (!bInGravityField && !gravityField->HasSources())) {
+		return;
+	}
+
+	FVector fieldGravity;
+	if (gravityField->SampleGravity(UpdatedComponent->GetComponentLocation(), gravityFieldCache, fieldGravity)) {
+		bInGravityField = true;
+
+		// Point, cylinder and spline sources turn a little with every step the character takes. Turns too small to notice are skipped,
+		// and small ones are followed without starting the rotation (and everything that depends on gravity staying put) over.
+		const FVector currentDirection = internalGravity.GetSafeNormal();
+		const FVector fieldDirection = fieldGravity.GetSafeNormal();
+		if (currentDirection.IsNearlyZero() || fieldDirection.IsNearlyZero()) {
+			if (!fieldGravity.Equals(internalGravity, 0.01f)) {
+				ApplyGravity(fieldGravity);
+			}
+			return;
+		}
+
+		const float angle = FMath::RadiansToDegrees(FMath::Acos(FMath::Clamp(currentDirection.Dot(fieldDirection), -1.0, 1.0)));
+		const float strength = internalGravity.Size();
+		if (angle <= FieldGravityTolerance && FMath::IsNearlyEqual(fieldGravity.Size(), strength, strength * 0.01f)) {
+			return;
+		}
+		if (angle <= FieldRetargetAngle) {
+			RetargetGravity(fieldGravity);
+		}
+		else {
+			ApplyGravity(fieldGravity);
+		}
+	}
+	else if (bInGravityField) {
+		bInGravityField = false;
+		ApplyGravity(shiftedGravity);
+	}
+}
+
 void UCharacterGravityComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) {
+	SCOPE_CYCLE_COUNTER(STAT_GravityTick);
+	GRAVITY_MOVEMENT_SCOPE(UCharacterGravityComponent::TickComponent);
+	const uint64 startCycles = FPlatformTime::Cycles64();
+#if !UE_BUILD_SHIPPING
+	const FGravityMovementCounters before = counters;
+#endif
+
+	// Normally UGravityMovementSubsystem has already done this.
+	if (UpdatedComponent != nullptr && !IsServerForRemoteClient() && !(prepared.bFieldSampled && IsPrepared(DeltaTime))) {
+		UpdateGravityFromField();
+	}
+
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
-	if (MovementMode.GetValue() != EMovementMode::MOVE_Custom) {
+
+	counters.Ticks++;
+	counters.Seconds += FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - startCycles);
+
+#if !UE_BUILD_SHIPPING
+	if (CVarGravityDebugOverlay.GetValueOnGameThread()) {
+		DrawDebugOverlay(before);
+	}
+#endif
+}
+
+#if !UE_BUILD_SHIPPING
+void UCharacterGravityComponent::DrawDebugOverlay(const FGravityMovementCounters& before) const {
+	if (GEngine == nullptr) {
+		return;
+	}
+
+	const TCHAR* mode = TEXT("Other");
+	if (MovementMode == EMovementMode::MOVE_Custom) {
+		mode = CustomMovementMode == CUSTOM_GRAVITY_WALK ? TEXT("Walk") : CustomMovementMode == CUSTOM_GRAVITY_FALL ? TEXT("Fall") : TEXT("Custom");
+	}
+
+	// Keyed on this component, so each character keeps one line rather than spamming new ones.
+	GEngine->AddOnScreenDebugMessage((uint64)GetUniqueID(), 0.0f, FColor::Yellow, FString::Printf(TEXT("%s %s gravity %s | sweeps %llu, iterations %llu, step ups %llu (%llu failed), penetrations %llu, walkable ramp %d"),
+		*GetNameSafe(GetOwner()), mode, *internalGravity.ToCompactString(),
+		counters.Sweeps - before.Sweeps, counters.Iterations - before.Iterations, counters.StepUps - before.StepUps, counters.StepUpFailures - before.StepUpFailures,
+		counters.Penetrations - before.Penetrations, bDebugLastWalkableRamp));
+}
+#endif
+
+FNetworkPredictionData_Client* UCharacterGravityComponent::GetPredictionData_Client() const {
+	if (ClientPredictionData == nullptr) {
+		UCharacterGravityComponent* mutableThis = const_cast<UCharacterGravityComponent*>(this);
+		mutableThis->ClientPredictionData = new FNetworkPredictionData_Client_Gravity(*this);
+	}
+	return ClientPredictionData;
+}
+
+FGravityState UCharacterGravityComponent::GetGravityState() const {
+	FGravityState state;
+	state.gravity = internalGravity;
+	state.shiftedGravity = shiftedGravity;
+	state.previousRotation = previousRotation;
+	state.rotationCompletion = gravityRotationCompletion;
+	state.shiftId = gravityShiftId;
+	state.bInGravityField = bInGravityField;
+	return state;
+}
+
+void UCharacterGravityComponent::SetGravityState(const FGravityState& state) {
+	internalGravity = state.gravity;
+	shiftedGravity = state.shiftedGravity;
+	previousRotation = state.previousRotation;
+	gravityRotationCompletion = state.rotationCompletion;
+	gravityShiftId = state.shiftId;
+	bInGravityField = state.bInGravityField;
+	gravityRotation = GetRotatorFromGravity(internalGravity);
+	DiscardPreparedMovement();
+	InvalidateFloorCache();
+	ballisticArc = FBallisticArc();
+}
+
+void UCharacterGravityComponent::ReplayGravityMove(uint8 shiftId, FVector shiftGravity) {
+	DiscardPreparedMovement();
+
+	if (shiftId != gravityShiftId) {
+		ApplyGravityShiftEvent(shiftId, shiftGravity);
+	}
+	UpdateGravityFromField();
+}
+
+void UCharacterGravityComponent::MoveAutonomous(float ClientTimeStamp, float DeltaTime, uint8 CompressedFlags, const FVector& NewAccel) {
+	if (IsServerForRemoteClient()) {
+		const FGravityNetworkMoveData* moveData = static_cast<const FGravityNetworkMoveData*>(GetCurrentNetworkMoveData());
+		if (moveData != nullptr && moveData->bHasShift && moveData->shiftId != gravityShiftId) {
+			ApplyGravityShiftEvent(moveData->shiftId, moveData->shiftGravity.Dequantize());
+		}
+		UpdateGravityFromField();
+	}
+
+	Super::MoveAutonomous(ClientTimeStamp, DeltaTime, CompressedFlags, NewAccel);
+}
+
+void UCharacterGravityComponent::RequestGravityMovement(bool bEnable) {
+	bRequestGravityMovement = bEnable;
+	bRequestWalking = !bEnable;
+}
+
+void UCharacterGravityComponent::UpdateFromCompressedFlags(uint8 Flags) {
+	Super::UpdateFromCompressedFlags(Flags);
+
+	bRequestGravityMovement = (Flags & FSavedMove_Character::FLAG_Custom_0) != 0;
+	bRequestWalking = (Flags & FSavedMove_Character::FLAG_Custom_1) != 0;
+}
+
+void UCharacterGravityComponent::ApplyAccumulatedForces(float DeltaSeconds) {
+	if (MovementMode != EMovementMode::MOVE_Custom) {
 		AddForce(internalGravity * 10000.0f);
+	}
+
+	Super::ApplyAccumulatedForces(DeltaSeconds);
+}
+
+void UCharacterGravityComponent::UpdateCharacterStateBeforeMovement(float DeltaSeconds) {
+	Super::UpdateCharacterStateBeforeMovement(DeltaSeconds);
+
+	if (bRequestGravityMovement && MovementMode != EMovementMode::MOVE_Custom) {
+		SetMovementMode(EMovementMode::MOVE_Custom, CUSTOM_GRAVITY_WALK);
+	}
+	else if (bRequestWalking && MovementMode == EMovementMode::MOVE_Custom) {
+		SetMovementMode(EMovementMode::MOVE_Walking);
+	}
+
+	if (MovementMode != EMovementMode::MOVE_Custom) {
 		FRotator newRotation;
-		if (RotateTowardsGravity(DeltaTime, newRotation)) {
+		if (RotateTowardsGravity(DeltaSeconds, newRotation) && !newRotation.Equals(UpdatedComponent->GetComponentRotation())) {
 			FHitResult Adjustment(1.f);
 			SafeMoveUpdatedComponent(FVector::ZeroVector, newRotation, false, Adjustment);
 		}
 	}
 }
 
+void UCharacterGravityComponent::UpdateCharacterStateAfterMovement(float DeltaSeconds) {
+	Super::UpdateCharacterStateAfterMovement(DeltaSeconds);
+
+	// Requests are for one move. Replays and the server get them back from the saved move's flags.
+	bRequestGravityMovement = false;
+	bRequestWalking = false;
+}
+
+bool UCharacterGravityComponent::ServerCheckClientError(float ClientTimeStamp, float DeltaTime, const FVector& Accel, const FVector& ClientLoc, const FVector& RelativeClientLocation, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode) {
+	FGravityNetStats& stats = FGravityNetStats::Get();
+	if (Super::ServerCheckClientError(ClientTimeStamp, DeltaTime, Accel, ClientLoc, RelativeClientLocation, ClientMovementBase, ClientBaseBoneName, ClientMovementMode)) {
+		stats.CorrectionsSent++;
+		return true;
+	}
+
+	const FGravityNetworkMoveData* moveData = static_cast<const FGravityNetworkMoveData*>(GetCurrentNetworkMoveData());
+	if (moveData == nullptr) {
+		return false;
+	}
+
+	// Either side can be a step of rounding out on the rotation.
+	if (moveData->shiftId != gravityShiftId || FMath::Abs((int32)moveData->completion - (int32)GravityNet::QuantizeCompletion(gravityRotationCompletion)) > 2) {
+		stats.CorrectionsSent++;
+		stats.GravityCorrectionsSent++;
+		return true;
+	}
+	return false;
+}
+
+void UCharacterGravityComponent::ClientHandleMoveResponse(const FCharacterMoveResponseDataContainer& MoveResponse) {
+	if (MoveResponse.IsCorrection()) {
+		SetGravityState(static_cast<const FGravityMoveResponseDataContainer&>(MoveResponse).ToState());
+		FGravityNetStats::Get().CorrectionsReceived++;
+	}
+
+	Super::ClientHandleMoveResponse(MoveResponse);
+}
+
+void UCharacterGravityComponent::ServerMovePacked_ClientSend(const FCharacterServerMovePackedBits& PackedBits) {
+	FGravityNetStats& stats = FGravityNetStats::Get();
+	stats.MovesSent++;
+	stats.MoveBitsSent += PackedBits.DataBits.Num();
+
+	Super::ServerMovePacked_ClientSend(PackedBits);
+}
+
+void UCharacterGravityComponent::MoveResponsePacked_ServerSend(const FCharacterMoveResponsePackedBits& PackedBits) {
+	FGravityNetStats::Get().ResponseBitsSent += PackedBits.DataBits.Num();
+
+	Super::MoveResponsePacked_ServerSend(PackedBits);
+}
+
+bool UCharacterGravityComponent::MoveUpdatedComponentImpl(const FVector& Delta, const FQuat& NewRotation, bool bSweep, FHitResult* OutHit, ETeleportType Teleport) {
+	// Every move we make goes through here, including the ones inside StepUp and SlideAlongSurface.
+	if (bSweep) {
+		COUNT_GRAVITY_MOVEMENT(Sweeps, STAT_GravitySweeps);
+	}
+	return Super::MoveUpdatedComponentImpl(Delta, NewRotation, bSweep, OutHit, Teleport);
+}
+
 // For applying forces once they've been set up:
 void UCharacterGravityComponent::PhysCustom(float DeltaTime, int32 Iterations) {
 	Super::PhysCustom(DeltaTime, Iterations);
@@ -229,8 +837,12 @@ void UCharacterGravityComponent::PhysCustom(float DeltaTime, int32 Iterations) {
 	RotateTowardsGravity(DeltaTime, newRotation);
 
 	switch (CustomMovementMode) {
-		case CUSTOM_GRAVITY_FALL:
+		case CUSTOM_GRAVITY_FALL: {
+			const uint64 sweepsBefore = counters.Sweeps;
 			CustomGravityFall(DeltaTime, newRotation, Iterations);
+			counters.FallTicks++;
+			counters.FallSweeps += counters.Sweeps - sweepsBefore;
+		}
 		break;
 		case CUSTOM_GRAVITY_WALK:
 			CustomGravityWalk(DeltaTime, newRotation);
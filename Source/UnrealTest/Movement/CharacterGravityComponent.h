@@ -5,8 +5,102 @@
 #include "CoreMinimal.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "Camera/CameraComponent.h"
+#include "GravityFieldSubsystem.h"
+#include "GravityMovementNetworking.h"
 #include "CharacterGravityComponent.generated.h"
 
+// Custom movement modes. Lives out here (without UMETA, since UHT reads this file) so other code can put a character into them.
+enum GravityMovementMode {
+	// Read my lips: no Bill Cipher jokes.
+	CUSTOM_GRAVITY_FALL, // Custom Gravity Falling
+	CUSTOM_GRAVITY_WALK, // Custom Gravity Walking
+	CUSTOM_GRAVITY_JUMP, // Custom Gravity Jumping
+};
+
+/** Running totals of the work a UCharacterGravityComponent has done, for benchmarks. */
+struct FGravityMovementCounters {
+	uint64 Ticks = 0;
+	/** Sweeping moves, including the ones made by StepUp and SlideAlongSurface. */
+	uint64 Sweeps = 0;
+	/** Substeps run by CustomGravityFall. */
+	uint64 Iterations = 0;
+	uint64 StepUps = 0;
+	/** StepUps that couldn't step up, and slid along the obstacle instead. */
+	uint64 StepUpFailures = 0;
+	/** Walking moves that started inside geometry. */
+	uint64 Penetrations = 0;
+	uint64 WalkToFall = 0;
+	uint64 FallToWalk = 0;
+	/** CustomGravityWalk ticks skipped because the character was standing still on its cached floor. */
+	uint64 SleepingTicks = 0;
+	/** CustomGravityFall ticks that moved along an arc already checked to be clear, without substeps or a sweep of their own. */
+	uint64 BallisticTicks = 0;
+	/** CustomGravityFall ticks, however they moved. */
+	uint64 FallTicks = 0;
+	/** Sweeps made during FallTicks, arc checks included. */
+	uint64 FallSweeps = 0;
+	/** Time spent in TickComponent (including PhysCustom) and PrepareMovement. */
+	double Seconds = 0.0;
+};
+
+/** Movement worked out ahead of time by UGravityMovementSubsystem, for one frame. Each part is used at most once. */
+struct FPreparedGravityMovement {
+	uint64 frame = 0;
+	float deltaTime = 0.0f;
+
+	bool bFieldSampled = false;
+
+	bool bHasRotation = false;
+	bool bRotating = false;
+	FRotator rotation = FRotator::ZeroRotator;
+	float rotationCompletion = 0.0f;
+
+	/** The first CustomGravityFall substep, good as long as velocity and gravity haven't changed since. */
+	bool bHasFall = false;
+	FVector fallStartVelocity = FVector::ZeroVector;
+	FVector fallGravity = FVector::ZeroVector;
+	float fallTerminalVelocity = 0.0f;
+	float fallTimeTick = 0.0f;
+	FVector fallVelocity = FVector::ZeroVector;
+	FVector fallDelta = FVector::ZeroVector;
+};
+
+/** The floor an idle walking character is standing on, so it can stop sweeping until something changes. */
+struct FGravityFloorCache {
+	bool bValid = false;
+	TWeakObjectPtr<UPrimitiveComponent> floor;
+	/** Where the floor was. If it's moved, the character needs to move with it. */
+	FTransform floorTransform;
+	FVector normal = FVector::ZeroVector;
+	FVector location = FVector::ZeroVector;
+	FQuat rotation = FQuat::Identity;
+	FVector gravity = FVector::ZeroVector;
+};
+
+/**
+ * A stretch of the parabola a falling character is on that's been swept and found clear.
+ * Gravity is constant while falling, so positions along it are exact rather than predicted.
+ */
+struct FBallisticArc {
+	bool bValid = false;
+	FVector origin = FVector::ZeroVector;
+	FVector startVelocity = FVector::ZeroVector;
+	FVector acceleration = FVector::ZeroVector;
+	/** Seconds along the arc the character has got to. */
+	float elapsed = 0.0f;
+	/** Seconds along the arc that are known to be clear. */
+	float clearUntil = 0.0f;
+	/** Seconds along the arc that were swept recently enough to move along without sweeping. Past this, the next stretch is swept again first. */
+	float recheckedUntil = 0.0f;
+	/** Longest stretch of the arc one straight sweep can cover and stay within BallisticTolerance of it. */
+	float segmentTime = 0.0f;
+	/** Near geometry, checking arcs keeps failing, so wait this long before trying again. */
+	float retryIn = 0.0f;
+
+	FVector PositionAt(float time) const { return origin + startVelocity * time + 0.5f * acceleration * time * time; }
+	FVector VelocityAt(float time) const { return startVelocity + acceleration * time; }
+};
+
 /**
  * 
  */
@@ -21,10 +115,45 @@ public:
 
 	virtual void PhysCustom(float DeltaTime, int32 Iterations) override;
 
+	/** Changes gravity for this character. Inside an AGravitySource (when bUseGravityField is on) the source wins, and this takes over again once the character leaves. */
 	void GravityShift(FVector newGravity);
 
 	static FRotator GetRotatorFromGravity(FVector gravityDirection);
+
+	const FGravityMovementCounters& GetCounters() const { return counters; }
+
+	void ResetCounters() { counters = FGravityMovementCounters(); }
+
+	/** Whether UGravityMovementSubsystem should prepare this component's movement this frame. */
+	bool CanPrepareMovement() const;
+
+	/**
+	 * The parts of this frame's movement that don't sweep. Runs on a worker thread, so it must only touch this component.
+	 * terminalVelocity is the physics volume's, read on the game thread, since the volume can't be looked up from here.
+	 */
+	void PrepareMovement(float DeltaTime, float terminalVelocity);
+
+	virtual FNetworkPredictionData_Client* GetPredictionData_Client() const override;
+
+	FGravityState GetGravityState() const;
+
+	/** Puts gravity back the way a server correction says it was. */
+	void SetGravityState(const FGravityState& state);
+
+	/** Gets ready to replay a saved move: redoes its gravity shift if it hasn't happened yet, and looks up the field where the move starts. */
+	void ReplayGravityMove(uint8 shiftId, FVector shiftGravity);
+
+	/** Switches into custom gravity movement, or back to walking, at the start of the next move. The switch goes to the server with that move. */
+	void RequestGravityMovement(bool bEnable);
+
+	/** Mode switches waiting for the next move, as sent in FSavedMove_Gravity's compressed flags. */
+	bool bRequestGravityMovement = false;
+	bool bRequestWalking = false;
 protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
 	void CustomGravityWalk(float DeltaTime, FRotator newRotation);
@@ -32,9 +161,113 @@ protected:
 	void CustomGravityFall(float DeltaTime, FRotator newRotation, int32 Iterations);
 
 	bool RotateTowardsGravity(float DeltaTime, FRotator& out);
+
+	/** RotateTowardsGravity's math, working on completion rather than gravityRotationCompletion. */
+	bool AdvanceGravityRotation(float DeltaTime, float& completion, FRotator& out) const;
+
+	/** True if this frame was prepared for this DeltaTime. */
+	bool IsPrepared(float DeltaTime) const;
+
+	/** NewFallVelocity without looking up the physics volume, so it's safe off the game thread. */
+	static FVector FallVelocity(const FVector& initialVelocity, const FVector& gravity, float deltaTime, float terminalVelocity);
+
+	/** Uses the prepared first falling substep, if it still applies. */
+	bool UsePreparedFall(float timeTick, FVector& outDelta);
+
+	/** True if the character can keep standing on its cached floor this tick without sweeping. */
+	bool CanSleepOnFloor(FRotator newRotation) const;
+
+	/** Sweeps a little way along gravity from where the character is, for a floor it could stand on. */
+	bool FindFloorAlongGravity(FHitResult& out);
+
+	void InvalidateFloorCache() { floorCache.bValid = false; }
+
+	/** Moves this frame along a cleared arc without sweeping, checking a new arc or the next stretch of this one first if needed. False means the normal substeps have to do it. */
+	bool FallAlongClearedArc(float DeltaTime, FRotator newRotation);
+
+	/** Sweeps the arc from location in segments short enough to stay within BallisticTolerance of it, up to BallisticLookahead seconds or the first hit. */
+	void CheckBallisticArc(FVector location);
+
+	/** Sweeps the arc again from where the character is, BallisticRecheckInterval ahead or to until if that's further, and pulls clearUntil in if something's moved into it. */
+	void RecheckBallisticArc(float until);
+
+	/** Starts rotating towards newGravity. */
+	void ApplyGravity(FVector newGravity);
+
+	/** Points the rotation already under way at newGravity instead of starting it over, for the small turns a field makes as the character moves through it. */
+	void RetargetGravity(FVector newGravity);
+
+	/** Picks up gravity from any AGravitySource the character is in. */
+	void UpdateGravityFromField();
+
+	/** The shift numbered shiftId, whether made here or received from the owning client. */
+	void ApplyGravityShiftEvent(uint8 shiftId, FVector newGravity);
+
+	/** Throws away anything PrepareMovement worked out, because the state it started from has changed. */
+	void DiscardPreparedMovement() { prepared = FPreparedGravityMovement(); }
+
+	/** A server simulating a client's character, which has to look up the field per move rather than per tick. */
+	bool IsServerForRemoteClient() const;
+
+	virtual void MoveAutonomous(float ClientTimeStamp, float DeltaTime, uint8 CompressedFlags, const FVector& NewAccel) override;
+
+	virtual void UpdateFromCompressedFlags(uint8 Flags) override;
+
+	/** Outside custom movement, gravity is a force, so it's added in with the move's others rather than after the tick. */
+	virtual void ApplyAccumulatedForces(float DeltaSeconds) override;
+
+	/** Applies any requested mode switch, and outside custom movement turns towards gravity, as part of the move so a server replays it the same way. */
+	virtual void UpdateCharacterStateBeforeMovement(float DeltaSeconds) override;
+
+	virtual void UpdateCharacterStateAfterMovement(float DeltaSeconds) override;
+
+	virtual bool ServerCheckClientError(float ClientTimeStamp, float DeltaTime, const FVector& Accel, const FVector& ClientLoc, const FVector& RelativeClientLocation, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode) override;
+
+	virtual void ClientHandleMoveResponse(const FCharacterMoveResponseDataContainer& MoveResponse) override;
+
+	virtual void ServerMovePacked_ClientSend(const FCharacterServerMovePackedBits& PackedBits) override;
+
+	virtual void MoveResponsePacked_ServerSend(const FCharacterMoveResponsePackedBits& PackedBits) override;
+
+	virtual bool MoveUpdatedComponentImpl(const FVector& Delta, const FQuat& NewRotation, bool bSweep, FHitResult* OutHit = NULL, ETeleportType Teleport = ETeleportType::None) override;
 public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float GravityRotationRate = 1.0f;
+
+	/** How far below an idle character to look for floor before deciding it's falling. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float FloorProbeDistance = 10.0f;
+
+	/** Let falls in open air skip the substeps and their sweeps, along stretches of their arc that have been checked ahead of time. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bBallisticFall = true;
+
+	/** How many seconds of the arc to check at a time. Longer means fewer checks, but more of the world that can change underneath them. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "bBallisticFall"))
+	float BallisticLookahead = 0.5f;
+
+	/** How far the straight segments checking an arc can stray from it. The sweeps are inflated by this much to cover the difference. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "bBallisticFall"))
+	float BallisticTolerance = 5.0f;
+
+	/**
+	 * How many seconds of a cleared arc to move along before sweeping the stretch ahead again, in case something has moved into it.
+	 * Anything that gets into the arc and out of it again faster than this can be fallen through.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "bBallisticFall"))
+	float BallisticRecheckInterval = 0.1f;
+
+	/** Follow the AGravitySources in the level. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bUseGravityField = true;
+
+	/** Field gravity within this many degrees of the current gravity (and within 1% of its strength) counts as unchanged. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "bUseGravityField"))
+	float FieldGravityTolerance = 1.0f;
+
+	/** Field gravity that turns by less than this many degrees is followed without restarting the rotation, so point, cylinder and spline sources don't keep resetting it. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "bUseGravityField"))
+	float FieldRetargetAngle = 15.0f;
 protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
 	FVector internalGravity = FVector(0.0f, 0.0f, -9.8f);
@@ -45,4 +278,36 @@ protected:
 	FRotator previousRotation;
 	// Percentage:
 	float gravityRotationCompletion = 0.0f;
+
+	FGravityMovementCounters counters;
+
+	/** Gravity from the last GravityShift, used whenever no gravity source covers the character. */
+	FVector shiftedGravity = FVector(0.0f, 0.0f, -9.8f);
+
+	bool bInGravityField = false;
+
+	/** Counts explicit GravityShifts, so they can be sent as a number plus the new gravity. */
+	uint8 gravityShiftId = 0;
+
+	FGravityNetworkMoveDataContainer moveDataContainer;
+	FGravityMoveResponseDataContainer moveResponseContainer;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UGravityFieldSubsystem> gravityField;
+
+	FGravityFieldCache gravityFieldCache;
+
+	FPreparedGravityMovement prepared;
+
+	FGravityFloorCache floorCache;
+
+	FBallisticArc ballisticArc;
+
+#if !UE_BUILD_SHIPPING
+	/** Draws this component's line of ut.Movement.DebugOverlay. */
+	void DrawDebugOverlay(const FGravityMovementCounters& before) const;
+
+	/** Whether the last walking move landed on a walkable ramp, for the overlay. */
+	bool bDebugLastWalkableRamp = false;
+#endif
 };
@@ -0,0 +1,170 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityFieldSubsystem.h"
+#include "GravitySource.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static FAutoConsoleCommandWithWorld GDumpGravityField(
+	TEXT("ut.Gravity.Field"),
+	TEXT("Prints how many gravity sources and grid cells there are."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World) {
+		if (UGravityFieldSubsystem* subsystem = World ? World->GetSubsystem<UGravityFieldSubsystem>() : nullptr) {
+			subsystem->LogStats();
+		}
+	})
+);
+
+namespace {
+	// A source this big would be better off split up, or the cells made bigger.
+	const int64 MaxCellsPerSource = 100000;
+}
+
+bool UGravityFieldSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+FIntVector UGravityFieldSubsystem::GetCell(FVector location) const {
+	return FIntVector(FMath::FloorToInt(location.X / CellSize), FMath::FloorToInt(location.Y / CellSize), FMath::FloorToInt(location.Z / CellSize));
+}
+
+FBox UGravityFieldSubsystem::GetCellBox(FIntVector cell) const {
+	const FVector min = FVector(cell) * CellSize;
+	return FBox(min, min + FVector(CellSize));
+}
+
+void UGravityFieldSubsystem::RegisterSource(AGravitySource* source) {
+	if (source == nullptr || sources.ContainsByPredicate([source](const FIndexedSource& indexed) { return indexed.source == source; })) {
+		return;
+	}
+	AddToGrid(source);
+}
+
+void UGravityFieldSubsystem::UnregisterSource(AGravitySource* source) {
+	RemoveFromGrid(source);
+}
+
+void UGravityFieldSubsystem::UpdateSource(AGravitySource* source) {
+	RemoveFromGrid(source);
+	AddToGrid(source);
+}
+
+void UGravityFieldSubsystem::AddToGrid(AGravitySource* source) {
+	const FBox bounds = source->GetInfluenceBounds();
+	if (!bounds.IsValid) {
+		return;
+	}
+
+	FIndexedSource& indexed = sources.AddDefaulted_GetRef();
+	indexed.source = source;
+	indexed.minCell = GetCell(bounds.Min);
+	indexed.maxCell = GetCell(bounds.Max);
+
+	const FIntVector size = indexed.maxCell - indexed.minCell + FIntVector(1);
+	if ((int64)size.X * size.Y * size.Z > MaxCellsPerSource) {
+		UE_LOG(LogTemp, Warning, TEXT("Gravity source %s covers %d x %d x %d cells. Consider raising CellSize."), *source->GetName(), size.X, size.Y, size.Z);
+	}
+
+	for (int32 x = indexed.minCell.X; x <= indexed.maxCell.X; x++) {
+		for (int32 y = indexed.minCell.Y; y <= indexed.maxCell.Y; y++) {
+			for (int32 z = indexed.minCell.Z; z <= indexed.maxCell.Z; z++) {
+				grid.FindOrAdd(FIntVector(x, y, z)).Add(source);
+			}
+		}
+	}
+	version++;
+}
+
+void UGravityFieldSubsystem::RemoveFromGrid(AGravitySource* source) {
+	const int32 index = sources.IndexOfByPredicate([source](const FIndexedSource& indexed) { return indexed.source == source; });
+	if (index == INDEX_NONE) {
+		return;
+	}
+
+	const FIndexedSource indexed = sources[index];
+	sources.RemoveAtSwap(index);
+
+	for (int32 x = indexed.minCell.X; x <= indexed.maxCell.X; x++) {
+		for (int32 y = indexed.minCell.Y; y <= indexed.maxCell.Y; y++) {
+			for (int32 z = indexed.minCell.Z; z <= indexed.maxCell.Z; z++) {
+				const FIntVector cell(x, y, z);
+				if (TArray<AGravitySource*>* cellSources = grid.Find(cell)) {
+					cellSources->RemoveSingleSwap(source);
+					if (cellSources->Num() == 0) {
+						grid.Remove(cell);
+					}
+				}
+			}
+		}
+	}
+	version++;
+}
+
+bool UGravityFieldSubsystem::SampleGravity(FVector location, FGravityFieldCache& cache, FVector& out) const {
+	const FIntVector cell = GetCell(location);
+
+	if (cache.version != version || cache.cell != cell) {
+		cache.cell = cell;
+		cache.version = version;
+		cache.sources.Reset();
+		if (const TArray<AGravitySource*>* cellSources = grid.Find(cell)) {
+			cache.sources.Append(*cellSources);
+		}
+
+		// An empty cell, or one that a single planar source completely covers, has the same gravity all the way through.
+		cache.bUniform = false;
+		if (cache.sources.Num() == 0) {
+			cache.bUniform = true;
+			cache.bUniformHasGravity = false;
+		}
+		else if (cache.sources.Num() == 1 && cache.sources[0]->IsUniformOver(GetCellBox(cell))) {
+			cache.bUniform = true;
+			cache.bUniformHasGravity = cache.sources[0]->GetGravityAt(location, cache.uniformGravity);
+		}
+	}
+
+	if (cache.bUniform) {
+		out = cache.uniformGravity;
+		return cache.bUniformHasGravity;
+	}
+
+	// The highest priority wins, and sources on the same priority add up.
+	bool bFound = false;
+	int32 bestPriority = MIN_int32;
+	FVector total = FVector::ZeroVector;
+	for (const AGravitySource* source : cache.sources) {
+		if (bFound && source->Priority < bestPriority) {
+			continue;
+		}
+
+		FVector gravity;
+		if (!source->GetGravityAt(location, gravity)) {
+			continue;
+		}
+
+		if (!bFound || source->Priority > bestPriority) {
+			bestPriority = source->Priority;
+			total = gravity;
+		}
+		else {
+			total += gravity;
+		}
+		bFound = true;
+	}
+
+	out = total;
+	return bFound;
+}
+
+void UGravityFieldSubsystem::LogStats() const {
+	int32 mostSources = 0;
+	int32 references = 0;
+	for (const TPair<FIntVector, TArray<AGravitySource*>>& cell : grid) {
+		mostSources = FMath::Max(mostSources, cell.Value.Num());
+		references += cell.Value.Num();
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Gravity field: %d sources in %d cells of size %.0f, %.2f sources per cell on average, %d at most"),
+		sources.Num(), grid.Num(), CellSize, grid.Num() > 0 ? (float)references / grid.Num() : 0.0f, mostSources);
+}
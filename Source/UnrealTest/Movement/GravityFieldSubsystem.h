@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GravityFieldSubsystem.generated.h"
+
+class AGravitySource;
+
+/**
+ * What a character last looked up from UGravityFieldSubsystem. Lookups from the same grid cell reuse it rather than going back to the grid.
+ */
+struct FGravityFieldCache {
+	FIntVector cell = FIntVector::ZeroValue;
+	/** Matches the subsystem's version while this is still good. 0 means it's never been filled in. */
+	uint32 version = 0;
+	/** Sources overlapping the cell. */
+	TArray<AGravitySource*, TInlineAllocator<4>> sources;
+	/** The whole cell has the same gravity (including none at all), so sources doesn't need checking. */
+	bool bUniform = false;
+	bool bUniformHasGravity = false;
+	FVector uniformGravity = FVector::ZeroVector;
+};
+
+/**
+ * Keeps every AGravitySource in a uniform grid, so finding the gravity at a location only checks the few sources in its cell.
+ */
+UCLASS(config=Game)
+class UNREALTEST_API UGravityFieldSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	void RegisterSource(AGravitySource* source);
+	void UnregisterSource(AGravitySource* source);
+	/** Re-indexes a source that's moved or changed shape. */
+	void UpdateSource(AGravitySource* source);
+
+	/**
+	 * Works out the gravity at location from whichever sources cover it. Returns false if none do.
+	 * cache should be kept by the caller between lookups.
+	 */
+	bool SampleGravity(FVector location, FGravityFieldCache& cache, FVector& out) const;
+
+	bool HasSources() const { return sources.Num() > 0; }
+
+	/** Logs how many sources and cells there are, and how crowded the cells get. */
+	void LogStats() const;
+
+public:
+	/** Size of a grid cell. Smaller cells mean fewer sources to check per lookup, but more cells per source. */
+	UPROPERTY(config, EditAnywhere, Category = Gravity)
+	float CellSize = 2000.0f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	FIntVector GetCell(FVector location) const;
+
+	FBox GetCellBox(FIntVector cell) const;
+
+	void AddToGrid(AGravitySource* source);
+	void RemoveFromGrid(AGravitySource* source);
+
+	struct FIndexedSource {
+		AGravitySource* source = nullptr;
+		FIntVector minCell;
+		FIntVector maxCell;
+	};
+
+	TArray<FIndexedSource> sources;
+
+	TMap<FIntVector, TArray<AGravitySource*>> grid;
+
+	/** Bumped whenever the grid changes, which invalidates every FGravityFieldCache. */
+	uint32 version = 1;
+};
@@ -0,0 +1,252 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityMovementNetworking.h"
+#include "CharacterGravityComponent.h"
+#include "GameFramework/Character.h"
+#include "HAL/IConsoleManager.h"
+
+static FAutoConsoleCommand GDumpGravityNetStats(
+	TEXT("ut.Net.GravityStats"),
+	TEXT("Prints gravity movement bandwidth and correction counts since the last time this was run."),
+	FConsoleCommandDelegate::CreateLambda([]() {
+		FGravityNetStats::Get().LogAndReset();
+	})
+);
+
+namespace {
+	// Strength is sent in hundredths, so this covers up to 655.35.
+	const float StrengthScale = 100.0f;
+
+	uint16 QuantizeUnit(float value) {
+		return (uint16)FMath::Clamp(FMath::RoundToInt((value * 0.5f + 0.5f) * 65535.0f), 0, 65535);
+	}
+
+	float DequantizeUnit(uint16 value) {
+		return (value / 65535.0f) * 2.0f - 1.0f;
+	}
+}
+
+FQuantizedGravity FQuantizedGravity::Quantize(FVector gravity) {
+	FQuantizedGravity out;
+	const float size = gravity.Size();
+	out.strength = (uint16)FMath::Clamp(FMath::RoundToInt(size * StrengthScale), 0, 65535);
+	if (out.strength == 0) {
+		return out;
+	}
+
+	// Octahedral: project onto |x| + |y| + |z| = 1, then fold the lower half over the upper.
+	const FVector n = gravity / (FMath::Abs(gravity.X) + FMath::Abs(gravity.Y) + FMath::Abs(gravity.Z));
+	float u = n.X;
+	float v = n.Y;
+	if (n.Z < 0.0f) {
+		u = (1.0f - FMath::Abs(n.Y)) * (n.X >= 0.0f ? 1.0f : -1.0f);
+		v = (1.0f - FMath::Abs(n.X)) * (n.Y >= 0.0f ? 1.0f : -1.0f);
+	}
+	out.x = QuantizeUnit(u);
+	out.y = QuantizeUnit(v);
+	return out;
+}
+
+FVector FQuantizedGravity::Dequantize() const {
+	if (strength == 0) {
+		return FVector::ZeroVector;
+	}
+
+	FVector n(DequantizeUnit(x), DequantizeUnit(y), 0.0f);
+	n.Z = 1.0f - FMath::Abs(n.X) - FMath::Abs(n.Y);
+	const float fold = FMath::Max(-n.Z, 0.0f);
+	n.X += n.X >= 0.0f ? -fold : fold;
+	n.Y += n.Y >= 0.0f ? -fold : fold;
+	return n.GetSafeNormal() * (strength / StrengthScale);
+}
+
+void FQuantizedGravity::Serialize(FArchive& Ar) {
+	Ar << x;
+	Ar << y;
+	Ar << strength;
+}
+
+uint8 GravityNet::QuantizeCompletion(float completion) {
+	return (uint8)FMath::Clamp(FMath::RoundToInt(completion * 255.0f), 0, 255);
+}
+
+float GravityNet::DequantizeCompletion(uint8 completion) {
+	return completion / 255.0f;
+}
+
+void FSavedMove_Gravity::Clear() {
+	Super::Clear();
+
+	shiftId = 0;
+	shiftGravity = FQuantizedGravity();
+	bSendShift = false;
+	endCompletion = 0;
+	bRequestGravityMovement = false;
+	bRequestWalking = false;
+}
+
+void FSavedMove_Gravity::SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData) {
+	Super::SetMoveFor(C, InDeltaTime, NewAccel, ClientData);
+
+	if (const UCharacterGravityComponent* movement = Cast<UCharacterGravityComponent>(C->GetCharacterMovement())) {
+		const FGravityState state = movement->GetGravityState();
+		shiftId = state.shiftId;
+		shiftGravity = FQuantizedGravity::Quantize(state.shiftedGravity);
+
+		// Keep sending the shift until the server has acknowledged a move that had it.
+		const FSavedMove_Gravity* acked = static_cast<const FSavedMove_Gravity*>(ClientData.LastAckedMove.Get());
+		bSendShift = acked == nullptr || acked->shiftId != shiftId;
+
+		bRequestGravityMovement = movement->bRequestGravityMovement;
+		bRequestWalking = movement->bRequestWalking;
+	}
+}
+
+void FSavedMove_Gravity::PostUpdate(ACharacter* C, EPostUpdateMode PostUpdateMode) {
+	Super::PostUpdate(C, PostUpdateMode);
+
+	if (const UCharacterGravityComponent* movement = Cast<UCharacterGravityComponent>(C->GetCharacterMovement())) {
+		endCompletion = GravityNet::QuantizeCompletion(movement->GetGravityState().rotationCompletion);
+	}
+}
+
+void FSavedMove_Gravity::PrepMoveFor(ACharacter* C) {
+	Super::PrepMoveFor(C);
+
+	// Replaying after a correction: the server's gravity state is already in place, so only the shifts made since need doing again.
+	if (UCharacterGravityComponent* movement = Cast<UCharacterGravityComponent>(C->GetCharacterMovement())) {
+		movement->ReplayGravityMove(shiftId, shiftGravity.Dequantize());
+	}
+}
+
+bool FSavedMove_Gravity::CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const {
+	if (static_cast<const FSavedMove_Gravity*>(NewMove.Get())->shiftId != shiftId) {
+		return false;
+	}
+	return Super::CanCombineWith(NewMove, InCharacter, MaxDelta);
+}
+
+uint8 FSavedMove_Gravity::GetCompressedFlags() const {
+	uint8 flags = Super::GetCompressedFlags();
+	if (bRequestGravityMovement) {
+		flags |= FLAG_Custom_0;
+	}
+	if (bRequestWalking) {
+		flags |= FLAG_Custom_1;
+	}
+	return flags;
+}
+
+FSavedMovePtr FNetworkPredictionData_Client_Gravity::AllocateNewMove() {
+	return FSavedMovePtr(new FSavedMove_Gravity());
+}
+
+void FGravityNetworkMoveData::ClientFillNetworkMoveData(const FSavedMove_Character& ClientMove, ENetworkMoveType MoveType) {
+	Super::ClientFillNetworkMoveData(ClientMove, MoveType);
+
+	const FSavedMove_Gravity& move = static_cast<const FSavedMove_Gravity&>(ClientMove);
+	shiftId = move.shiftId;
+	bHasShift = move.bSendShift;
+	shiftGravity = move.shiftGravity;
+	completion = move.endCompletion;
+}
+
+bool FGravityNetworkMoveData::Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap, ENetworkMoveType MoveType) {
+	if (!Super::Serialize(CharacterMovement, Ar, PackageMap, MoveType)) {
+		return false;
+	}
+
+	Ar << shiftId;
+	Ar << completion;
+
+	uint8 hasShift = bHasShift ? 1 : 0;
+	Ar.SerializeBits(&hasShift, 1);
+	bHasShift = hasShift != 0;
+	if (bHasShift) {
+		shiftGravity.Serialize(Ar);
+	}
+
+	if (Ar.IsSaving()) {
+		FGravityNetStats& stats = FGravityNetStats::Get();
+		stats.GravityBitsSent += 17 + (bHasShift ? 48 : 0);
+		stats.ShiftsSent += bHasShift ? 1 : 0;
+	}
+	return !Ar.IsError();
+}
+
+FGravityNetworkMoveDataContainer::FGravityNetworkMoveDataContainer() {
+	NewMoveData = &moves[0];
+	PendingMoveData = &moves[1];
+	OldMoveData = &moves[2];
+}
+
+void FGravityMoveResponseDataContainer::ServerFillResponseData(const UCharacterMovementComponent& CharacterMovement, const FClientAdjustment& PendingAdjustment) {
+	Super::ServerFillResponseData(CharacterMovement, PendingAdjustment);
+
+	const UCharacterGravityComponent& movement = static_cast<const UCharacterGravityComponent&>(CharacterMovement);
+	const FGravityState state = movement.GetGravityState();
+	shiftId = state.shiftId;
+	shiftedGravity = FQuantizedGravity::Quantize(state.shiftedGravity);
+	gravity = FQuantizedGravity::Quantize(state.gravity);
+	completion = GravityNet::QuantizeCompletion(state.rotationCompletion);
+	previousRotation[0] = FRotator::CompressAxisToShort(state.previousRotation.Pitch);
+	previousRotation[1] = FRotator::CompressAxisToShort(state.previousRotation.Yaw);
+	previousRotation[2] = FRotator::CompressAxisToShort(state.previousRotation.Roll);
+	bInGravityField = state.bInGravityField;
+}
+
+bool FGravityMoveResponseDataContainer::Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap) {
+	if (!Super::Serialize(CharacterMovement, Ar, PackageMap)) {
+		return false;
+	}
+
+	// Good moves are acknowledged as usual, with nothing extra.
+	if (IsCorrection()) {
+		Ar << shiftId;
+		shiftedGravity.Serialize(Ar);
+		gravity.Serialize(Ar);
+		Ar << completion;
+		Ar << previousRotation[0];
+		Ar << previousRotation[1];
+		Ar << previousRotation[2];
+
+		uint8 inField = bInGravityField ? 1 : 0;
+		Ar.SerializeBits(&inField, 1);
+		bInGravityField = inField != 0;
+	}
+	return !Ar.IsError();
+}
+
+FGravityState FGravityMoveResponseDataContainer::ToState() const {
+	FGravityState state;
+	state.shiftId = shiftId;
+	state.shiftedGravity = shiftedGravity.Dequantize();
+	state.gravity = gravity.Dequantize();
+	state.rotationCompletion = GravityNet::DequantizeCompletion(completion);
+	state.previousRotation = FRotator(FRotator::DecompressAxisFromShort(previousRotation[0]), FRotator::DecompressAxisFromShort(previousRotation[1]), FRotator::DecompressAxisFromShort(previousRotation[2]));
+	state.bInGravityField = bInGravityField;
+	return state;
+}
+
+FGravityNetStats& FGravityNetStats::Get() {
+	static FGravityNetStats stats;
+	if (stats.StartTime == 0.0) {
+		stats.StartTime = FPlatformTime::Seconds();
+	}
+	return stats;
+}
+
+void FGravityNetStats::LogAndReset() {
+	const double now = FPlatformTime::Seconds();
+	const double seconds = StartTime > 0.0 ? now - StartTime : 0.0;
+	const double perSecond = seconds > 0.0 ? 1.0 / seconds : 0.0;
+
+	UE_LOG(LogTemp, Display, TEXT("Gravity net over %.1fs: %llu moves sent, %.0f bytes/s of moves (%.0f bytes/s gravity), %llu shifts sent, %.0f bytes/s of responses"),
+		seconds, MovesSent, MoveBitsSent / 8.0 * perSecond, GravityBitsSent / 8.0 * perSecond, ShiftsSent, ResponseBitsSent / 8.0 * perSecond);
+	UE_LOG(LogTemp, Display, TEXT("Gravity net corrections: %llu sent (%.2f/s, %llu because of gravity), %llu received (%.2f/s)"),
+		CorrectionsSent, CorrectionsSent * perSecond, GravityCorrectionsSent, CorrectionsReceived, CorrectionsReceived * perSecond);
+
+	*this = FGravityNetStats();
+	StartTime = now;
+}
@@ -0,0 +1,127 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+
+/** Gravity packed into 6 bytes: an octahedral direction and a strength in hundredths. */
+struct FQuantizedGravity {
+	uint16 x = 0;
+	uint16 y = 0;
+	uint16 strength = 0;
+
+	static FQuantizedGravity Quantize(FVector gravity);
+
+	FVector Dequantize() const;
+
+	void Serialize(FArchive& Ar);
+
+	bool operator==(const FQuantizedGravity& other) const { return x == other.x && y == other.y && strength == other.strength; }
+	bool operator!=(const FQuantizedGravity& other) const { return !(*this == other); }
+};
+
+/** Everything UCharacterGravityComponent simulates about gravity, for saving, restoring and sending in corrections. */
+struct FGravityState {
+	FVector gravity = FVector::ZeroVector;
+	FVector shiftedGravity = FVector::ZeroVector;
+	FRotator previousRotation = FRotator::ZeroRotator;
+	float rotationCompletion = 0.0f;
+	/** Counts explicit GravityShifts, wrapping around. */
+	uint8 shiftId = 0;
+	bool bInGravityField = false;
+};
+
+namespace GravityNet {
+	/** Rotation progress to a byte and back. */
+	uint8 QuantizeCompletion(float completion);
+	float DequantizeCompletion(uint8 completion);
+}
+
+/** A client move, plus the last explicit gravity shift before it, any switch in or out of gravity movement, and how far the rotation towards gravity got by the end of it. */
+class FSavedMove_Gravity : public FSavedMove_Character {
+public:
+	typedef FSavedMove_Character Super;
+
+	virtual void Clear() override;
+	virtual void SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData) override;
+	virtual void PostUpdate(ACharacter* C, EPostUpdateMode PostUpdateMode) override;
+	virtual void PrepMoveFor(ACharacter* C) override;
+	virtual bool CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const override;
+	/** FLAG_Custom_0 and FLAG_Custom_1 carry UCharacterGravityComponent::RequestGravityMovement. */
+	virtual uint8 GetCompressedFlags() const override;
+
+	uint8 shiftId = 0;
+	FQuantizedGravity shiftGravity;
+	/** The server hasn't acknowledged a move with this shift yet, so the shift goes along with the move. */
+	bool bSendShift = false;
+
+	uint8 endCompletion = 0;
+
+	bool bRequestGravityMovement = false;
+	bool bRequestWalking = false;
+};
+
+class FNetworkPredictionData_Client_Gravity : public FNetworkPredictionData_Client_Character {
+public:
+	typedef FNetworkPredictionData_Client_Character Super;
+
+	FNetworkPredictionData_Client_Gravity(const UCharacterMovementComponent& ClientMovement) : Super(ClientMovement) {}
+
+	virtual FSavedMovePtr AllocateNewMove() override;
+};
+
+/** What gets sent to the server per move: 2 bytes and a bit, or 8 bytes while a gravity shift is waiting to be acknowledged. */
+struct FGravityNetworkMoveData : public FCharacterNetworkMoveData {
+	typedef FCharacterNetworkMoveData Super;
+
+	virtual void ClientFillNetworkMoveData(const FSavedMove_Character& ClientMove, ENetworkMoveType MoveType) override;
+	virtual bool Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap, ENetworkMoveType MoveType) override;
+
+	uint8 shiftId = 0;
+	bool bHasShift = false;
+	FQuantizedGravity shiftGravity;
+	uint8 completion = 0;
+};
+
+struct FGravityNetworkMoveDataContainer : public FCharacterNetworkMoveDataContainer {
+	FGravityNetworkMoveDataContainer();
+
+	FGravityNetworkMoveData moves[3];
+};
+
+/** Corrections carry the server's gravity state along with the usual position and velocity. */
+struct FGravityMoveResponseDataContainer : public FCharacterMoveResponseDataContainer {
+	typedef FCharacterMoveResponseDataContainer Super;
+
+	virtual void ServerFillResponseData(const UCharacterMovementComponent& CharacterMovement, const FClientAdjustment& PendingAdjustment) override;
+	virtual bool Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap) override;
+
+	uint8 shiftId = 0;
+	FQuantizedGravity shiftedGravity;
+	FQuantizedGravity gravity;
+	uint8 completion = 0;
+	uint16 previousRotation[3] = { 0, 0, 0 };
+	bool bInGravityField = false;
+
+	FGravityState ToState() const;
+};
+
+/** Totals for ut.Net.GravityStats, for this process. Counting starts over each time they're logged. */
+struct FGravityNetStats {
+	uint64 MovesSent = 0;
+	uint64 MoveBitsSent = 0;
+	/** Bits of MoveBitsSent that are gravity data. */
+	uint64 GravityBitsSent = 0;
+	uint64 ShiftsSent = 0;
+	uint64 ResponseBitsSent = 0;
+	uint64 CorrectionsSent = 0;
+	/** Corrections sent only because gravity disagreed. */
+	uint64 GravityCorrectionsSent = 0;
+	uint64 CorrectionsReceived = 0;
+	double StartTime = 0.0;
+
+	static FGravityNetStats& Get();
+
+	void LogAndReset();
+};
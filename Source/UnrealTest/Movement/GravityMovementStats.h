@@ -0,0 +1,16 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+// "stat GravityMovement" in game, or the Stats channel in Insights.
+DECLARE_STATS_GROUP(TEXT("Gravity Movement"), STATGROUP_GravityMovement, STATCAT_Advanced);
+
+// Timing scopes for the custom gravity movement. Turn it on in Insights with -trace=default,GravityMovement.
+UE_TRACE_CHANNEL_EXTERN(GravityMovementChannel, UNREALTEST_API);
+
+#define GRAVITY_MOVEMENT_SCOPE(Name) TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Name, GravityMovementChannel)
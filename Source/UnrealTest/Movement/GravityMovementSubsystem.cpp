@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityMovementSubsystem.h"
+#include "CharacterGravityComponent.h"
+#include "GravityMovementStats.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "GameFramework/PhysicsVolume.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<bool> CVarParallelGravityPrepare(
+	TEXT("ut.Movement.ParallelPrepare"),
+	true,
+	TEXT("Prepare gravity characters' movement across worker threads. When off, it's all still done up front, just on the game thread."));
+
+static TAutoConsoleVariable<int32> CVarParallelGravityMinCharacters(
+	TEXT("ut.Movement.ParallelPrepareMinCharacters"),
+	16,
+	TEXT("Below this many gravity characters, preparing on the game thread is cheaper than waking workers."));
+
+DECLARE_CYCLE_STAT(TEXT("Prepare"), STAT_GravityPrepare, STATGROUP_GravityMovement);
+
+void FGravityMovementPrepareTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) {
+	if (Target != nullptr && TickType != LEVELTICK_ViewportsOnly) {
+		Target->PrepareMovement(DeltaTime);
+	}
+}
+
+FString FGravityMovementPrepareTickFunction::DiagnosticMessage() {
+	return TEXT("UGravityMovementSubsystem::PrepareMovement");
+}
+
+FName FGravityMovementPrepareTickFunction::DiagnosticContext(bool bDetailed) {
+	return FName(TEXT("GravityMovementPrepare"));
+}
+
+bool UGravityMovementSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const {
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UGravityMovementSubsystem::OnWorldBeginPlay(UWorld& InWorld) {
+	Super::OnWorldBeginPlay(InWorld);
+
+	prepareTick.Target = this;
+	prepareTick.TickGroup = TG_PrePhysics;
+	prepareTick.bHighPriority = true;
+	prepareTick.bCanEverTick = true;
+	prepareTick.bStartWithTickEnabled = true;
+	prepareTick.RegisterTickFunction(InWorld.PersistentLevel);
+}
+
+void UGravityMovementSubsystem::Deinitialize() {
+	if (prepareTick.IsTickFunctionRegistered()) {
+		prepareTick.UnRegisterTickFunction();
+	}
+	prepareTick.Target = nullptr;
+	components.Empty();
+
+	Super::Deinitialize();
+}
+
+void UGravityMovementSubsystem::RegisterComponent(UCharacterGravityComponent* component) {
+	if (component == nullptr || components.Contains(component)) {
+		return;
+	}
+
+	components.Add(component);
+	// Make sure this frame's results are ready before the component needs them.
+	component->PrimaryComponentTick.AddPrerequisite(this, prepareTick);
+}
+
+void UGravityMovementSubsystem::UnregisterComponent(UCharacterGravityComponent* component) {
+	components.RemoveAllSwap([component](const TWeakObjectPtr<UCharacterGravityComponent>& registered) { return !registered.IsValid() || registered.Get() == component; });
+	if (component != nullptr) {
+		component->PrimaryComponentTick.RemovePrerequisite(this, prepareTick);
+	}
+}
+
+void UGravityMovementSubsystem::PrepareMovement(float DeltaTime) {
+	SCOPE_CYCLE_COUNTER(STAT_GravityPrepare);
+	GRAVITY_MOVEMENT_SCOPE(UGravityMovementSubsystem::PrepareMovement);
+
+	// Weak pointers can't be resolved on workers, so pick out what's going to tick on the game thread first.
+	// The physics volume is a weak pointer too (and finding the default one can spawn it), so its terminal velocity is read here as well.
+	struct FToPrepare {
+		UCharacterGravityComponent* component;
+		float terminalVelocity;
+	};
+	TArray<FToPrepare, TInlineAllocator<64>> toPrepare;
+	for (const TWeakObjectPtr<UCharacterGravityComponent>& registered : components) {
+		UCharacterGravityComponent* component = registered.Get();
+		if (component != nullptr && component->CanPrepareMovement()) {
+			toPrepare.Add({ component, component->GetPhysicsVolume()->TerminalVelocity });
+		}
+	}
+
+	// Each component only touches its own state, and the gravity field is read only while this runs.
+	const bool bSingleThread = !CVarParallelGravityPrepare.GetValueOnGameThread() || toPrepare.Num() < CVarParallelGravityMinCharacters.GetValueOnGameThread();
+	ParallelFor(toPrepare.Num(), [&toPrepare, DeltaTime](int32 index) {
+		toPrepare[index].component->PrepareMovement(DeltaTime, toPrepare[index].terminalVelocity);
+	}, bSingleThread ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+}
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GravityMovementSubsystem.generated.h"
+
+class UCharacterGravityComponent;
+class UGravityMovementSubsystem;
+
+/** Runs at the start of TG_PrePhysics, ahead of every registered UCharacterGravityComponent. */
+struct FGravityMovementPrepareTickFunction : public FTickFunction {
+	UGravityMovementSubsystem* Target = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+	virtual FName DiagnosticContext(bool bDetailed) override;
+};
+
+/**
+ * Does the sweep-free part of every UCharacterGravityComponent's movement for the frame in one ParallelFor:
+ * gravity field lookups, rotation towards gravity and the first falling substep.
+ * The components then tick as usual on the game thread, doing their sweeps with the results.
+ */
+UCLASS()
+class UNREALTEST_API UGravityMovementSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	void RegisterComponent(UCharacterGravityComponent* component);
+	void UnregisterComponent(UCharacterGravityComponent* component);
+
+	void PrepareMovement(float DeltaTime);
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	/** Components can't be registered from a worker thread, so this is only ever changed on the game thread between prepares. */
+	TArray<TWeakObjectPtr<UCharacterGravityComponent>> components;
+
+	FGravityMovementPrepareTickFunction prepareTick;
+};
@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravitySource.h"
+#include "GravityFieldSubsystem.h"
+#include "Components/SplineComponent.h"
+#include "Engine/World.h"
+
+AGravitySource::AGravitySource() {
+	PrimaryActorTick.bCanEverTick = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+
+	Spline = CreateDefaultSubobject<USplineComponent>(TEXT("Spline"));
+	Spline->SetupAttachment(RootComponent);
+}
+
+void AGravitySource::BeginPlay() {
+	Super::BeginPlay();
+
+	if (UGravityFieldSubsystem* field = GetWorld()->GetSubsystem<UGravityFieldSubsystem>()) {
+		field->RegisterSource(this);
+	}
+}
+
+void AGravitySource::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+	if (UGravityFieldSubsystem* field = GetWorld()->GetSubsystem<UGravityFieldSubsystem>()) {
+		field->UnregisterSource(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AGravitySource::UpdateIndex() {
+	if (UGravityFieldSubsystem* field = GetWorld()->GetSubsystem<UGravityFieldSubsystem>()) {
+		field->UpdateSource(this);
+	}
+}
+
+bool AGravitySource::PullTowards(FVector location, FVector target, FVector& out) const {
+	const FVector toTarget = target - location;
+	const float distanceSquared = toTarget.SizeSquared();
+	if (distanceSquared > Radius * Radius || distanceSquared < UE_KINDA_SMALL_NUMBER) {
+		return false;
+	}
+
+	out = toTarget * (Strength * FMath::InvSqrt(distanceSquared));
+	return true;
+}
+
+bool AGravitySource::GetGravityAt(FVector location, FVector& out) const {
+	const FTransform& transform = GetActorTransform();
+
+	switch (Shape) {
+		case EGravitySourceShape::Point:
+			return PullTowards(location, transform.GetLocation(), out);
+
+		case EGravitySourceShape::Planar: {
+			const FVector local = transform.InverseTransformPositionNoScale(location);
+			if (FMath::Abs(local.X) > PlanarExtent.X || FMath::Abs(local.Y) > PlanarExtent.Y || FMath::Abs(local.Z) > PlanarExtent.Z) {
+				return false;
+			}
+			out = -transform.GetUnitAxis(EAxis::Z) * Strength;
+			return true;
+		}
+
+		case EGravitySourceShape::Cylinder: {
+			const FVector axis = transform.GetUnitAxis(EAxis::Z);
+			const float along = FVector::DotProduct(location - transform.GetLocation(), axis);
+			if (FMath::Abs(along) > CylinderHalfHeight) {
+				return false;
+			}
+			return PullTowards(location, transform.GetLocation() + axis * along, out);
+		}
+
+		case EGravitySourceShape::Spline:
+			if (Spline->GetNumberOfSplinePoints() == 0) {
+				return false;
+			}
+			return PullTowards(location, Spline->FindLocationClosestToWorldLocation(location, ESplineCoordinateSpace::World), out);
+	}
+	return false;
+}
+
+FBox AGravitySource::GetInfluenceBounds() const {
+	const FTransform transform(GetActorRotation(), GetActorLocation());
+
+	switch (Shape) {
+		case EGravitySourceShape::Point:
+			return FBox::BuildAABB(transform.GetLocation(), FVector(Radius));
+
+		case EGravitySourceShape::Planar:
+			return FBox(-PlanarExtent, PlanarExtent).TransformBy(transform);
+
+		case EGravitySourceShape::Cylinder:
+			return FBox(FVector(-Radius, -Radius, -CylinderHalfHeight), FVector(Radius, Radius, CylinderHalfHeight)).TransformBy(transform);
+
+		case EGravitySourceShape::Spline:
+			return Spline->CalcBounds(Spline->GetComponentTransform()).GetBox().ExpandBy(Radius);
+	}
+	return FBox(ForceInit);
+}
+
+bool AGravitySource::IsUniformOver(const FBox& box) const {
+	// Only a planar source pulls the same way everywhere, and only if the whole box is inside it.
+	if (Shape != EGravitySourceShape::Planar) {
+		return false;
+	}
+
+	const FTransform& transform = GetActorTransform();
+	FVector corners[8];
+	box.GetVertices(corners);
+	for (const FVector& corner : corners) {
+		const FVector local = transform.InverseTransformPositionNoScale(corner);
+		if (FMath::Abs(local.X) > PlanarExtent.X || FMath::Abs(local.Y) > PlanarExtent.Y || FMath::Abs(local.Z) > PlanarExtent.Z) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "GravitySource.generated.h"
+
+class USplineComponent;
+
+UENUM(BlueprintType)
+enum class EGravitySourceShape : uint8 {
+	/** Pulls towards the actor's location. */
+	Point,
+	/** Pulls along the actor's down vector, inside a box of PlanarExtent. */
+	Planar,
+	/** Pulls towards the actor's up axis, within CylinderHalfHeight of the actor. */
+	Cylinder,
+	/** Pulls towards the closest point on the spline. */
+	Spline,
+};
+
+/**
+ * A placeable gravity zone. Characters using UCharacterGravityComponent pick these up through UGravityFieldSubsystem,
+ * so there can be lots of them in a level without every character checking every one.
+ * Sources are indexed when they begin play. Call UpdateIndex after moving or reshaping one at runtime.
+ */
+UCLASS()
+class UNREALTEST_API AGravitySource : public AActor
+{
+	GENERATED_BODY()
+public:
+	AGravitySource();
+
+	/** Gravity this source applies at location, or false if location is outside of it. */
+	bool GetGravityAt(FVector location, FVector& out) const;
+
+	/** World space box that everything this source affects fits inside. */
+	FBox GetInfluenceBounds() const;
+
+	/** True if GetGravityAt gives the same answer everywhere inside box. */
+	bool IsUniformOver(const FBox& box) const;
+
+	/** Re-indexes this source after it's been moved or changed. */
+	UFUNCTION(BlueprintCallable, Category = Gravity)
+	void UpdateIndex();
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Gravity)
+	EGravitySourceShape Shape = EGravitySourceShape::Point;
+
+	/** Same units as UCharacterGravityComponent's gravity. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Gravity)
+	float Strength = 9.8f;
+
+	/** Where more than one source covers a spot, the highest priority wins. Sources with the same priority add together. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Gravity)
+	int32 Priority = 0;
+
+	/** How far out Point, Cylinder and Spline sources reach. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Gravity, meta = (EditCondition = "Shape != EGravitySourceShape::Planar"))
+	float Radius = 2000.0f;
+
+	/** Half size of the box a Planar source covers, in the actor's space. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Gravity, meta = (EditCondition = "Shape == EGravitySourceShape::Planar"))
+	FVector PlanarExtent = FVector(1000.0f, 1000.0f, 1000.0f);
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Gravity, meta = (EditCondition = "Shape == EGravitySourceShape::Cylinder"))
+	float CylinderHalfHeight = 1000.0f;
+
+	/** Only used by Spline sources. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Gravity)
+	TObjectPtr<USplineComponent> Spline;
+
+private:
+	/** Gravity of Strength towards target, or false if target is out of range or right on top of location. */
+	bool PullTowards(FVector location, FVector target, FVector& out) const;
+};
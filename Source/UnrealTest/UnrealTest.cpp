@@ -1,7 +1,17 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "UnrealTest.h"
+#include "Benchmark/AllocationCounter.h"
 #include "Modules/ModuleManager.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, UnrealTest, "UnrealTest" );
- 
\ No newline at end of file
+class FUnrealTestModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+		// As early as the game gets to run anything, so the allocator is swapped before gameplay starts allocating through it.
+		FAllocationCounter::Install();
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FUnrealTestModule, UnrealTest, "UnrealTest" );
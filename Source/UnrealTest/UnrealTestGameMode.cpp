@@ -1,14 +1,144 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "UnrealTestGameMode.h"
-#include "FP_Character/UnrealTestCharacter.h"
-#include "UObject/ConstructorHelpers.h"
+#include "UnrealTest/Benchmark/BenchmarkReport.h"
+#include "Engine/AssetManager.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+namespace
+{
+	// Game modes don't outlive their map, so the previous map's end has to be kept here to time travel from it.
+	double GLastMapEndTime = 0.0;
+	bool GFirstMapLoaded = false;
+}
 
 AUnrealTestGameMode::AUnrealTestGameMode()
 	: Super()
 {
-	// set default pawn class to our Blueprinted character
-	static ConstructorHelpers::FClassFinder<APawn> PlayerPawnClassFinder(TEXT("/Game/FirstPerson/Blueprints/BP_FirstPersonCharacter"));
-	DefaultPawnClass = PlayerPawnClassFinder.Class;
+	// set default pawn class to our Blueprinted character, without loading it along with this class
+	PlayerPawnClass = TSoftClassPtr<APawn>(FSoftObjectPath(TEXT("/Game/FirstPerson/Blueprints/BP_FirstPersonCharacter.BP_FirstPersonCharacter_C")));
+}
+
+void AUnrealTestGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	initGameTime = FPlatformTime::Seconds();
+	bColdStart = !GFirstMapLoaded;
+	GFirstMapLoaded = true;
+	mapLoadStartTime = bColdStart || GLastMapEndTime == 0.0 ? GStartTime : GLastMapEndTime;
+
+	if (PlayerPawnClass.IsNull())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s has no PlayerPawnClass, players will spawn as %s"), *GetName(), *GetNameSafe(DefaultPawnClass));
+		OnPlayerPawnClassLoaded();
+		return;
+	}
+
+	// The rest of the map is still loading, so this gets streamed in alongside it.
+	pawnClassHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(PlayerPawnClass.ToSoftObjectPath(),
+		FStreamableDelegate::CreateUObject(this, &AUnrealTestGameMode::OnPlayerPawnClassLoaded), FStreamableManager::AsyncLoadHighPriority);
+	if (!pawnClassHandle.IsValid())
+	{
+		OnPlayerPawnClassLoaded();
+	}
+}
+
+void AUnrealTestGameMode::OnPlayerPawnClassLoaded()
+{
+	if (bPlayerPawnClassLoaded)
+	{
+		return;
+	}
+	bPlayerPawnClassLoaded = true;
+	pawnClassLoadedTime = FPlatformTime::Seconds();
+
+	if (UClass* pawnClass = PlayerPawnClass.Get())
+	{
+		DefaultPawnClass = pawnClass;
+	}
+	else if (!PlayerPawnClass.IsNull())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Couldn't load %s, players will spawn as %s"), *PlayerPawnClass.ToString(), *GetNameSafe(DefaultPawnClass));
+	}
+
+	for (const TWeakObjectPtr<APlayerController>& player : waitingPlayers)
+	{
+		if (player.IsValid() && player->GetPawn() == nullptr && PlayerCanRestart(player.Get()))
+		{
+			RestartPlayer(player.Get());
+		}
+	}
+	waitingPlayers.Reset();
+}
+
+void AUnrealTestGameMode::StartPlay()
+{
+	startPlayTime = FPlatformTime::Seconds();
+	Super::StartPlay();
+}
+
+void AUnrealTestGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (pawnClassHandle.IsValid())
+	{
+		pawnClassHandle->CancelHandle();
+		pawnClassHandle.Reset();
+	}
+	waitingPlayers.Reset();
+	GLastMapEndTime = FPlatformTime::Seconds();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AUnrealTestGameMode::HandleStartingNewPlayer_Implementation(APlayerController* NewPlayer)
+{
+	// Until the pawn class is in, the player just looks out from their start spot.
+	if (!bPlayerPawnClassLoaded && NewPlayer != nullptr)
+	{
+		waitingPlayers.AddUnique(NewPlayer);
+	}
+	Super::HandleStartingNewPlayer_Implementation(NewPlayer);
+}
+
+bool AUnrealTestGameMode::PlayerCanRestart_Implementation(APlayerController* Player)
+{
+	return bPlayerPawnClassLoaded && Super::PlayerCanRestart_Implementation(Player);
+}
+
+APawn* AUnrealTestGameMode::SpawnDefaultPawnFor_Implementation(AController* NewPlayer, AActor* StartSpot)
+{
+	APawn* pawn = Super::SpawnDefaultPawnFor_Implementation(NewPlayer, StartSpot);
+	if (pawn != nullptr && firstPawnTime == 0.0)
+	{
+		firstPawnTime = FPlatformTime::Seconds();
+		ReportStartup();
+	}
+	return pawn;
+}
+
+void AUnrealTestGameMode::ReportStartup()
+{
+	const double toInitGameMs = (initGameTime - mapLoadStartTime) * 1000.0;
+	const double pawnClassLoadMs = (pawnClassLoadedTime - initGameTime) * 1000.0;
+	const double startPlayMs = (startPlayTime - initGameTime) * 1000.0;
+	const double firstPawnMs = (firstPawnTime - initGameTime) * 1000.0;
+	// How long players were left without a pawn once the map was up.
+	const double waitedMs = FMath::Max(firstPawnTime - startPlayTime, 0.0) * 1000.0;
+
+	UE_LOG(LogTemp, Display, TEXT("%s %s: %.1fms to InitGame, then pawn class loaded in %.1fms, StartPlay at %.1fms, first pawn at %.1fms (%.1fms waiting for it)"),
+		bColdStart ? TEXT("Cold start into") : TEXT("Travel to"), *GetWorld()->GetMapName(), toInitGameMs, pawnClassLoadMs, startPlayMs, firstPawnMs, waitedMs);
 
+	FBenchmarkReport report(TEXT("Startup"));
+	report.AddRow();
+	report.Set(TEXT("timestamp"), FDateTime::Now().ToIso8601());
+	report.Set(TEXT("map"), GetWorld()->GetMapName());
+	report.Set(TEXT("cold_start"), bColdStart ? 1 : 0);
+	report.Set(TEXT("to_init_game_ms"), toInitGameMs);
+	report.Set(TEXT("pawn_class_load_ms"), pawnClassLoadMs);
+	report.Set(TEXT("start_play_ms"), startPlayMs);
+	report.Set(TEXT("first_pawn_ms"), firstPawnMs);
+	report.Set(TEXT("waited_ms"), waitedMs);
+	report.Write();
 }
@@ -4,16 +4,54 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/GameModeBase.h"
+#include "Engine/StreamableManager.h"
 #include "UnrealTestGameMode.generated.h"
 
-UCLASS(minimalapi)
+/**
+ * Loads the player's pawn class in the background while the map loads, instead of with this class's default object at startup.
+ * Players that join before it's loaded wait at their start spot without a pawn, and are spawned as soon as it is.
+ * How long each part of the load took is logged, and written to Saved/Benchmarks/Startup.csv.
+ */
+UCLASS(minimalapi, config=Game)
 class AUnrealTestGameMode : public AGameModeBase
 {
 	GENERATED_BODY()
 
 public:
 	AUnrealTestGameMode();
-};
 
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void StartPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void HandleStartingNewPlayer_Implementation(APlayerController* NewPlayer) override;
+	virtual bool PlayerCanRestart_Implementation(APlayerController* Player) override;
+	virtual APawn* SpawnDefaultPawnFor_Implementation(AController* NewPlayer, AActor* StartSpot) override;
+
+	/** Whether PlayerPawnClass has loaded, so players can be spawned. */
+	bool IsPlayerPawnClassLoaded() const { return bPlayerPawnClassLoaded; }
+
+public:
+	/** The pawn players spawn as. Loaded asynchronously from InitGame, along with everything it references. */
+	UPROPERTY(config, EditDefaultsOnly, Category = Classes)
+	TSoftClassPtr<APawn> PlayerPawnClass;
+
+private:
+	void OnPlayerPawnClassLoaded();
+
+	/** Logs and writes out the load times, once the first pawn is in. */
+	void ReportStartup();
 
+	TSharedPtr<FStreamableHandle> pawnClassHandle;
+	bool bPlayerPawnClassLoaded = false;
 
+	/** Players that joined before the pawn class loaded. */
+	TArray<TWeakObjectPtr<APlayerController>> waitingPlayers;
+
+	/** When each load phase finished, in FPlatformTime::Seconds. */
+	double mapLoadStartTime = 0.0;
+	double initGameTime = 0.0;
+	double pawnClassLoadedTime = 0.0;
+	double startPlayTime = 0.0;
+	double firstPawnTime = 0.0;
+	bool bColdStart = false;
+};